@@ -0,0 +1,79 @@
+#include <cstdlib>
+#include "arena.hpp"
+
+namespace cshanty{
+
+Arena::Arena(size_t chunkSize)
+: myChunkSize(chunkSize), myChunks(nullptr), myCur(nullptr), myEnd(nullptr),
+  myBytesReserved(0){
+}
+
+Arena::~Arena(){
+	while (myChunks != nullptr){
+		Chunk * next = myChunks->next;
+		std::free(myChunks);
+		myChunks = next;
+	}
+}
+
+/*
+Called when the current chunk can't satisfy a request. Requests
+larger than a quarter of the chunk size get a chunk of their own,
+which is linked in behind the current one so the remaining space
+in the current chunk isn't wasted.
+*/
+void * Arena::allocSlow(size_t size, size_t align){
+	size_t header = (sizeof(Chunk) + align - 1) & ~(align - 1);
+	bool dedicated = size > myChunkSize / 4;
+	size_t chunkBytes = dedicated ? header + size : myChunkSize;
+	if (chunkBytes < header + size){ chunkBytes = header + size; }
+
+	Chunk * chunk = static_cast<Chunk *>(std::malloc(chunkBytes));
+	if (chunk == nullptr){ throw std::bad_alloc(); }
+	chunk->size = chunkBytes;
+	myBytesReserved += chunkBytes;
+
+	char * base = reinterpret_cast<char *>(chunk);
+	if (dedicated && myChunks != nullptr){
+		chunk->next = myChunks->next;
+		myChunks->next = chunk;
+	} else {
+		chunk->next = myChunks;
+		myChunks = chunk;
+		myCur = base + header + size;
+		myEnd = base + chunkBytes;
+	}
+	note(size);
+	return base + header;
+}
+
+void Arena::reset(){
+	if (myChunks == nullptr){ return; }
+	//Keep the most recent chunk (unless it was an oversized one)
+	Chunk * keep = myChunks;
+	Chunk * rest = keep->next;
+	while (rest != nullptr){
+		Chunk * next = rest->next;
+		std::free(rest);
+		rest = next;
+	}
+	keep->next = nullptr;
+	if (keep->size != myChunkSize){
+		std::free(keep);
+		myChunks = nullptr;
+		myCur = myEnd = nullptr;
+		myBytesReserved = 0;
+	} else {
+		char * base = reinterpret_cast<char *>(keep);
+		myCur = base + sizeof(Chunk);
+		myEnd = base + keep->size;
+		myBytesReserved = keep->size;
+	}
+#ifndef CSHANTY_NO_STATS
+	myBytesUsed = 0;
+	myAllocs = 0;
+	myMallocBytes = 0;
+#endif
+}
+
+} //End namespace cshanty
@@ -0,0 +1,149 @@
+#ifndef CSHANTY_ARENA_H
+#define CSHANTY_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <new>
+
+namespace cshanty{
+
+/**
+* \class Arena
+* A bump-pointer allocator. Memory is carved out of large chunks
+* and is never returned piecemeal: destructors of objects placed in
+* the arena are NOT run, and the whole lot is released at once by
+* reset() (or when the arena itself is destroyed). Everything the
+* scanner and parser build (tokens, positions, AST nodes and the
+* lists that hold them) lives here.
+**/
+class Arena{
+public:
+	Arena(size_t chunkSize = 64 * 1024);
+	~Arena();
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void * alloc(size_t size, size_t align = alignof(void *)){
+		uintptr_t cur = reinterpret_cast<uintptr_t>(myCur);
+		uintptr_t start = (cur + align - 1) & ~(uintptr_t(align) - 1);
+		uintptr_t end = start + size;
+		if (end > reinterpret_cast<uintptr_t>(myEnd)){
+			return allocSlow(size, align);
+		}
+		myCur = reinterpret_cast<char *>(end);
+		note(size);
+		return reinterpret_cast<void *>(start);
+	}
+
+	/** Release every allocation. The first chunk is kept for reuse **/
+	void reset();
+
+	/** Bytes obtained from the system for chunks **/
+	size_t bytesReserved() const { return myBytesReserved; }
+#ifndef CSHANTY_NO_STATS
+	/** Bytes handed out to callers **/
+	size_t bytesUsed() const { return myBytesUsed; }
+	/** Number of allocations served **/
+	size_t allocations() const { return myAllocs; }
+	/** Estimated heap footprint had each allocation gone to malloc **/
+	size_t mallocBytes() const { return myMallocBytes; }
+#else
+	//Not counted, so that alloc() is only the bump
+	size_t bytesUsed() const { return 0; }
+	size_t allocations() const { return 0; }
+	size_t mallocBytes() const { return 0; }
+#endif
+
+	/** Approximate glibc malloc chunk size for a request of n bytes **/
+	static size_t mallocFootprint(size_t n){
+		size_t chunk = (n + sizeof(size_t) + 15) & ~size_t(15);
+		return chunk < 32 ? 32 : chunk;
+	}
+private:
+	struct Chunk{
+		Chunk * next;
+		size_t size;
+	};
+
+	void * allocSlow(size_t size, size_t align);
+	void note(size_t size){
+#ifndef CSHANTY_NO_STATS
+		myBytesUsed += size;
+		myMallocBytes += mallocFootprint(size);
+		myAllocs++;
+#endif
+	}
+
+	size_t myChunkSize;
+	Chunk * myChunks;
+	char * myCur;
+	char * myEnd;
+	size_t myBytesReserved;
+#ifndef CSHANTY_NO_STATS
+	size_t myBytesUsed = 0;
+	size_t myAllocs = 0;
+	size_t myMallocBytes = 0;
+#endif
+};
+
+/**
+* Standard allocator adaptor so that containers (in particular the
+* std::lists hanging off of AST nodes) draw their elements from an
+* Arena. deallocate is a no-op; the arena reclaims everything on reset.
+**/
+template <typename T>
+class ArenaAllocator{
+public:
+	typedef T value_type;
+
+	ArenaAllocator(Arena& arena) : myArena(&arena){ }
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other)
+	: myArena(other.arena()){ }
+
+	T * allocate(size_t n){
+		return static_cast<T *>(myArena->alloc(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *, size_t){ }
+
+	Arena * arena() const { return myArena; }
+private:
+	Arena * myArena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+	return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+	return !(a == b);
+}
+
+/** The list type used for sequences in the AST **/
+template <typename T>
+using NodeList = std::list<T, ArenaAllocator<T>>;
+
+template <typename T>
+NodeList<T> * newList(Arena& arena){
+	void * mem = arena.alloc(sizeof(NodeList<T>), alignof(NodeList<T>));
+	return new (mem) NodeList<T>(ArenaAllocator<T>(arena));
+}
+
+} //End namespace cshanty
+
+/*
+Placement forms so that arena allocations read like ordinary ones:
+   new (arena) IDNode(pos, name)
+The matching delete is only called by the compiler if a constructor
+throws, in which case the memory simply stays in the arena.
+*/
+inline void * operator new(size_t size, cshanty::Arena& arena){
+	return arena.alloc(size);
+}
+
+inline void operator delete(void *, cshanty::Arena&){ }
+
+#endif
@@ -0,0 +1,601 @@
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "asmgen.hpp"
+#include "errors.hpp"
+#include "layout.hpp"
+
+namespace cshanty{
+
+static const char * const ARG_REGS[] = {
+	"%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9"
+};
+static const size_t REG_ARGS = 6;
+
+/*
+Condition code suffixes (for j and set) of the comparisons,
+and of their negations
+*/
+static const char * condition(NodeKind kind, bool negate){
+	switch (kind){
+	case KIND_EQUALS: return negate ? "ne" : "e";
+	case KIND_NOT_EQUALS: return negate ? "e" : "ne";
+	case KIND_LESS: return negate ? "ge" : "l";
+	case KIND_LESS_EQ: return negate ? "g" : "le";
+	case KIND_GREATER: return negate ? "le" : "g";
+	default: return negate ? "l" : "ge";
+	}
+}
+
+static bool isCompare(NodeKind kind){
+	return kind == KIND_EQUALS || kind == KIND_NOT_EQUALS
+	  || kind == KIND_LESS || kind == KIND_LESS_EQ
+	  || kind == KIND_GREATER || kind == KIND_GREATER_EQ;
+}
+
+/** Where a variable, or a field of one, lives **/
+struct Location{
+	//The global's declaration, or null for a frame slot
+	const VarDeclNode * global;
+	//Bytes into the global, or from rbp
+	int32_t offset;
+};
+
+/**
+* \class AsmGen
+* Generates code for one program in a single walk, as a stack
+* machine: each expression leaves its value in rax, and the left
+* operand of a binary operator is pushed while the right one is
+* computed. The number of pushes outstanding is tracked, so calls
+* can keep the stack 16-byte aligned. Variables live in the frame,
+* whose size is only known at the end of the function, so the
+* prologue names it with a symbol the assembler resolves later.
+**/
+class AsmGen{
+public:
+	AsmGen(const LineTable& lines, TypeTable& types, Writer& out)
+	: myLines(lines), myTypes(types), myLayout(types), myOut(out),
+	  myLabels(0), myFunctions(0), myFrame(0), myFrameMax(0), myDepth(0){ }
+
+	void program(const ProgramNode * root){
+		Symbol mainName = Interner::global().intern("main");
+		const FnDeclNode * main = nullptr;
+		std::vector<const VarDeclNode *> globals;
+		myOut << "\t.text\n";
+		for (const DeclNode * decl : *root->globals()){
+			if (decl->kind() == KIND_VAR_DECL){
+				globals.push_back(static_cast<const VarDeclNode *>(decl));
+			} else if (decl->kind() == KIND_FN_DECL){
+				const FnDeclNode * fn = static_cast<const FnDeclNode *>(decl);
+				if (fn->id()->getName() == mainName){ main = fn; }
+				function(fn);
+			}
+		}
+		if (main == nullptr){ error(root, "No main function"); }
+		if (main->formals() != nullptr){
+			error(main->id(), "main takes no arguments");
+		}
+		myOut << "\t.globl cs_f_main\n";
+
+		if (!globals.empty()){ myOut << "\t.bss\n\t.p2align 3\n"; }
+		for (const VarDeclNode * global : globals){
+			myOut << "cs_g_" << global->id()->getName() << ":\n\t.zero "
+			<< 8 * myLayout.slots(myTypes.of(global)) << "\n";
+		}
+		if (!myStrings.empty()){ myOut << "\t.section .rodata\n"; }
+		for (size_t i = 0; i < myStrings.size(); i++){
+			myOut << ".LS" << i << ":\n\t.asciz \"";
+			quote(myStrings[i]);
+			myOut << "\"\n";
+		}
+		myOut << "\t.section .note.GNU-stack,\"\",@progbits\n";
+	}
+private:
+	[[noreturn]] void error(const ASTNode * node, const char * msg){
+		size_t start = node->pos().start();
+		Report::fatal(myLines.line(start), myLines.col(start), msg);
+		throw new AbortError(1);
+	}
+
+	//Layout
+
+	int32_t alloc(uint32_t count){
+		myFrame += 8 * static_cast<int32_t>(count);
+		if (myFrame > myFrameMax){ myFrameMax = myFrame; }
+		return -myFrame;
+	}
+
+	Location location(const DeclNode * decl){
+		auto local = myLocals.find(decl);
+		if (local != myLocals.end()){ return Location{nullptr, local->second}; }
+		return Location{static_cast<const VarDeclNode *>(decl), 0};
+	}
+
+	Location lval(const ExpNode * node){
+		if (node->kind() == KIND_ID){
+			return location(static_cast<const IDNode *>(node)->decl());
+		}
+		const IndexNode * index = static_cast<const IndexNode *>(node);
+		Location loc = location(index->recordId()->decl());
+		loc.offset += 8 * static_cast<int32_t>(myLayout.field(index));
+		return loc;
+	}
+
+	void mem(const Location& loc){
+		if (loc.global == nullptr){
+			myOut << loc.offset << "(%rbp)";
+			return;
+		}
+		myOut << "cs_g_" << loc.global->id()->getName();
+		if (loc.offset != 0){ myOut << "+" << loc.offset; }
+		myOut << "(%rip)";
+	}
+
+	//Output
+
+	uint32_t label(){ return myLabels++; }
+
+	void place(uint32_t label){ myOut << ".L" << label << ":\n"; }
+
+	void jump(const char * op, uint32_t label){
+		myOut << "\t" << op << " .L" << label << "\n";
+	}
+
+	void push(){
+		myOut << "\tpushq %rax\n";
+		myDepth++;
+	}
+
+	void pop(const char * reg){
+		myOut << "\tpopq " << reg << "\n";
+		myDepth--;
+	}
+
+	/* Call into the runtime with the stack aligned */
+	void runtime(const char * helper){
+		bool pad = myDepth % 2 != 0;
+		if (pad){ myOut << "\tsubq $8, %rsp\n"; }
+		myOut << "\tcall " << helper << "\n";
+		if (pad){ myOut << "\taddq $8, %rsp\n"; }
+	}
+
+	void position(const ASTNode * node){
+		size_t start = node->pos().start();
+		myOut << "\tmovl $" << myLines.line(start) << ", %edi\n"
+		<< "\tmovl $" << myLines.col(start) << ", %esi\n";
+	}
+
+	/* Copy a record from the address in rax to loc */
+	void copy(const Location& loc, uint32_t count){
+		myOut << "\tmovq %rax, %rsi\n\tleaq ";
+		mem(loc);
+		myOut << ", %rdi\n\tmovl $" << count << ", %ecx\n\trep movsq\n";
+	}
+
+	uint32_t string(const std::string& text){
+		auto found = myStringIndex.find(text);
+		if (found != myStringIndex.end()){ return found->second; }
+		uint32_t index = static_cast<uint32_t>(myStrings.size());
+		myStrings.push_back(text);
+		myStringIndex.emplace(text, index);
+		return index;
+	}
+
+	void quote(const std::string& text){
+		for (char c : text){
+			unsigned char u = static_cast<unsigned char>(c);
+			if (c == '"' || c == '\\'){
+				myOut << '\\' << c;
+			} else if (u >= 0x20 && u < 0x7f){
+				myOut << c;
+			} else {
+				myOut << '\\' << static_cast<char>('0' + (u >> 6))
+				<< static_cast<char>('0' + ((u >> 3) & 7))
+				<< static_cast<char>('0' + (u & 7));
+			}
+		}
+	}
+
+	//Functions and statements
+
+	void function(const FnDeclNode * fn){
+		const DataType * type = myTypes.of(fn);
+		if (type->ret()->kind() == DataType::RECORD){
+			error(fn->type(), "Records can't be returned");
+		}
+		uint32_t index = myFunctions++;
+		myLocals.clear();
+		myFrame = 0;
+		myFrameMax = 0;
+		myDepth = 0;
+		myReturn = label();
+		myOut << "\t.p2align 4\ncs_f_" << fn->id()->getName() << ":\n"
+		<< "\tpushq %rbp\n\tmovq %rsp, %rbp\n"
+		<< "\tsubq $.LF" << index << ", %rsp\n";
+
+		//Register arguments are spilled, stack ones used
+		// in place, and records copied in once all are safe
+		std::vector<std::pair<const FormalDeclNode *, int32_t>> records;
+		if (fn->formals() != nullptr){
+			size_t i = 0;
+			for (const FormalDeclNode * formal : *fn->formals()){
+				int32_t offset;
+				if (i < REG_ARGS){
+					offset = alloc(1);
+					myOut << "\tmovq " << ARG_REGS[i] << ", " << offset << "(%rbp)\n";
+				} else {
+					offset = 16 + 8 * static_cast<int32_t>(i - REG_ARGS);
+				}
+				if (myTypes.of(formal)->kind() == DataType::RECORD){
+					records.emplace_back(formal, offset);
+				} else {
+					myLocals[formal] = offset;
+				}
+				i++;
+			}
+		}
+		for (const auto& record : records){
+			uint32_t count = myLayout.slots(myTypes.of(record.first));
+			int32_t base = alloc(count);
+			myOut << "\tmovq " << record.second << "(%rbp), %rax\n";
+			myLocals[record.first] = base;
+			copy(Location{nullptr, base}, count);
+		}
+
+		stmts(fn->body());
+		if (type->ret() != myTypes.voidType()){
+			//Falling off the end returns 0
+			myOut << "\txorl %eax, %eax\n";
+		}
+		place(myReturn);
+		myOut << "\tleave\n\tret\n"
+		<< "\t.set .LF" << index << ", " << (myFrameMax + 15) / 16 * 16 << "\n";
+	}
+
+	void stmts(const NodeList<StmtNode *> * list){
+		for (const StmtNode * stmt : *list){ this->stmt(stmt); }
+	}
+
+	/* A block's variables' slots are free again after it */
+	void block(const NodeList<StmtNode *> * list){
+		int32_t mark = myFrame;
+		stmts(list);
+		myFrame = mark;
+	}
+
+	void stmt(const StmtNode * stmt){
+		switch (stmt->kind()){
+		case KIND_VAR_DECL: {
+			const VarDeclNode * decl = static_cast<const VarDeclNode *>(stmt);
+			uint32_t count = myLayout.slots(myTypes.of(decl));
+			int32_t base = alloc(count);
+			myLocals[decl] = base;
+			for (uint32_t i = 0; i < count; i++){
+				myOut << "\tmovq $0, " << base + 8 * static_cast<int32_t>(i)
+				<< "(%rbp)\n";
+			}
+			break;
+		}
+		case KIND_ASSIGN_STMT:
+			assign(static_cast<const AssignStmtNode *>(stmt)->assign());
+			break;
+		case KIND_CALL_STMT:
+			call(static_cast<const CallStmtNode *>(stmt)->call());
+			break;
+		case KIND_POST_INC_STMT:
+			myOut << "\taddl $1, ";
+			mem(lval(static_cast<const PostIncStmtNode *>(stmt)->lval()));
+			myOut << "\n";
+			break;
+		case KIND_POST_DEC_STMT:
+			myOut << "\tsubl $1, ";
+			mem(lval(static_cast<const PostDecStmtNode *>(stmt)->lval()));
+			myOut << "\n";
+			break;
+		case KIND_RECEIVE_STMT: {
+			const LValNode * target =
+				static_cast<const ReceiveStmtNode *>(stmt)->lval();
+			const DataType * type = myLayout.typeOf(target);
+			position(target);
+			runtime(type == myTypes.intType() ? "cshanty_receive_int"
+			  : type == myTypes.boolType() ? "cshanty_receive_bool"
+			  : "cshanty_receive_str");
+			myOut << "\tmovq %rax, ";
+			mem(lval(target));
+			myOut << "\n";
+			break;
+		}
+		case KIND_REPORT_STMT: {
+			const ExpNode * exp = static_cast<const ReportStmtNode *>(stmt)->exp();
+			const DataType * type = myLayout.typeOf(exp);
+			gen(exp);
+			myOut << "\tmovq %rax, %rdi\n";
+			runtime(type == myTypes.intType() ? "cshanty_report_int"
+			  : type == myTypes.boolType() ? "cshanty_report_bool"
+			  : "cshanty_report_str");
+			break;
+		}
+		case KIND_IF_STMT: {
+			const IfStmtNode * node = static_cast<const IfStmtNode *>(stmt);
+			uint32_t skip = label();
+			branch(node->cond(), false, skip);
+			block(node->body());
+			place(skip);
+			break;
+		}
+		case KIND_IF_ELSE_STMT: {
+			const IfElseStmtNode * node =
+				static_cast<const IfElseStmtNode *>(stmt);
+			uint32_t otherwise = label();
+			uint32_t end = label();
+			branch(node->cond(), false, otherwise);
+			block(node->thenBranch());
+			jump("jmp", end);
+			place(otherwise);
+			block(node->elseBranch());
+			place(end);
+			break;
+		}
+		case KIND_WHILE_STMT: {
+			//The test goes after the body, so each
+			// iteration takes a single jump
+			const WhileStmtNode * node = static_cast<const WhileStmtNode *>(stmt);
+			uint32_t body = label();
+			uint32_t test = label();
+			jump("jmp", test);
+			place(body);
+			block(node->body());
+			place(test);
+			branch(node->cond(), true, body);
+			break;
+		}
+		case KIND_RETURN_STMT: {
+			const ExpNode * exp = static_cast<const ReturnStmtNode *>(stmt)->exp();
+			if (exp != nullptr){ gen(exp); }
+			jump("jmp", myReturn);
+			break;
+		}
+		default:
+			error(stmt, "Unexpected declaration");
+		}
+	}
+
+	//Expressions
+
+	/* Compute exp into rax (a record's address, for a record) */
+	void gen(const ExpNode * exp){
+		switch (exp->kind()){
+		case KIND_INT_LIT:
+			myOut << "\tmovl $" << static_cast<const IntLitNode *>(exp)->value()
+			<< ", %eax\n";
+			break;
+		case KIND_STR_LIT:
+			myOut << "\tleaq .LS"
+			<< string(static_cast<const StrLitNode *>(exp)->text())
+			<< "(%rip), %rax\n";
+			break;
+		case KIND_TRUE:
+			myOut << "\tmovl $1, %eax\n";
+			break;
+		case KIND_FALSE:
+			myOut << "\txorl %eax, %eax\n";
+			break;
+		case KIND_ID:
+		case KIND_INDEX:
+			myOut << (myLayout.typeOf(exp)->kind() == DataType::RECORD
+			  ? "\tleaq " : "\tmovq ");
+			mem(lval(exp));
+			myOut << ", %rax\n";
+			break;
+		case KIND_ASSIGN_EXP:
+			assign(static_cast<const AssignExpNode *>(exp));
+			break;
+		case KIND_CALL_EXP:
+			call(static_cast<const CallExpNode *>(exp));
+			break;
+		case KIND_NEG:
+			gen(static_cast<const NegNode *>(exp)->exp());
+			myOut << "\tnegl %eax\n";
+			break;
+		case KIND_NOT:
+			gen(static_cast<const NotNode *>(exp)->exp());
+			myOut << "\txorl $1, %eax\n";
+			break;
+		case KIND_AND:
+		case KIND_OR: {
+			uint32_t isFalse = label();
+			uint32_t end = label();
+			branch(exp, false, isFalse);
+			myOut << "\tmovl $1, %eax\n";
+			jump("jmp", end);
+			place(isFalse);
+			myOut << "\txorl %eax, %eax\n";
+			place(end);
+			break;
+		}
+		default:
+			binary(static_cast<const BinaryExpNode *>(exp));
+			break;
+		}
+	}
+
+	void assign(const AssignExpNode * node){
+		Location loc = lval(node->lval());
+		const DataType * type = myLayout.typeOf(node->lval());
+		gen(node->exp());
+		if (type->kind() == DataType::RECORD){
+			copy(loc, myLayout.slots(type));
+			myOut << "\tleaq ";
+			mem(loc);
+			myOut << ", %rax\n";
+			return;
+		}
+		myOut << "\tmovq %rax, ";
+		mem(loc);
+		myOut << "\n";
+	}
+
+	/* The left operand into rax and the right into rcx */
+	void operands(const BinaryExpNode * exp){
+		const ExpNode * rhs = exp->rhs();
+		gen(exp->lhs());
+		if (rhs->kind() == KIND_INT_LIT){
+			myOut << "\tmovl $" << static_cast<const IntLitNode *>(rhs)->value()
+			<< ", %ecx\n";
+			return;
+		}
+		push();
+		gen(rhs);
+		myOut << "\tmovq %rax, %rcx\n";
+		pop("%rax");
+	}
+
+	void binary(const BinaryExpNode * exp){
+		NodeKind kind = exp->kind();
+		bool strings = myLayout.typeOf(exp->lhs()) == myTypes.stringType();
+		operands(exp);
+		switch (kind){
+		case KIND_PLUS: myOut << "\taddl %ecx, %eax\n"; return;
+		case KIND_MINUS: myOut << "\tsubl %ecx, %eax\n"; return;
+		case KIND_TIMES: myOut << "\timull %ecx, %eax\n"; return;
+		case KIND_DIVIDE: divide(exp); return;
+		default: break;
+		}
+		if (strings){
+			myOut << "\tmovq %rax, %rdi\n\tmovq %rcx, %rsi\n";
+			runtime("cshanty_streq");
+			if (kind == KIND_NOT_EQUALS){ myOut << "\txorl $1, %eax\n"; }
+			return;
+		}
+		myOut << "\tcmpl %ecx, %eax\n\tset" << condition(kind, false)
+		<< " %al\n\tmovzbl %al, %eax\n";
+	}
+
+	/*
+	idiv traps on a zero divisor and on INT_MIN / -1, so
+	the first is a runtime error and the second (which
+	wraps to INT_MIN) is done as a negation
+	*/
+	void divide(const BinaryExpNode * exp){
+		uint32_t nonzero = label();
+		uint32_t divide = label();
+		uint32_t end = label();
+		myOut << "\ttestl %ecx, %ecx\n";
+		jump("jne", nonzero);
+		position(exp);
+		myOut << "\tmovl %esi, %edx\n\tmovl %edi, %esi\n"
+		<< "\tleaq .LS" << string("Division by zero") << "(%rip), %rdi\n"
+		<< "\tandq $-16, %rsp\n\tcall cshanty_fail\n";
+		place(nonzero);
+		myOut << "\tcmpl $-1, %ecx\n";
+		jump("jne", divide);
+		myOut << "\tnegl %eax\n";
+		jump("jmp", end);
+		place(divide);
+		myOut << "\tcltd\n\tidivl %ecx\n";
+		place(end);
+	}
+
+	/*
+	Arguments are computed left to right onto the stack; the
+	first six are then loaded into registers and the rest
+	pushed again in the order the callee expects
+	*/
+	void call(const CallExpNode * node){
+		size_t argc = 0;
+		if (node->args() != nullptr){
+			for (const ExpNode * arg : *node->args()){
+				gen(arg);
+				push();
+				argc++;
+			}
+		}
+		size_t onStack = argc > REG_ARGS ? argc - REG_ARGS : 0;
+		size_t pad = (myDepth + onStack) % 2;
+		if (pad != 0){
+			myOut << "\tsubq $8, %rsp\n";
+			myDepth++;
+		}
+		for (size_t i = argc, pushed = 0; i > REG_ARGS; i--, pushed++){
+			myOut << "\tpushq " << 8 * (argc - i + pad + pushed) << "(%rsp)\n";
+			myDepth++;
+		}
+		for (size_t i = 0; i < argc && i < REG_ARGS; i++){
+			myOut << "\tmovq " << 8 * (argc - 1 - i + pad + onStack) << "(%rsp), "
+			<< ARG_REGS[i] << "\n";
+		}
+		myOut << "\tcall cs_f_" << node->callee()->getName() << "\n";
+		size_t drop = argc + pad + onStack;
+		if (drop != 0){
+			myOut << "\taddq $" << 8 * drop << ", %rsp\n";
+			myDepth -= static_cast<uint32_t>(drop);
+		}
+	}
+
+	/*
+	Jump to target when cond is when, and fall through when it
+	isn't; as in the bytecode compiler, and, or and not become
+	jumps alone and comparisons a compare and a jump
+	*/
+	void branch(const ExpNode * cond, bool when, uint32_t target){
+		NodeKind kind = cond->kind();
+		if (kind == KIND_TRUE || kind == KIND_FALSE){
+			if ((kind == KIND_TRUE) == when){ jump("jmp", target); }
+			return;
+		}
+		if (kind == KIND_NOT){
+			branch(static_cast<const NotNode *>(cond)->exp(), !when, target);
+			return;
+		}
+		if (kind == KIND_AND || kind == KIND_OR){
+			const BinaryExpNode * exp = static_cast<const BinaryExpNode *>(cond);
+			//Whether the left operand alone can decide
+			if ((kind == KIND_AND) != when){
+				branch(exp->lhs(), when, target);
+				branch(exp->rhs(), when, target);
+			} else {
+				uint32_t skip = label();
+				branch(exp->lhs(), !when, skip);
+				branch(exp->rhs(), when, target);
+				place(skip);
+			}
+			return;
+		}
+		if (isCompare(kind)){
+			const BinaryExpNode * exp = static_cast<const BinaryExpNode *>(cond);
+			if (myLayout.typeOf(exp->lhs()) != myTypes.stringType()){
+				operands(exp);
+				myOut << "\tcmpl %ecx, %eax\n\tj" << condition(kind, !when)
+				<< " .L" << target << "\n";
+				return;
+			}
+		}
+		gen(cond);
+		myOut << "\ttestl %eax, %eax\n";
+		jump(when ? "jne" : "je", target);
+	}
+
+	const LineTable& myLines;
+	TypeTable& myTypes;
+	Layout myLayout;
+	Writer& myOut;
+	uint32_t myLabels;
+	uint32_t myFunctions;
+	//Frame bytes in use, and the most the function needs
+	int32_t myFrame;
+	int32_t myFrameMax;
+	//Pushes outstanding, over the frame
+	uint32_t myDepth;
+	uint32_t myReturn;
+	std::unordered_map<const DeclNode *, int32_t> myLocals;
+	std::vector<std::string> myStrings;
+	std::unordered_map<std::string, uint32_t> myStringIndex;
+};
+
+void writeAssembly(const ProgramNode * root, const LineTable& lines,
+	TypeTable& types, Writer& out){
+	AsmGen gen(lines, types, out);
+	gen.program(root);
+}
+
+}
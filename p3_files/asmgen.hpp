@@ -0,0 +1,34 @@
+#ifndef CSHANTY_ASMGEN_H
+#define CSHANTY_ASMGEN_H
+
+#include "ast.hpp"
+#include "types.hpp"
+
+namespace cshanty{
+
+/**
+* Write the program under root to out as x86-64 GNU assembler text
+* (-o), for a System V target. root must have passed name analysis
+* and type checking, whose types come from types. The result is
+* linked with the runtime in runtime/cshantyrt.c, which supplies
+* main() and the helpers for report and receive.
+*
+* Every value takes one 8-byte slot (ints and bools in its low 32
+* bits, strings as pointers to NUL-terminated text) and a record one
+* slot per field, nested records inline. Functions follow the System
+* V calling convention: the first six arguments in rdi, rsi, rdx,
+* rcx, r8 and r9, the rest on the stack, the result in rax. A record
+* argument is passed as a pointer and copied by the callee. Runtime
+* errors (division by zero, bad input) are reported by the runtime
+* at the position of their source in lines.
+*
+* A program without a main() taking no arguments, or with a function
+* returning a record, is reported as a fatal error and abandoned
+* with an AbortError.
+**/
+void writeAssembly(const ProgramNode * root, const LineTable& lines,
+	TypeTable& types, Writer& out);
+
+}
+
+#endif
@@ -1,9 +1,42 @@
 #include "ast.hpp"
 
-cshanty::ProgramNode::ProgramNode(std::list<DeclNode *> * globalsIn)
-: ASTNode(new Position(0,0,0,0)), myGlobals(globalsIn){
+const char * cshanty::nodeKindName(NodeKind k){
+	static const char * const names[KIND_LIMIT] = {
+		"ASTNode",
+		"ProgramNode", "BoolTypeNode", "IntTypeNode", "RecordTypeNode",
+		"StringTypeNode", "VoidTypeNode",
+		"VarDeclNode", "FormalDeclNode", "FnDeclNode", "RecordTypeDeclNode",
+		"AssignStmtNode", "CallStmtNode", "IfElseStmtNode", "IfStmtNode",
+		"PostDecStmtNode", "PostIncStmtNode", "ReceiveStmtNode",
+		"ReportStmtNode", "WhileStmtNode", "ReturnStmtNode",
+		"AssignExpNode", "CallExpNode", "IntLitNode", "StrLitNode", "TrueNode",
+		"FalseNode", "IDNode", "IndexNode",
+		"AndNode", "DivideNode", "EqualsNode", "GreaterEqNode", "GreaterNode",
+		"LessEqNode", "LessNode", "MinusNode", "NotEqualsNode", "OrNode",
+		"PlusNode", "TimesNode",
+		"NegNode", "NotNode"
+	};
+	return k < KIND_LIMIT ? names[k] : names[0];
+}
+
+std::string cshanty::StrLitNode::text() const {
+	std::string text;
+	for (size_t i = 1; i + 1 < MyString.size(); i++){
+		char c = MyString[i];
+		if (c == '\\' && i + 2 < MyString.size()){
+			c = MyString[++i];
+			if (c == 'n'){ c = '\n'; }
+			else if (c == 't'){ c = '\t'; }
+		}
+		text += c;
+	}
+	return text;
+}
+
+cshanty::ProgramNode::ProgramNode(NodeList<DeclNode *> * globalsIn)
+: ASTNode(KIND_PROGRAM, Position()), myGlobals(globalsIn){
 	if (!globalsIn->empty()){
-		myPos->expand(
+		myPos.expand(
 			myGlobals->front()->pos(),
 			myGlobals->back()->pos()
 		);
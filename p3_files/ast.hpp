@@ -1,8 +1,8 @@
 #ifndef CSHANTYC_AST_HPP
 #define CSHANTYC_AST_HPP
 
-#include <ostream>
-#include <list>
+#include "arena.hpp"
+#include "writer.hpp"
 #include "tokens.hpp"
 
 // **********************************************************************
@@ -20,25 +20,77 @@ class StmtNode;
 class IDNode;
 class LValNode;
 class FormalDeclNode;
+class VarDeclNode;
 
+/**
+* The concrete class of a node, one kind per class. Kinds of the
+* same category are numbered contiguously (declarations within
+* statements, lvalues, binary and unary operators within
+* expressions), so a category check is a range check.
+**/
+enum NodeKind : uint16_t{
+	KIND_PROGRAM = 1,
+	KIND_BOOL_TYPE, KIND_INT_TYPE, KIND_RECORD_TYPE, KIND_STRING_TYPE,
+	KIND_VOID_TYPE,
+	KIND_VAR_DECL, KIND_FORMAL_DECL, KIND_FN_DECL, KIND_RECORD_TYPE_DECL,
+	KIND_ASSIGN_STMT, KIND_CALL_STMT, KIND_IF_ELSE_STMT, KIND_IF_STMT,
+	KIND_POST_DEC_STMT, KIND_POST_INC_STMT, KIND_RECEIVE_STMT,
+	KIND_REPORT_STMT, KIND_WHILE_STMT, KIND_RETURN_STMT,
+	KIND_ASSIGN_EXP, KIND_CALL_EXP, KIND_INT_LIT, KIND_STR_LIT, KIND_TRUE,
+	KIND_FALSE, KIND_ID, KIND_INDEX,
+	KIND_AND, KIND_DIVIDE, KIND_EQUALS, KIND_GREATER_EQ, KIND_GREATER,
+	KIND_LESS_EQ, KIND_LESS, KIND_MINUS, KIND_NOT_EQUALS, KIND_OR, KIND_PLUS,
+	KIND_TIMES,
+	KIND_NEG, KIND_NOT,
+	KIND_LIMIT
+};
+
+/** The name of the class whose nodes have kind k ("IDNode") **/
+const char * nodeKindName(NodeKind k);
+
+/**
+* Nodes carry their kind rather than a vtable: passes are
+* AstVisitors (see visitor.hpp) that switch on it, and the class
+* checks below compare it against each class's classof.
+**/
 class ASTNode{
 public:
-	ASTNode(Position * p) : myPos(p){ }
-	virtual void unparse(std::ostream& out, int indent) = 0;
-	Position * pos() { return myPos; }
-	std::string posStr() { return pos()->span(); }
+	ASTNode(NodeKind kind, Position p) : myPos(p), myKind(kind){ }
+	NodeKind kind() const { return myKind; }
+	/** Write this subtree's canonical form (unparse.cpp) **/
+	void unparse(Writer& out, int indent) const;
+	/** Move this subtree by delta bytes, after an edit before it **/
+	void shift(int32_t delta);
+	const Position& pos() const { return myPos; }
+	std::string posStr(const LineTable& lines) const {
+		return myPos.span(lines);
+	}
+	static bool classof(NodeKind k){ return true; }
 protected:
-	Position * myPos;
+	Position myPos;
+private:
+	NodeKind myKind;
 };
 
+/** node as a T, or null if it is null or not a T **/
+template <typename T>
+T * nodeCast(ASTNode * node){
+	return node != nullptr && T::classof(node->kind())
+	  ? static_cast<T *>(node) : nullptr;
+}
+
 /**  \class ExpNode
 * Superclass for expression nodes (i.e. nodes that can be used as
 * part of an expression).  Nodes that are part of an expression
 * should inherit from this abstract superclass.
 **/
 class ExpNode : public ASTNode{
+public:
+	static bool classof(NodeKind k){
+		return k >= KIND_ASSIGN_EXP && k <= KIND_NOT;
+	}
 protected:
-	ExpNode(Position * p) : ASTNode(p){ }
+	ExpNode(NodeKind kind, Position p) : ASTNode(kind, p){ }
 };
 
 /**
@@ -50,16 +102,21 @@ protected:
 **/
 class ProgramNode : public ASTNode{
 public:
-	ProgramNode(std::list<DeclNode *> * globalsIn) ;
-	void unparse(std::ostream& out, int indent) override;
+	ProgramNode(NodeList<DeclNode *> * globalsIn) ;
+	/** Same output as unparse, with globals unparsed on worker threads **/
+	void unparseParallel(Writer& out, unsigned jobs) const;
+	NodeList<DeclNode *> * globals() const { return myGlobals; }
+	static bool classof(NodeKind k){ return k == KIND_PROGRAM; }
 private:
-	std::list<DeclNode * > * myGlobals;
+	NodeList<DeclNode * > * myGlobals;
 };
 
 class StmtNode : public ASTNode{
 public:
-	StmtNode(Position * p) : ASTNode(p){ }
-	void unparse(std::ostream& out, int indent) override = 0;
+	StmtNode(NodeKind kind, Position p) : ASTNode(kind, p){ }
+	static bool classof(NodeKind k){
+		return k >= KIND_VAR_DECL && k <= KIND_RETURN_STMT;
+	}
 };
 
 /**  \class TypeNode
@@ -69,10 +126,12 @@ public:
 **/
 class TypeNode : public ASTNode{
 protected:
-	TypeNode(Position * p) : ASTNode(p){
+	TypeNode(NodeKind kind, Position p) : ASTNode(kind, p){
 	}
 public:
-	virtual void unparse(std::ostream& out, int indent) = 0;
+	static bool classof(NodeKind k){
+		return k >= KIND_BOOL_TYPE && k <= KIND_VOID_TYPE;
+	}
 	//virtual bool isRef(TypeNode* type);
 	//TODO: consider adding an isRef to use in unparse to
 	// indicate if this is a reference type
@@ -80,85 +139,109 @@ public:
 
 class AssignExpNode : public ExpNode{
 public:
-	AssignExpNode(Position * p, LValNode * lval, ExpNode * exp) : ExpNode(p), MyLVal(lval), MyExp(exp){}
-	void unparse(std::ostream& out, int indent);
+	AssignExpNode(Position p, LValNode * lval, ExpNode * exp) : ExpNode(KIND_ASSIGN_EXP, p), MyLVal(lval), MyExp(exp){}
+	LValNode * lval() const { return MyLVal; }
+	ExpNode * exp() const { return MyExp; }
+	static bool classof(NodeKind k){ return k == KIND_ASSIGN_EXP; }
 private:
 	LValNode * MyLVal;
 	ExpNode * MyExp;
 };
 
+/**
+* Every binary operator has the same shape; the subclasses differ
+* only in their kind.
+**/
 class BinaryExpNode : public ExpNode{
 public:
-	BinaryExpNode(Position * p, ExpNode * rhs, ExpNode * lhs) : ExpNode(p), MyRHS(rhs), MyLHS(lhs){}
-	void unparse(std::ostream& out, int indent) override = 0;
-protected:
-	ExpNode * MyRHS;
+	BinaryExpNode(NodeKind kind, Position p, ExpNode * lhs, ExpNode * rhs) : ExpNode(kind, p), MyLHS(lhs), MyRHS(rhs){}
+	ExpNode * lhs() const { return MyLHS; }
+	ExpNode * rhs() const { return MyRHS; }
+	static bool classof(NodeKind k){
+		return k >= KIND_AND && k <= KIND_TIMES;
+	}
+private:
 	ExpNode * MyLHS;
+	ExpNode * MyRHS;
 };
 
 class CallExpNode : public ExpNode {
 public:
-	CallExpNode(Position * p, IDNode* id, std::list<ExpNode*>* MyList) : ExpNode(p), MyId(id), MyList(MyList) { }
-	void unparse(std::ostream& out, int indent);
+	CallExpNode(Position p, IDNode* id, NodeList<ExpNode*>* MyList) : ExpNode(KIND_CALL_EXP, p), MyId(id), MyList(MyList) { }
+	IDNode * callee() const { return MyId; }
+	/** The arguments; null if there are none **/
+	NodeList<ExpNode *> * args() const { return MyList; }
+	static bool classof(NodeKind k){ return k == KIND_CALL_EXP; }
 private:
 	IDNode * MyId;
-	std::list<ExpNode * > * MyList;
+	NodeList<ExpNode * > * MyList;
 };
 
 class IntLitNode : public ExpNode{
 public:
-	IntLitNode(Position * p, int i) : ExpNode(p), MyInt(i){}
-	void unparse(std::ostream& out, int indent);
+	IntLitNode(Position p, int i) : ExpNode(KIND_INT_LIT, p), MyInt(i){}
+	int value() const { return MyInt; }
+	static bool classof(NodeKind k){ return k == KIND_INT_LIT; }
 private:
 	int MyInt;
 };
 
 class LValNode : public ExpNode{
 public:
-	LValNode(Position * p) : ExpNode(p){}
-	void unparse(std::ostream& out, int indent) override = 0;
+	LValNode(NodeKind kind, Position p) : ExpNode(kind, p){}
+	static bool classof(NodeKind k){
+		return k == KIND_ID || k == KIND_INDEX;
+	}
 };
 
 class StrLitNode : public ExpNode{
 public:
-	StrLitNode(Position * p, std::string str) : ExpNode(p), MyString(str){}
-	void unparse(std::ostream& out, int indent);
+	StrLitNode(Position p, StringRef str) : ExpNode(KIND_STR_LIT, p), MyString(str){}
+	StringRef str() const { return MyString; }
+	/** The literal's value: no quotes, and escapes interpreted **/
+	std::string text() const;
+	static bool classof(NodeKind k){ return k == KIND_STR_LIT; }
 private:
-	std::string MyString;
+	StringRef MyString;
 };
 
 class TrueNode : public ExpNode{
 	public:
-		TrueNode(Position* p) : ExpNode(p){ }
-		void unparse(std::ostream& out, int indent);
+		TrueNode(Position p) : ExpNode(KIND_TRUE, p){ }
+		static bool classof(NodeKind k){ return k == KIND_TRUE; }
 };
 
 class FalseNode : public ExpNode{
 	public:
-		FalseNode(Position* p) : ExpNode(p){ }
-		void unparse(std::ostream& out, int indent);
+		FalseNode(Position p) : ExpNode(KIND_FALSE, p){ }
+		static bool classof(NodeKind k){ return k == KIND_FALSE; }
 };
 
 class UnaryExpNode : public ExpNode{
 public:
-	UnaryExpNode(Position * p, ExpNode * rhs) : ExpNode(p), MyExp(rhs){}
-	void unparse(std::ostream& out, int indent) override = 0;
-protected:
+	UnaryExpNode(NodeKind kind, Position p, ExpNode * exp) : ExpNode(kind, p), MyExp(exp){}
+	ExpNode * exp() const { return MyExp; }
+	static bool classof(NodeKind k){
+		return k == KIND_NEG || k == KIND_NOT;
+	}
+private:
 	ExpNode* MyExp;
 };
 
 class AssignStmtNode : public StmtNode{
 public:
-	AssignStmtNode(Position * p, AssignExpNode* assign) : StmtNode(p), MyAssign(assign) { }
-	void unparse(std::ostream& out, int indent);
+	AssignStmtNode(Position p, AssignExpNode* assign) : StmtNode(KIND_ASSIGN_STMT, p), MyAssign(assign) { }
+	AssignExpNode * assign() const { return MyAssign; }
+	static bool classof(NodeKind k){ return k == KIND_ASSIGN_STMT; }
 private:
 	AssignExpNode * MyAssign;
 };
 
 class CallStmtNode : public StmtNode{
 public:
-	CallStmtNode(Position * p, CallExpNode* call) : StmtNode(p), myCall(call){ }
-	void unparse(std::ostream& out, int indent);
+	CallStmtNode(Position p, CallExpNode* call) : StmtNode(KIND_CALL_STMT, p), myCall(call){ }
+	CallExpNode * call() const { return myCall; }
+	static bool classof(NodeKind k){ return k == KIND_CALL_STMT; }
 private:
 	CallExpNode* myCall;
 };
@@ -169,216 +252,196 @@ private:
 **/
 class DeclNode : public StmtNode{
 public:
-	DeclNode(Position * p) : StmtNode(p) { }
-	void unparse(std::ostream& out, int indent) override = 0;
+	DeclNode(NodeKind kind, Position p) : StmtNode(kind, p) { }
+	static bool classof(NodeKind k){
+		return k >= KIND_VAR_DECL && k <= KIND_RECORD_TYPE_DECL;
+	}
 };
 
 class IfElseStmtNode : public StmtNode{
 	public:
-		IfElseStmtNode(Position* p, ExpNode* exp, std::list<StmtNode*>* tBranch, std::list<StmtNode*>* fBranch) : StmtNode(p), MyExp(exp), myTBranch(tBranch), myRBranch(fBranch) { }
-		void unparse(std::ostream& out, int indent);
+		IfElseStmtNode(Position p, ExpNode* exp, NodeList<StmtNode*>* tBranch, NodeList<StmtNode*>* fBranch) : StmtNode(KIND_IF_ELSE_STMT, p), MyExp(exp), myTBranch(tBranch), myRBranch(fBranch) { }
+		ExpNode * cond() const { return MyExp; }
+		NodeList<StmtNode *> * thenBranch() const { return myTBranch; }
+		NodeList<StmtNode *> * elseBranch() const { return myRBranch; }
+		static bool classof(NodeKind k){ return k == KIND_IF_ELSE_STMT; }
 	private:
 		ExpNode* MyExp;
-		std::list<StmtNode*>* myTBranch;
-		std::list<StmtNode*>* myRBranch;
+		NodeList<StmtNode*>* myTBranch;
+		NodeList<StmtNode*>* myRBranch;
 };
 
 class IfStmtNode : public StmtNode{
 	public:
-		IfStmtNode(Position* p, ExpNode* node, std::list<StmtNode*>* sList) : StmtNode(p), MyExp(node), myList(sList) { }
-		void unparse(std::ostream& out, int indent);
+		IfStmtNode(Position p, ExpNode* node, NodeList<StmtNode*>* sList) : StmtNode(KIND_IF_STMT, p), MyExp(node), myList(sList) { }
+		ExpNode * cond() const { return MyExp; }
+		NodeList<StmtNode *> * body() const { return myList; }
+		static bool classof(NodeKind k){ return k == KIND_IF_STMT; }
 	private:
 		ExpNode* MyExp;
-		std::list<StmtNode*>* myList;
+		NodeList<StmtNode*>* myList;
 };
 
 class PostDecStmtNode : public StmtNode{
 	public:
-		PostDecStmtNode(Position* p, LValNode* lval) : StmtNode(p) { }
-		void unparse(std::ostream& out, int indent);
+		PostDecStmtNode(Position p, LValNode* lval) : StmtNode(KIND_POST_DEC_STMT, p), myLVal(lval) { }
+		LValNode * lval() const { return myLVal; }
+		static bool classof(NodeKind k){ return k == KIND_POST_DEC_STMT; }
 	private:
 		LValNode* myLVal;
 };
 
 class PostIncStmtNode : public StmtNode{
 	public:
-		PostIncStmtNode(Position* p, LValNode* lval) : StmtNode(p) { }
-		void unparse(std::ostream& out, int indent);
+		PostIncStmtNode(Position p, LValNode* lval) : StmtNode(KIND_POST_INC_STMT, p), myLVal(lval) { }
+		LValNode * lval() const { return myLVal; }
+		static bool classof(NodeKind k){ return k == KIND_POST_INC_STMT; }
 	private:
 		LValNode* myLVal;
 };
 
 class ReceiveStmtNode : public StmtNode{
 	public:
-		ReceiveStmtNode(Position* p, LValNode* lval) : StmtNode(p) { }
-		void unparse(std::ostream& out, int indent);
+		ReceiveStmtNode(Position p, LValNode* lval) : StmtNode(KIND_RECEIVE_STMT, p), myLVal(lval) { }
+		LValNode * lval() const { return myLVal; }
+		static bool classof(NodeKind k){ return k == KIND_RECEIVE_STMT; }
 	private:
 		LValNode* myLVal;
 };
 
 class ReportStmtNode : public StmtNode{
 	public:
-		ReportStmtNode(Position* p, ExpNode* exp) : StmtNode(p){ }
-		void unparse(std::ostream& out, int indent);
+		ReportStmtNode(Position p, ExpNode* exp) : StmtNode(KIND_REPORT_STMT, p), myExp(exp){ }
+		ExpNode * exp() const { return myExp; }
+		static bool classof(NodeKind k){ return k == KIND_REPORT_STMT; }
 	private:
 		ExpNode* myExp;
 };
 
 class WhileStmtNode : public StmtNode{
 	public:
-		WhileStmtNode(Position* p, ExpNode* exp, std::list<StmtNode*>* sList) : StmtNode(p), MyExp(exp), my_List(sList) { }
-		void unparse(std::ostream& out, int indent);
+		WhileStmtNode(Position p, ExpNode* exp, NodeList<StmtNode*>* sList) : StmtNode(KIND_WHILE_STMT, p), MyExp(exp), my_List(sList) { }
+		ExpNode * cond() const { return MyExp; }
+		NodeList<StmtNode *> * body() const { return my_List; }
+		static bool classof(NodeKind k){ return k == KIND_WHILE_STMT; }
 	private:
 		ExpNode* MyExp;
-		std::list<StmtNode*>* my_List;
+		NodeList<StmtNode*>* my_List;
 };
 
 class ReturnStmtNode : public StmtNode{
 	public:
-		ReturnStmtNode(Position* p, ExpNode* exp) : StmtNode(p), myExp(exp) { }
-		void unparse(std::ostream& out, int indent);
+		ReturnStmtNode(Position p, ExpNode* exp) : StmtNode(KIND_RETURN_STMT, p), myExp(exp) { }
+		/** The returned value; null for a bare return **/
+		ExpNode * exp() const { return myExp; }
+		static bool classof(NodeKind k){ return k == KIND_RETURN_STMT; }
 	private:
 		ExpNode* myExp;
 };
 
 class BoolTypeNode : public TypeNode{
 public:
-	BoolTypeNode(Position * p) : TypeNode(p){ }
-	void unparse(std::ostream& out, int indent);
+	BoolTypeNode(Position p) : TypeNode(KIND_BOOL_TYPE, p){ }
+	static bool classof(NodeKind k){ return k == KIND_BOOL_TYPE; }
 };
 
 class IntTypeNode : public TypeNode{
 public:
-	IntTypeNode(Position * p) : TypeNode(p){ }
-	void unparse(std::ostream& out, int indent);
+	IntTypeNode(Position p) : TypeNode(KIND_INT_TYPE, p){ }
+	static bool classof(NodeKind k){ return k == KIND_INT_TYPE; }
 };
 
 class RecordTypeNode : public TypeNode{
 public:
-	RecordTypeNode(Position * p, IDNode * id) : TypeNode(p), MyId(id) { }
-	void unparse(std::ostream& out, int indent);
+	RecordTypeNode(Position p, IDNode * id) : TypeNode(KIND_RECORD_TYPE, p), MyId(id) { }
+	IDNode * id() const { return MyId; }
+	static bool classof(NodeKind k){ return k == KIND_RECORD_TYPE; }
 private:
 	IDNode * MyId;
 };
 
 class StringTypeNode : public TypeNode{
 public:
-	StringTypeNode(Position * p) : TypeNode(p){ }
-	void unparse(std::ostream& out, int indent);
+	StringTypeNode(Position p) : TypeNode(KIND_STRING_TYPE, p){ }
+	static bool classof(NodeKind k){ return k == KIND_STRING_TYPE; }
 };
 
 class VoidTypeNode : public TypeNode{
 public:
-	VoidTypeNode(Position * p) : TypeNode(p){ }
-	void unparse(std::ostream& out, int indent);
+	VoidTypeNode(Position p) : TypeNode(KIND_VOID_TYPE, p){ }
+	static bool classof(NodeKind k){ return k == KIND_VOID_TYPE; }
 };
 
 class AndNode: public BinaryExpNode{
 public:
-	AndNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), AndRNode(rhs), AndLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * AndRNode;
-	ExpNode * AndLNode;
+	AndNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_AND, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_AND; }
 };
 
 class DivideNode: public BinaryExpNode{
 public:
-	DivideNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), DivRNode(rhs), DivLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * DivRNode;
-	ExpNode * DivLNode;
+	DivideNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_DIVIDE, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_DIVIDE; }
 };
 
 class EqualsNode: public BinaryExpNode{
 public:
-	EqualsNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), EqRNode(rhs), EqLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * EqRNode;
-	ExpNode * EqLNode;
+	EqualsNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_EQUALS, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_EQUALS; }
 };
 
 class GreaterEqNode: public BinaryExpNode{
 public:
-	GreaterEqNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), GeqRNode(rhs), GeqLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * GeqRNode;
-	ExpNode * GeqLNode;
+	GreaterEqNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_GREATER_EQ, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_GREATER_EQ; }
 };
 
 class GreaterNode: public BinaryExpNode{
 public:
-	GreaterNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), GrRNode(rhs), GrLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * GrRNode;
-	ExpNode * GrLNode;
+	GreaterNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_GREATER, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_GREATER; }
 };
 
 class LessEqNode: public BinaryExpNode{
 public:
-	LessEqNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), LessRNode(rhs), LessLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * LessRNode;
-	ExpNode * LessLNode;
+	LessEqNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_LESS_EQ, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_LESS_EQ; }
 };
 
 class LessNode: public BinaryExpNode{
 public:
-	LessNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), LessRNode(rhs), LessLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * LessRNode;
-	ExpNode * LessLNode;
+	LessNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_LESS, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_LESS; }
 };
 
 class MinusNode: public BinaryExpNode{
 public:
-	MinusNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), MinusRNode(rhs), MinusLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * MinusRNode;
-	ExpNode * MinusLNode;
+	MinusNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_MINUS, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_MINUS; }
 };
 
 class NotEqualsNode: public BinaryExpNode{
 public:
-	NotEqualsNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), NotEqRNode(rhs), NotEqLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * NotEqRNode;
-	ExpNode * NotEqLNode;
+	NotEqualsNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_NOT_EQUALS, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_NOT_EQUALS; }
 };
 
 class OrNode: public BinaryExpNode{
 public:
-	OrNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), OrRNode(rhs), OrLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * OrRNode;
-	ExpNode * OrLNode;
+	OrNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_OR, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_OR; }
 };
 
 class PlusNode: public BinaryExpNode{
 public:
-	PlusNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), PlusRNode(rhs), PlusLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * PlusRNode;
-	ExpNode * PlusLNode;
+	PlusNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_PLUS, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_PLUS; }
 };
 
 class TimesNode: public BinaryExpNode{
 public:
-	TimesNode(Position * p, ExpNode * rhs, ExpNode * lhs) : BinaryExpNode(p, MyRHS, MyLHS), TimesRNode(rhs), TimesLNode(lhs){}
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * TimesRNode;
-	ExpNode * TimesLNode;
+	TimesNode(Position p, ExpNode * lhs, ExpNode * rhs) : BinaryExpNode(KIND_TIMES, p, lhs, rhs){}
+	static bool classof(NodeKind k){ return k == KIND_TIMES; }
 };
 
 /** An identifier. Note that IDNodes subclass
@@ -386,19 +449,32 @@ private:
 **/
 class IDNode : public LValNode{
 public:
-	IDNode(Position * p, std::string nameIn)
-	: LValNode(p), name(nameIn){ }
-	void unparse(std::ostream& out, int indent);
+	IDNode(Position p, Symbol nameIn)
+	: LValNode(KIND_ID, p), name(nameIn), myDecl(nullptr){ }
+	Symbol getName() const { return name; }
+	/**
+	* The declaration this names (a record field's, for the field of
+	* an IndexNode); null until names are analyzed (names.hpp)
+	**/
+	DeclNode * decl() const { return myDecl; }
+	void setDecl(DeclNode * declIn){ myDecl = declIn; }
+	static bool classof(NodeKind k){ return k == KIND_ID; }
 private:
-	/** The name of the identifier **/
-	std::string name;
+	/** The name of the identifier, as an interned symbol **/
+	Symbol name;
+	DeclNode * myDecl;
 };
 
 class IndexNode : public LValNode{
 public:
-	IndexNode(Position * p, IDNode* id1, IDNode* id2)
-	: LValNode(p), MyId1(id1), MyId2(id2){ }
-	void unparse(std::ostream& out, int indent);
+	IndexNode(Position p, IDNode* id1, IDNode* id2)
+	: LValNode(KIND_INDEX, p), MyId1(id1), MyId2(id2){ }
+	IDNode * recordId() const { return MyId1; }
+	IDNode * fieldId() const { return MyId2; }
+	/** Field lookups compare symbols, not strings **/
+	Symbol recordName() const { return MyId1->getName(); }
+	Symbol fieldName() const { return MyId2->getName(); }
+	static bool classof(NodeKind k){ return k == KIND_INDEX; }
 private:
 	IDNode* MyId1;
 	IDNode* MyId2;
@@ -406,18 +482,14 @@ private:
 
 class NegNode : public UnaryExpNode {
 public:
-	NegNode(Position * p, ExpNode * lhs) : UnaryExpNode(p, MyExp), NegLNode(lhs){ }
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * NegLNode;
+	NegNode(Position p, ExpNode * exp) : UnaryExpNode(KIND_NEG, p, exp){ }
+	static bool classof(NodeKind k){ return k == KIND_NEG; }
 };
 
 class NotNode : public UnaryExpNode {
 public:
-	NotNode(Position * p, ExpNode * lhs) : UnaryExpNode(p, MyExp), NotLNode(lhs){ }
-	void unparse(std::ostream& out, int indent);
-private:
-	ExpNode * NotLNode;
+	NotNode(Position p, ExpNode * exp) : UnaryExpNode(KIND_NOT, p, exp){ }
+	static bool classof(NodeKind k){ return k == KIND_NOT; }
 };
 
 
@@ -435,10 +507,18 @@ private:
 **/
 class VarDeclNode : public DeclNode{
 public:
-	VarDeclNode(Position * p, TypeNode * type, IDNode * id)
-	: DeclNode(p), myType(type), myId(id){
+	VarDeclNode(Position p, TypeNode * type, IDNode * id)
+	: VarDeclNode(KIND_VAR_DECL, p, type, id){
+	}
+	TypeNode * type() const { return myType; }
+	IDNode * id() const { return myId; }
+	static bool classof(NodeKind k){
+		return k == KIND_VAR_DECL || k == KIND_FORMAL_DECL;
+	}
+protected:
+	VarDeclNode(NodeKind kind, Position p, TypeNode * type, IDNode * id)
+	: DeclNode(kind, p), myType(type), myId(id){
 	}
-	void unparse(std::ostream& out, int indent);
 private:
 	TypeNode * myType;
 	IDNode * myId;
@@ -446,34 +526,38 @@ private:
 
 class FnDeclNode : public DeclNode{
 	public:
-		FnDeclNode(Position* p, TypeNode* type, IDNode* id, std::list<FormalDeclNode*>* fList, std::list<StmtNode*>* sList)
-		: DeclNode(p), myType(type), myId(id), MyFormalList(fList), MyStmtList(sList){ }
-		void unparse(std::ostream& out, int indent);
+		FnDeclNode(Position p, TypeNode* type, IDNode* id, NodeList<FormalDeclNode*>* fList, NodeList<StmtNode*>* sList)
+		: DeclNode(KIND_FN_DECL, p), myType(type), myId(id), MyFormalList(fList), MyStmtList(sList){ }
+		TypeNode * type() const { return myType; }
+		IDNode * id() const { return myId; }
+		/** The formals; null if there are none **/
+		NodeList<FormalDeclNode *> * formals() const { return MyFormalList; }
+		NodeList<StmtNode *> * body() const { return MyStmtList; }
+		static bool classof(NodeKind k){ return k == KIND_FN_DECL; }
 	private:
 		TypeNode* myType;
 		IDNode* myId;
-		std::list<FormalDeclNode*>* MyFormalList;
-		std::list<StmtNode*>* MyStmtList;
+		NodeList<FormalDeclNode*>* MyFormalList;
+		NodeList<StmtNode*>* MyStmtList;
 };
 
 class RecordTypeDeclNode : public DeclNode{
 public:
-	RecordTypeDeclNode(Position * p, IDNode * id, std::list<VarDeclNode*>* list)
-	: DeclNode(p), myId(id), MyVarDeclList(list){ }
-	void unparse(std::ostream& out, int indent);
+	RecordTypeDeclNode(Position p, IDNode * id, NodeList<VarDeclNode*>* list)
+	: DeclNode(KIND_RECORD_TYPE_DECL, p), myId(id), MyVarDeclList(list){ }
+	IDNode * id() const { return myId; }
+	NodeList<VarDeclNode *> * fields() const { return MyVarDeclList; }
+	static bool classof(NodeKind k){ return k == KIND_RECORD_TYPE_DECL; }
 private:
 	IDNode * myId;
-	std::list<VarDeclNode*>* MyVarDeclList;
+	NodeList<VarDeclNode*>* MyVarDeclList;
 };
 
 class FormalDeclNode : public VarDeclNode{
 	public:
-		FormalDeclNode(Position* p, TypeNode* type, IDNode* id)
-		: VarDeclNode(p, type, id), myType(type), myId(id){ }
-		void unparse(std::ostream& out, int indent);
-	private:
-		TypeNode* myType;
-		IDNode* myId;
+		FormalDeclNode(Position p, TypeNode* type, IDNode* id)
+		: VarDeclNode(KIND_FORMAL_DECL, p, type, id){ }
+		static bool classof(NodeKind k){ return k == KIND_FORMAL_DECL; }
 };
 
 } //End namespace cshanty
@@ -0,0 +1,169 @@
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include "astcache.hpp"
+
+namespace cshanty{
+
+static const char MAGIC[4] = {'C', 'S', 'A', 'S'};
+static const uint32_t VERSION = 4;
+
+//FNV-1a, 64-bit
+uint64_t AstCache::hash(const char * data, size_t size){
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++){
+		h ^= static_cast<unsigned char>(data[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/*
+Changes whenever astcache.cpp is rebuilt, which it is whenever
+ast.hpp or flatast.hpp change
+*/
+static uint64_t buildId(){
+	static const char BUILD[] = __DATE__ " " __TIME__ " " __VERSION__;
+	return AstCache::hash(BUILD, sizeof(BUILD) - 1);
+}
+
+std::string AstCache::entryPath(uint64_t sourceHash) const{
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.ast",
+		static_cast<unsigned long long>(sourceHash));
+	return myDir + name;
+}
+
+bool AstCache::load(CompilationContext& ctx, uint64_t sourceHash,
+	FlatAST& flat, std::string& diagnostics){
+	SourceFile file;
+	std::string path = entryPath(sourceHash);
+	if (!file.open(path.c_str()) || !file.mapped()){ return false; }
+
+	AstFileHeader header;
+	if (file.size() < sizeof(header)){ return false; }
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+	  || header.version != VERSION
+	  || header.sourceHash != sourceHash
+	  || header.buildId != buildId()
+	  || header.kindLimit != KIND_LIMIT
+	  || header.recordSize != sizeof(AstRecord)
+	  || header.sourceSize != ctx.source().size()
+	  || header.lines == 0){
+		return false;
+	}
+	uint64_t expect = sizeof(header)
+	  + uint64_t(header.lines) * sizeof(uint32_t)
+	  + uint64_t(header.nodes) * sizeof(AstRecord)
+	  + uint64_t(header.lists) * 2 * sizeof(uint32_t)
+	  + uint64_t(header.items) * sizeof(uint32_t)
+	  + header.diagnostics;
+	if (expect != file.size()){ return false; }
+
+	const char * cur = file.data() + sizeof(header);
+	const char * lineStarts = cur;
+	cur += header.lines * sizeof(uint32_t);
+	flat.clear();
+	flat.myNodes.resize(header.nodes);
+	memcpy(flat.myNodes.data(), cur, header.nodes * sizeof(AstRecord));
+	cur += header.nodes * sizeof(AstRecord);
+	flat.myLists.resize(header.lists * 2);
+	memcpy(flat.myLists.data(), cur, header.lists * 2 * sizeof(uint32_t));
+	cur += header.lists * 2 * sizeof(uint32_t);
+	flat.myItems.resize(header.items);
+	memcpy(flat.myItems.data(), cur, header.items * sizeof(uint32_t));
+	cur += header.items * sizeof(uint32_t);
+	flat.myRoot = header.root;
+	diagnostics.assign(cur, header.diagnostics);
+
+	//The only fixup: text comes back from the source
+	const SourceFile& src = ctx.source();
+	for (auto& rec : flat.myNodes){
+		if (rec.kind != KIND_ID && rec.kind != KIND_STR_LIT){ continue; }
+		if (rec.start > rec.end || rec.end > src.size()){
+			flat.clear();
+			return false;
+		}
+		const char * text = src.data() + rec.start;
+		size_t len = rec.end - rec.start;
+		if (rec.kind == KIND_ID){
+			rec.slot[0] = Interner::global().intern(text, len).id();
+		} else {
+			rec.slot[0] = static_cast<uint32_t>(flat.myStrings.size());
+			flat.myStrings.push_back(StringRef(text, len));
+		}
+	}
+	if (!flat.valid()){
+		flat.clear();
+		return false;
+	}
+
+	LineTable& lines = ctx.lines();
+	lines.clear();
+	for (uint32_t i = 1; i < header.lines; i++){
+		uint32_t start;
+		memcpy(&start, lineStarts + i * sizeof(start), sizeof(start));
+		lines.addLine(start);
+	}
+	return true;
+}
+
+/*
+Entries are written under a temporary name and renamed into
+place, so concurrent compilers never see half an entry.
+*/
+bool AstCache::store(CompilationContext& ctx, uint64_t sourceHash,
+	const FlatAST& flat, const std::string& diagnostics){
+	AstFileHeader header = AstFileHeader();
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.sourceHash = sourceHash;
+	header.buildId = buildId();
+	header.kindLimit = KIND_LIMIT;
+	header.recordSize = sizeof(AstRecord);
+	header.sourceSize = static_cast<uint32_t>(ctx.source().size());
+	header.lines = static_cast<uint32_t>(ctx.lines().lines());
+	header.nodes = static_cast<uint32_t>(flat.myNodes.size());
+	header.lists = static_cast<uint32_t>(flat.myLists.size() / 2);
+	header.items = static_cast<uint32_t>(flat.myItems.size());
+	header.root = flat.myRoot;
+	header.diagnostics = static_cast<uint32_t>(diagnostics.size());
+
+	std::string path = entryPath(sourceHash);
+	std::string tmp = path + ".tmp."
+	  + std::to_string(getpid()) + "."
+	  + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0){ return false; }
+	bool ok;
+	{
+		Writer out(fd);
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		const LineTable& lines = ctx.lines();
+		for (size_t line = 1; line <= lines.lines(); line++){
+			uint32_t start = lines.start(line);
+			out.write(reinterpret_cast<const char *>(&start), sizeof(start));
+		}
+		out.write(reinterpret_cast<const char *>(flat.myNodes.data()),
+			flat.myNodes.size() * sizeof(AstRecord));
+		out.write(reinterpret_cast<const char *>(flat.myLists.data()),
+			flat.myLists.size() * sizeof(uint32_t));
+		out.write(reinterpret_cast<const char *>(flat.myItems.data()),
+			flat.myItems.size() * sizeof(uint32_t));
+		out.write(diagnostics.data(), diagnostics.size());
+		out.flush();
+		ok = out.good();
+	}
+	ok = ::close(fd) == 0 && ok;
+	if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0){
+		::unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef CSHANTY_ASTCACHE_H
+#define CSHANTY_ASTCACHE_H
+
+#include <string>
+#include <vector>
+#include "flatast.hpp"
+#include "context.hpp"
+
+namespace cshanty{
+
+/*
+On-disk AST layout. All integers are 32-bit in host byte order
+except the 64-bit source hash.
+
+  header   magic "CSAS", version, hash of the source, the build
+           fingerprint (below), size of the source, then counts of
+           lines, nodes, lists and list items, the record number of
+           the ProgramNode and the length of the diagnostics
+  lines    start offset of each line
+  nodes    the FlatAST's records (see flatast.hpp)
+  lists    first item and item count
+  items    node numbers
+  diagnostics  what the scan and parse reported, replayed on a hit
+
+No text is stored, and the slots of ID and STR_LIT records are
+meaningless on disk. Identifiers and string literals are exactly
+the source bytes their positions cover, so they are recovered from
+the source (which the cache is only ever used alongside) on load.
+
+Records hold node kinds and the parser's token numbers, so an entry
+is only read by the build that wrote it: the fingerprint is a build
+id (a hash of when and by which compiler astcache.cpp was built),
+KIND_LIMIT and sizeof(AstRecord), and an entry whose fingerprint
+differs is a miss.
+*/
+struct AstFileHeader{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint64_t buildId;
+	uint32_t kindLimit;
+	uint32_t recordSize;
+	uint32_t sourceSize;
+	uint32_t lines;
+	uint32_t nodes;
+	uint32_t lists;
+	uint32_t items;
+	uint32_t root;
+	uint32_t diagnostics;
+};
+
+/**
+* \class AstCache
+* A directory of flattened ASTs named by a hash of the source they
+* came from. A hit skips the scanner and the parser entirely; the
+* warnings they gave are stored with the tree and reported again.
+**/
+class AstCache{
+public:
+	AstCache(const char * dir) : myDir(dir){ }
+
+	/** Content hash of a source file **/
+	static uint64_t hash(const char * data, size_t size);
+
+	/**
+	* Load the AST for ctx.source() into flat, and the diagnostics
+	* its parse gave into diagnostics, if it is cached. The line
+	* table is restored too. Returns false on a miss (or an
+	* unreadable entry).
+	**/
+	bool load(CompilationContext& ctx, uint64_t sourceHash, FlatAST& flat,
+		std::string& diagnostics);
+	/**
+	* Save flat, parsed from ctx.source() with diagnostics reported.
+	* Returns false on failure
+	**/
+	bool store(CompilationContext& ctx, uint64_t sourceHash,
+		const FlatAST& flat, const std::string& diagnostics);
+private:
+	std::string entryPath(uint64_t sourceHash) const;
+
+	std::string myDir;
+};
+
+}
+
+#endif
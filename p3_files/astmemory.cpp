@@ -0,0 +1,300 @@
+#include <iomanip>
+#include <unordered_set>
+#include "astmemory.hpp"
+#include "grammar.hh"
+#include "visitor.hpp"
+
+namespace cshanty{
+
+using TokenKind = cshanty::Parser::token;
+
+/*
+The size of each node class, and how many of its fields are
+pointers to children or to lists of them, by kind
+*/
+struct NodeLayout{
+	size_t bytes;
+	size_t children;
+};
+
+static const NodeLayout layouts[KIND_LIMIT] = {
+	{sizeof(ASTNode), 0},
+	{sizeof(ProgramNode), 1},
+	{sizeof(BoolTypeNode), 0},
+	{sizeof(IntTypeNode), 0},
+	{sizeof(RecordTypeNode), 1},
+	{sizeof(StringTypeNode), 0},
+	{sizeof(VoidTypeNode), 0},
+	{sizeof(VarDeclNode), 2},
+	{sizeof(FormalDeclNode), 2},
+	{sizeof(FnDeclNode), 4},
+	{sizeof(RecordTypeDeclNode), 2},
+	{sizeof(AssignStmtNode), 1},
+	{sizeof(CallStmtNode), 1},
+	{sizeof(IfElseStmtNode), 3},
+	{sizeof(IfStmtNode), 2},
+	{sizeof(PostDecStmtNode), 1},
+	{sizeof(PostIncStmtNode), 1},
+	{sizeof(ReceiveStmtNode), 1},
+	{sizeof(ReportStmtNode), 1},
+	{sizeof(WhileStmtNode), 2},
+	{sizeof(ReturnStmtNode), 1},
+	{sizeof(AssignExpNode), 2},
+	{sizeof(CallExpNode), 2},
+	{sizeof(IntLitNode), 0},
+	{sizeof(StrLitNode), 0},
+	{sizeof(TrueNode), 0},
+	{sizeof(FalseNode), 0},
+	{sizeof(IDNode), 0},
+	{sizeof(IndexNode), 2},
+	{sizeof(AndNode), 2},
+	{sizeof(DivideNode), 2},
+	{sizeof(EqualsNode), 2},
+	{sizeof(GreaterEqNode), 2},
+	{sizeof(GreaterNode), 2},
+	{sizeof(LessEqNode), 2},
+	{sizeof(LessNode), 2},
+	{sizeof(MinusNode), 2},
+	{sizeof(NotEqualsNode), 2},
+	{sizeof(OrNode), 2},
+	{sizeof(PlusNode), 2},
+	{sizeof(TimesNode), 2},
+	{sizeof(NegNode), 1},
+	{sizeof(NotNode), 1}
+};
+
+/*
+Each element of a std::list is a separately allocated cell holding
+the two links and the value (in libstdc++ and libc++ alike)
+*/
+template <typename T>
+static size_t listCellBytes(){
+	const size_t align = alignof(void *);
+	return 2 * sizeof(void *) + (sizeof(T) + align - 1) / align * align;
+}
+
+/** Walks a tree on behalf of AstMemory::measure **/
+class MemoryCounter : public AstVisitor<MemoryCounter>{
+public:
+	MemoryCounter(AstMemory& mem, const SourceFile& source)
+	: myMem(mem), mySource(source){ }
+
+	template <typename N>
+	void visitNode(N * node){
+		const NodeLayout& layout = layouts[node->kind()];
+		myMem.myNodes[node->kind()].add(1, layout.bytes);
+		myMem.myNodeTotal.add(1, layout.bytes);
+		myMem.myPositions.add(1, sizeof(Position));
+		myMem.myChildPointers.add(layout.children, sizeof(void *));
+		visitChildren(node);
+	}
+	template <typename N>
+	void visitProgram(N * node){
+		list("NodeList<DeclNode *>", node->globals());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitFnDecl(N * node){
+		list("NodeList<FormalDeclNode *>", node->formals());
+		list("NodeList<StmtNode *>", node->body());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitRecordTypeDecl(N * node){
+		list("NodeList<VarDeclNode *>", node->fields());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitIfElseStmt(N * node){
+		list("NodeList<StmtNode *>", node->thenBranch());
+		list("NodeList<StmtNode *>", node->elseBranch());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitIfStmt(N * node){
+		list("NodeList<StmtNode *>", node->body());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitWhileStmt(N * node){
+		list("NodeList<StmtNode *>", node->body());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitCallExp(N * node){
+		list("NodeList<ExpNode *>", node->args());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitStrLit(N * node){
+		StringRef str = node->str();
+		const char * text = mySource.data();
+		if (mySource.mapped() && str.data() >= text
+		  && str.data() < text + mySource.size()){
+			myMem.myStrInSource.add(1, str.size());
+		} else {
+			myMem.myStrCopied.add(1, str.size());
+		}
+		visitNode(node);
+	}
+	template <typename N>
+	void visitID(N * node){
+		Symbol name = node->getName();
+		if (myNames.insert(name.id()).second){
+			myMem.myNames.add(1, name.length() + 1);
+		}
+		visitNode(node);
+	}
+private:
+	template <typename T>
+	void list(const char * type, const NodeList<T> * elts){
+		if (elts == nullptr){ return; }
+		myMem.myLists[type].add(1, sizeof(NodeList<T>));
+		myMem.myLists[type].bytes += elts->size() * listCellBytes<T>();
+		myMem.myListCells.add(elts->size(), listCellBytes<T>());
+	}
+
+	AstMemory& myMem;
+	const SourceFile& mySource;
+	std::unordered_set<uint32_t> myNames;
+};
+
+static const char * tokenClass(int kind, size_t * bytes){
+	switch (kind){
+	case TokenKind::ID:
+		*bytes = sizeof(IDToken);
+		return "IDToken";
+	case TokenKind::STRLITERAL:
+		*bytes = sizeof(StrToken);
+		return "StrToken";
+	case TokenKind::INTLITERAL:
+		*bytes = sizeof(IntLitToken);
+		return "IntLitToken";
+	default:
+		*bytes = sizeof(Token);
+		return "Token";
+	}
+}
+
+/*
+A streamed source has no size of its own; the
+end of the last token stands in for it
+*/
+void AstMemory::measure(const ProgramNode * root, const SourceFile& source,
+	const std::vector<Token *>& tokens){
+	*this = AstMemory();
+	mySourceBytes = source.mapped() ? source.size() : 0;
+	if (mySourceBytes == 0 && !tokens.empty()){
+		mySourceBytes = tokens.back()->pos().end();
+	}
+	for (const Token * token : tokens){
+		size_t bytes;
+		const char * cls = tokenClass(token->kind(), &bytes);
+		myTokens[cls].add(1, bytes);
+	}
+	MemoryCounter counter(*this, source);
+	counter.visit(root);
+}
+
+size_t AstMemory::totalBytes() const {
+	size_t total = myNodeTotal.bytes + myStrCopied.bytes;
+	for (const auto& list : myLists){ total += list.second.bytes; }
+	for (const auto& token : myTokens){ total += token.second.bytes; }
+	return total;
+}
+
+double AstMemory::bytesPerSourceByte() const {
+	if (mySourceBytes == 0){ return 0; }
+	return static_cast<double>(totalBytes())
+	  / static_cast<double>(mySourceBytes);
+}
+
+static void usageRow(std::ostream& out, const std::string& name,
+	const AstMemory::Usage& usage){
+	out << "    " << std::left << std::setw(28) << name
+	<< std::right << std::setw(12) << usage.count
+	<< std::setw(14) << usage.bytes << "\n";
+}
+
+void AstMemory::writeText(std::ostream& out) const {
+	std::ios::fmtflags flags = out.flags();
+	out << "AST memory: " << totalBytes() << " bytes for "
+	<< mySourceBytes << " bytes of source ("
+	<< std::fixed << std::setprecision(2) << bytesPerSourceByte()
+	<< " per byte)\n";
+	out << "  " << std::left << std::setw(30) << "node class"
+	<< std::right << std::setw(12) << "count"
+	<< std::setw(14) << "bytes" << "\n";
+	for (size_t k = 0; k < KIND_LIMIT; k++){
+		if (myNodes[k].count == 0){ continue; }
+		usageRow(out, nodeKindName(static_cast<NodeKind>(k)), myNodes[k]);
+	}
+	usageRow(out, "(all nodes)", myNodeTotal);
+	usageRow(out, "(positions, in nodes)", myPositions);
+	usageRow(out, "(child pointers, in nodes)", myChildPointers);
+	out << "  " << std::left << std::setw(30) << "list type"
+	<< std::right << std::setw(12) << "lists"
+	<< std::setw(14) << "bytes" << "\n";
+	for (const auto& list : myLists){ usageRow(out, list.first, list.second); }
+	usageRow(out, "(cells, in lists)", myListCells);
+	out << "  " << std::left << std::setw(30) << "auxiliary"
+	<< std::right << std::setw(12) << "count"
+	<< std::setw(14) << "bytes" << "\n";
+	for (const auto& token : myTokens){ usageRow(out, token.first, token.second); }
+	usageRow(out, "string text (copied)", myStrCopied);
+	usageRow(out, "string text (in source)", myStrInSource);
+	usageRow(out, "names (interned, shared)", myNames);
+	out.flags(flags);
+}
+
+static void usageJSON(std::ostream& out, const AstMemory::Usage& usage){
+	out << "{\"count\": " << usage.count << ", \"bytes\": " << usage.bytes
+	<< "}";
+}
+
+void AstMemory::writeJSON(std::ostream& out) const {
+	std::ios::fmtflags flags = out.flags();
+	out << "{\"total_bytes\": " << totalBytes()
+	<< ", \"source_bytes\": " << mySourceBytes
+	<< ", \"bytes_per_source_byte\": " << std::fixed << std::setprecision(3)
+	<< bytesPerSourceByte() << ", \"nodes\": {";
+	const char * sep = "";
+	for (size_t k = 0; k < KIND_LIMIT; k++){
+		if (myNodes[k].count == 0){ continue; }
+		out << sep << "\"" << nodeKindName(static_cast<NodeKind>(k)) << "\": ";
+		usageJSON(out, myNodes[k]);
+		sep = ", ";
+	}
+	out << "}, \"all_nodes\": ";
+	usageJSON(out, myNodeTotal);
+	out << ", \"positions\": ";
+	usageJSON(out, myPositions);
+	out << ", \"child_pointers\": ";
+	usageJSON(out, myChildPointers);
+	out << ", \"lists\": {";
+	sep = "";
+	for (const auto& list : myLists){
+		out << sep << "\"" << list.first << "\": ";
+		usageJSON(out, list.second);
+		sep = ", ";
+	}
+	out << "}, \"list_cells\": ";
+	usageJSON(out, myListCells);
+	out << ", \"tokens\": {";
+	sep = "";
+	for (const auto& token : myTokens){
+		out << sep << "\"" << token.first << "\": ";
+		usageJSON(out, token.second);
+		sep = ", ";
+	}
+	out << "}, \"strings_copied\": ";
+	usageJSON(out, myStrCopied);
+	out << ", \"strings_in_source\": ";
+	usageJSON(out, myStrInSource);
+	out << ", \"names\": ";
+	usageJSON(out, myNames);
+	out << "}";
+	out.flags(flags);
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef CSHANTY_ASTMEMORY_H
+#define CSHANTY_ASTMEMORY_H
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <vector>
+#include "ast.hpp"
+#include "source.hpp"
+
+namespace cshanty{
+
+/**
+* \class AstMemory
+* Where the memory of a parsed tree goes: bytes and instances of each
+* node class, of the lists by element type (the list objects plus a
+* cell per element), and of what hangs off the nodes: positions and
+* child pointers (both inside the nodes), the tokens the parser was
+* fed, and the text of string literals and identifiers. Bytes are
+* what the arena handed out for each object, so the total can be set
+* against the arena's own count (-m) and the size of the source.
+**/
+class AstMemory{
+public:
+	struct Usage{
+		size_t count = 0;
+		size_t bytes = 0;
+		void add(size_t n, size_t size){
+			count += n;
+			bytes += n * size;
+		}
+	};
+
+	AstMemory(){ }
+	/*
+	Account for the tree under root, parsed from source. tokens are
+	those the parser was fed, if they were recorded (else empty).
+	*/
+	void measure(const ProgramNode * root, const SourceFile& source,
+		const std::vector<Token *>& tokens);
+
+	const Usage& nodeClass(NodeKind k) const { return myNodes[k]; }
+	/** Node bytes, tokens, lists and copied string text **/
+	size_t totalBytes() const;
+	double bytesPerSourceByte() const;
+
+	void writeText(std::ostream& out) const;
+	/** A JSON object, without a trailing newline **/
+	void writeJSON(std::ostream& out) const;
+private:
+	friend class MemoryCounter;
+
+	Usage myNodes[KIND_LIMIT];
+	Usage myNodeTotal;
+	Usage myPositions;
+	Usage myChildPointers;
+	std::map<std::string, Usage> myLists;
+	Usage myListCells;
+	std::map<std::string, Usage> myTokens;
+	//Literal text pointing into the source, and copied out of it
+	Usage myStrInSource;
+	Usage myStrCopied;
+	//Distinct identifier names, held once by the interner
+	Usage myNames;
+	size_t mySourceBytes = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include "batch.hpp"
+#include "errors.hpp"
+#include "interner.hpp"
+
+namespace cshanty{
+
+struct BatchJob{
+	std::string input;
+	std::string tokensPath;
+	std::string streamPath;
+	std::string unparsePath;
+	std::string statsPath;
+	std::string asmPath;
+	std::ostringstream out;
+	std::ostringstream err;
+	int status = 0;
+	bool done = false;
+};
+
+static std::string outputPath(const char * dir, const std::string& input,
+	const char * ext){
+	std::string name = input;
+	size_t slash = name.find_last_of('/');
+	if (slash != std::string::npos){ name = name.substr(slash + 1); }
+	const std::string suffix = ".cshanty";
+	if (name.size() > suffix.size()
+	  && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0){
+		name.erase(name.size() - suffix.size());
+	}
+	return std::string(dir) + "/" + name + ext;
+}
+
+/*
+Sets path to where input's ext output goes in dir, if there is a
+dir. False, having said so, if another input already claimed it
+*/
+static bool claimOutput(const char * dir, const std::string& input,
+	const char * ext, std::set<std::string>& seen, std::string& path){
+	if (dir == nullptr){ return true; }
+	path = outputPath(dir, input, ext);
+	if (seen.insert(path).second){ return true; }
+	std::cerr << "Two inputs would both write " << path << std::endl;
+	return false;
+}
+
+static void compileOne(const DriverOptions& opts, BatchJob& job){
+	DriverOptions fileOpts = opts;
+	if (opts.tokensFile != nullptr){
+		fileOpts.tokensFile = job.tokensPath.c_str();
+	}
+	if (opts.tokenStreamFile != nullptr){
+		fileOpts.tokenStreamFile = job.streamPath.c_str();
+	}
+	if (opts.unparseFile != nullptr){
+		fileOpts.unparseFile = job.unparsePath.c_str();
+	}
+	if (opts.statsFile != nullptr){
+		fileOpts.statsFile = job.statsPath.c_str();
+	}
+	if (opts.asmFile != nullptr){
+		fileOpts.asmFile = job.asmPath.c_str();
+	}
+
+	Report::redirect(&job.err, &job.out);
+	try {
+		Driver driver(fileOpts);
+		if (!driver.run(job.input.c_str())){ job.status = 1; }
+	} catch (InternalError * e){
+		job.err << "Error: " << e->msg() << std::endl;
+		job.status = 1;
+	} catch (AbortError * e){
+		job.status = e->code();
+	}
+	Report::redirect(nullptr, nullptr);
+}
+
+int runBatch(const DriverOptions& opts,
+	const std::vector<std::string>& inputs, unsigned jobs){
+	std::vector<BatchJob> work(inputs.size());
+	std::set<std::string> outputs;
+	for (size_t i = 0; i < inputs.size(); i++){
+		BatchJob& job = work[i];
+		job.input = inputs[i];
+		if (!claimOutput(opts.tokensFile, job.input, ".tokens", outputs,
+		    job.tokensPath)
+		  || !claimOutput(opts.tokenStreamFile, job.input, ".tokbin", outputs,
+		    job.streamPath)
+		  || !claimOutput(opts.unparseFile, job.input, ".unparse", outputs,
+		    job.unparsePath)
+		  || !claimOutput(opts.statsFile, job.input, ".stats.json", outputs,
+		    job.statsPath)
+		  || !claimOutput(opts.asmFile, job.input, ".s", outputs,
+		    job.asmPath)){
+			return 1;
+		}
+	}
+
+	if (jobs == 0){ jobs = std::thread::hardware_concurrency(); }
+	if (jobs == 0){ jobs = 1; }
+	if (jobs > work.size()){ jobs = static_cast<unsigned>(work.size()); }
+	Interner::global().setConcurrent(jobs > 1);
+
+	std::atomic<size_t> next(0);
+	std::mutex lock;
+	std::condition_variable finished;
+	auto worker = [&](){
+		while (true){
+			size_t i = next++;
+			if (i >= work.size()){ return; }
+			compileOne(opts, work[i]);
+			std::lock_guard<std::mutex> guard(lock);
+			work[i].done = true;
+			finished.notify_one();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned t = 0; t < jobs; t++){ pool.emplace_back(worker); }
+
+	//Stream each file's output as soon as it and
+	// every file before it are done
+	int status = 0;
+	for (BatchJob& job : work){
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			finished.wait(guard, [&job](){ return job.done; });
+		}
+		std::cout << job.out.str() << std::flush;
+		std::cerr << job.err.str() << std::flush;
+		if (job.status > status){ status = job.status; }
+	}
+
+	for (auto& thread : pool){ thread.join(); }
+	Interner::global().setConcurrent(false);
+	return status;
+}
+
+bool readResponseFile(const char * path, std::vector<std::string>& inputs){
+	std::ifstream in(path);
+	if (!in.good()){ return false; }
+	std::string input;
+	while (in >> input){ inputs.push_back(input); }
+	return true;
+}
+
+}
@@ -0,0 +1,31 @@
+#ifndef CSHANTY_BATCH_H
+#define CSHANTY_BATCH_H
+
+#include <string>
+#include <vector>
+#include "driver.hpp"
+
+namespace cshanty{
+
+/**
+* Compile many inputs on a pool of worker threads, each file with its
+* own Driver (and thus its own arena and line table). The -t, -u, -o
+* and -stats-json paths in opts name output directories; each input
+* writes <dir>/<name>.tokens, <dir>/<name>.unparse, <dir>/<name>.s and
+* <dir>/<name>.stats.json, where <name> is its file name minus any
+* .cshanty extension. The peak RSS in each file's stats is that of
+* the whole process.
+*
+* Everything a file would print to stdout or stderr is buffered and
+* emitted in input order, so output doesn't depend on scheduling.
+* Returns the exit status for the whole batch.
+**/
+int runBatch(const DriverOptions& opts,
+	const std::vector<std::string>& inputs, unsigned jobs);
+
+/** Append the whitespace-separated paths listed in a response file **/
+bool readResponseFile(const char * path, std::vector<std::string>& inputs);
+
+}
+
+#endif
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "errors.hpp"
+#include "fastscanner.hpp"
+#include "scanner.hpp"
+#include "visitor.hpp"
+
+using namespace cshanty;
+
+/*
+cshantybench times the phases of cshantyc on each input separately:
+scanning (into a token buffer), parsing (from that buffer, so no
+scanning is counted) and unparsing (to /dev/null). Every repetition
+starts from an empty arena. Results are printed as a table and, with
+-json, appended to a file as one JSON object per file and phase.
+*/
+
+static void usageAndDie(){
+	std::cerr << "Usage: cshantybench [-r <reps>] [-s] [-j <jobs>]"
+	<< " [-json <resultsFile>] <infile>...\n"
+	<< " [-r <reps>]: Repetitions per input (default 5)\n"
+	<< " [-s]: Scan with the hand-written scanner instead of flex\n"
+	<< " [-j <jobs>]: Unparse with <jobs> threads\n"
+	<< " [-json <resultsFile>]: Append JSON results to <resultsFile>\n"
+	;
+	exit(1);
+}
+
+/** Counts the nodes in a tree **/
+class NodeCounter : public AstVisitor<NodeCounter>{
+public:
+	NodeCounter() : myCount(0){ }
+	template <typename N>
+	void visitNode(N * node){
+		myCount++;
+		visitChildren(node);
+	}
+	size_t count() const { return myCount; }
+private:
+	size_t myCount;
+};
+
+/** Timings of one phase over all repetitions, in milliseconds **/
+class Samples{
+public:
+	void add(double ms){ myMs.push_back(ms); }
+	double min() const { return *std::min_element(myMs.begin(), myMs.end()); }
+	double max() const { return *std::max_element(myMs.begin(), myMs.end()); }
+	double median() const {
+		std::vector<double> sorted(myMs);
+		std::sort(sorted.begin(), sorted.end());
+		size_t mid = sorted.size() / 2;
+		if (sorted.size() % 2 == 1){ return sorted[mid]; }
+		return (sorted[mid - 1] + sorted[mid]) / 2;
+	}
+	double mean() const {
+		double sum = 0;
+		for (double ms : myMs){ sum += ms; }
+		return sum / static_cast<double>(myMs.size());
+	}
+	double stddev() const {
+		if (myMs.size() < 2){ return 0; }
+		double avg = mean();
+		double sum = 0;
+		for (double ms : myMs){ sum += (ms - avg) * (ms - avg); }
+		return std::sqrt(sum / static_cast<double>(myMs.size() - 1));
+	}
+	size_t size() const { return myMs.size(); }
+private:
+	std::vector<double> myMs;
+};
+
+struct BenchOptions{
+	unsigned reps = 5;
+	bool fastScan = false;
+	unsigned jobs = 1;
+	const char * jsonFile = nullptr;
+};
+
+struct FileResult{
+	std::string path;
+	size_t bytes = 0;
+	size_t tokens = 0;
+	size_t nodes = 0;
+	Samples scan;
+	Samples parse;
+	Samples unparse;
+};
+
+static double msSince(std::chrono::steady_clock::time_point start){
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+/*
+One repetition. Returns false if the input doesn't scan or parse,
+which makes its numbers meaningless.
+*/
+static bool runOnce(CompilationContext& ctx, const BenchOptions& opts,
+	int nullFd, FileResult& result){
+	using Clock = std::chrono::steady_clock;
+	ctx.reset();
+	std::vector<Token *> tokens;
+
+	Clock::time_point start = Clock::now();
+	{
+		std::unique_ptr<TokenSource> scanner;
+		if (opts.fastScan){
+			scanner.reset(new FastScanner(ctx));
+		} else {
+			scanner.reset(new Scanner(ctx));
+		}
+		scanner->record(&tokens);
+		scanner->drain();
+	}
+	result.scan.add(msSince(start));
+	result.tokens = tokens.size();
+
+	ProgramNode * root = nullptr;
+	start = Clock::now();
+	{
+		TokenRun run(ctx, tokens, tokens.back()->pos().end());
+		Parser parser(run, &root);
+		if (parser.parse() != 0){ root = nullptr; }
+	}
+	result.parse.add(msSince(start));
+	if (root == nullptr){ return false; }
+	if (result.nodes == 0){
+		NodeCounter counter;
+		counter.visit(root);
+		result.nodes = counter.count();
+	}
+
+	start = Clock::now();
+	{
+		Writer out(nullFd);
+		root->unparseParallel(out, opts.jobs);
+	}
+	result.unparse.add(msSince(start));
+	return true;
+}
+
+static void printPhase(const FileResult& result, const char * phase,
+	const Samples& samples){
+	double seconds = samples.median() / 1000;
+	printf("  %-8s %10.2f %10.2f %10.2f %8.2f %9.1f %9.2f %9.2f\n",
+		phase, samples.median(), samples.min(), samples.max(),
+		samples.stddev(),
+		static_cast<double>(result.bytes) / 1e6 / seconds,
+		static_cast<double>(result.tokens) / 1e6 / seconds,
+		static_cast<double>(result.nodes) / 1e6 / seconds);
+}
+
+static void printResult(const FileResult& result){
+	printf("%s: %zu bytes, %zu tokens, %zu nodes, %zu reps\n",
+		result.path.c_str(), result.bytes, result.tokens, result.nodes,
+		result.scan.size());
+	printf("  %-8s %10s %10s %10s %8s %9s %9s %9s\n", "phase",
+		"median ms", "min ms", "max ms", "stddev", "MB/s",
+		"Mtok/s", "Mnodes/s");
+	printPhase(result, "scan", result.scan);
+	printPhase(result, "parse", result.parse);
+	printPhase(result, "unparse", result.unparse);
+}
+
+static void jsonString(FILE * out, const std::string& str){
+	fputc('"', out);
+	for (char c : str){
+		if (c == '"' || c == '\\'){ fputc('\\', out); }
+		if (static_cast<unsigned char>(c) < 0x20){
+			fprintf(out, "\\u%04x", c);
+		} else {
+			fputc(c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+static void jsonPhase(FILE * out, const BenchOptions& opts,
+	const FileResult& result, const char * phase, const Samples& samples){
+	double seconds = samples.median() / 1000;
+	fprintf(out, "{\"file\": ");
+	jsonString(out, result.path);
+	fprintf(out, ", \"scanner\": \"%s\", \"phase\": \"%s\""
+		", \"bytes\": %zu, \"tokens\": %zu, \"nodes\": %zu, \"reps\": %zu"
+		", \"median_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f"
+		", \"mean_ms\": %.4f, \"stddev_ms\": %.4f"
+		", \"mb_per_s\": %.3f, \"tokens_per_s\": %.0f, \"nodes_per_s\": %.0f}\n",
+		opts.fastScan ? "fast" : "flex", phase,
+		result.bytes, result.tokens, result.nodes, samples.size(),
+		samples.median(), samples.min(), samples.max(),
+		samples.mean(), samples.stddev(),
+		static_cast<double>(result.bytes) / 1e6 / seconds,
+		static_cast<double>(result.tokens) / seconds,
+		static_cast<double>(result.nodes) / seconds);
+}
+
+int main(int argc, const char ** argv){
+	BenchOptions opts;
+	std::vector<const char *> inFiles;
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (arg == "-s"){
+			opts.fastScan = true;
+		} else if (arg == "-r" || arg == "-j" || arg == "-json"){
+			if (++i >= argc){ usageAndDie(); }
+			if (arg == "-r"){
+				opts.reps = static_cast<unsigned>(atoi(argv[i]));
+				if (opts.reps == 0){ usageAndDie(); }
+			} else if (arg == "-j"){
+				opts.jobs = static_cast<unsigned>(atoi(argv[i]));
+			} else {
+				opts.jsonFile = argv[i];
+			}
+		} else if (arg[0] == '-'){
+			std::cerr << "Unrecognized argument: " << arg << std::endl;
+			usageAndDie();
+		} else {
+			inFiles.push_back(argv[i]);
+		}
+	}
+	if (inFiles.empty()){ usageAndDie(); }
+
+	FILE * json = nullptr;
+	if (opts.jsonFile != nullptr){
+		json = fopen(opts.jsonFile, "a");
+		if (json == nullptr){
+			std::cerr << "Bad results file " << opts.jsonFile << std::endl;
+			return 1;
+		}
+	}
+	int nullFd = ::open("/dev/null", O_WRONLY);
+
+	//The parser's chatter would swamp the numbers
+	std::ostream discard(nullptr);
+	int status = 0;
+	for (const char * path : inFiles){
+		CompilationContext ctx;
+		FileResult result;
+		result.path = path;
+		if (!ctx.source().open(path) || !ctx.source().mapped()){
+			std::cerr << "Bad input file " << path << std::endl;
+			status = 1;
+			continue;
+		}
+		result.bytes = ctx.source().size();
+
+		bool ok = true;
+		Report::redirect(&discard, &discard);
+		try {
+			for (unsigned rep = 0; ok && rep < opts.reps; rep++){
+				ok = runOnce(ctx, opts, nullFd, result);
+			}
+		} catch (AbortError * e){
+			ok = false;
+		}
+		Report::redirect(nullptr, nullptr);
+		if (!ok){
+			std::cerr << path << " doesn't compile; skipped" << std::endl;
+			status = 1;
+			continue;
+		}
+		printResult(result);
+		if (json != nullptr){
+			jsonPhase(json, opts, result, "scan", result.scan);
+			jsonPhase(json, opts, result, "parse", result.parse);
+			jsonPhase(json, opts, result, "unparse", result.unparse);
+		}
+	}
+	if (json != nullptr){ fclose(json); }
+	::close(nullFd);
+	return status;
+}
@@ -0,0 +1,606 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+cshantygen writes a random cshanty program of (about) a given size.
+The same seed, shape and size always give the same program. Programs
+are not just syntactically valid: every name is declared before it's
+used, expressions are well typed, calls match their callee, divisors
+are non-zero literals and every loop counts up to a small bound, so
+later phases can be timed on them too.
+*/
+
+/** splitmix64; the same stream on every platform **/
+class Rng{
+public:
+	explicit Rng(uint64_t seed) : myState(seed){ }
+	uint64_t next(){
+		uint64_t z = (myState += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+	unsigned below(unsigned n){ return static_cast<unsigned>(next() % n); }
+	unsigned between(unsigned lo, unsigned hi){ return lo + below(hi - lo + 1); }
+	bool chance(unsigned percent){ return below(100) < percent; }
+private:
+	uint64_t myState;
+};
+
+/** What a program looks like; each shape is a preset of these **/
+struct Shape{
+	const char * name;
+	//Statements per function body, at most
+	unsigned stmts;
+	//Nesting of expressions, at most
+	unsigned depth;
+	//Nesting of if and while blocks, at most
+	unsigned blocks;
+	//Locals per function, at most
+	unsigned locals;
+	//Characters in an identifier, at least
+	unsigned idLen;
+	//Percent of statements that report a string literal
+	unsigned strings;
+	//Characters in a string literal, at most
+	unsigned strLen;
+	//Use the shanty spellings of keywords and punctuation
+	bool shanty;
+};
+
+static const Shape SHAPES[] = {
+	//name         stmts depth blocks locals idLen strings strLen shanty
+	{"mixed",         12,    4,     2,     6,    3,     10,    24, false},
+	{"functions",      4,    2,     1,     2,    3,      5,    12, false},
+	{"nesting",        6,   80,     6,     4,    3,      0,     0, false},
+	{"statements",  5000,    3,     1,     8,    3,      5,    16, false},
+	{"identifiers",   24,    4,     1,    32,   24,      0,     0, false},
+	{"strings",       12,    2,     1,     2,    3,     70,    96, false},
+	{"shanty",        12,    4,     2,     6,    3,     10,    24, true},
+};
+
+/**
+* \class ProgramGen
+* Writes globals until the program reaches the requested size. Each
+* function only calls functions declared before it, and only uses its
+* own formals and locals and the global variables declared so far.
+**/
+class ProgramGen{
+public:
+	ProgramGen(const Shape& shape, uint64_t seed, FILE * out)
+	: myShape(shape), myRng(seed), myOut(out), myWritten(0), myNames(0){ }
+
+	void run(uint64_t size){
+		while (myWritten + myText.size() < size){
+			uint64_t left = size - myWritten - myText.size();
+			unsigned pick = myRng.below(10);
+			if (pick == 0){
+				globalVar();
+			} else if (pick == 1 && myShape.locals > 4){
+				recordDecl();
+			} else {
+				fnDecl(left);
+			}
+			if (myText.size() > (1 << 20)){ flush(); }
+		}
+		flush();
+	}
+private:
+	enum Type { INT, BOOL, VOID };
+
+	struct Fn{
+		std::string name;
+		Type ret;
+		std::vector<Type> params;
+	};
+
+	struct Record{
+		std::string name;
+		std::vector<std::string> fields;
+	};
+
+	struct Var{
+		std::string name;
+		Type type;
+	};
+
+	void flush(){
+		fwrite(myText.data(), 1, myText.size(), myOut);
+		myWritten += myText.size();
+		myText.clear();
+	}
+
+	void emit(const char * text){ myText += text; }
+	void emit(const std::string& text){ myText += text; }
+	void indent(unsigned depth){ myText.append(depth, '\t'); }
+
+	//Punctuation and keywords that have a shanty spelling
+	const char * open(){ return myShape.shanty ? " ahoy\n" : "{\n"; }
+	const char * close(){ return myShape.shanty ? "shove off\n" : "}\n"; }
+	const char * semi(){
+		if (!myShape.shanty){ return ";\n"; }
+		return myRng.chance(50) ? " heave and go\n" : " roll and go\n";
+	}
+	const char * assign(){ return myShape.shanty ? " gets " : " = "; }
+	const char * ret(){
+		return myShape.shanty ? "we'll take our leave and go" : "return";
+	}
+
+	/*
+	Names end in a number, so none can be a keyword, and are padded
+	out with letters to the shape's identifier length
+	*/
+	std::string name(const char * prefix){
+		std::string result = prefix;
+		while (result.size() + 4 < myShape.idLen){
+			result += static_cast<char>('a' + myRng.below(26));
+		}
+		result += std::to_string(myNames++);
+		return result;
+	}
+
+	static const char * typeName(Type type){
+		switch (type){
+		case INT: return "int";
+		case BOOL: return "bool";
+		default: return "void";
+		}
+	}
+
+	Type valueType(){ return myRng.chance(70) ? INT : BOOL; }
+
+	void globalVar(){
+		Var var = {name("g"), valueType()};
+		emit(typeName(var.type));
+		emit(" ");
+		emit(var.name);
+		emit(semi());
+		myGlobals.push_back(var);
+	}
+
+	void recordDecl(){
+		Record record;
+		record.name = name("Rec");
+		emit("record ");
+		emit(record.name);
+		emit(open());
+		unsigned fields = myRng.between(1, 4);
+		for (unsigned i = 0; i < fields; i++){
+			record.fields.push_back(name("f"));
+			emit("\tint ");
+			emit(record.fields.back());
+			emit(semi());
+		}
+		emit(close());
+		myRecords.push_back(record);
+	}
+
+	void fnDecl(uint64_t left){
+		Fn fn;
+		fn.name = name("fn");
+		fn.ret = myRng.chance(20) ? VOID : valueType();
+		myVars = myGlobals;
+		myRecordVars.clear();
+		myCounters.clear();
+
+		emit(typeName(fn.ret));
+		emit(" ");
+		emit(fn.name);
+		emit("(");
+		unsigned params = myRng.below(4);
+		for (unsigned i = 0; i < params; i++){
+			Var var = {name("p"), valueType()};
+			if (i > 0){ emit(", "); }
+			emit(typeName(var.type));
+			emit(" ");
+			emit(var.name);
+			fn.params.push_back(var.type);
+			myVars.push_back(var);
+		}
+		emit(")");
+		emit(open());
+
+		//At least one local of each type, so var() always finds one
+		unsigned locals = myRng.between(2, myShape.locals + 1);
+		for (unsigned i = 0; i < locals; i++){
+			indent(1);
+			if (i < 2){
+				Var var = {name("v"), i == 0 ? INT : BOOL};
+				emit(typeName(var.type));
+				emit(" ");
+				emit(var.name);
+				myVars.push_back(var);
+			} else if (!myRecords.empty() && myRng.chance(10)){
+				const Record& record = myRecords[myRng.below(
+					static_cast<unsigned>(myRecords.size()))];
+				std::string var = name("r");
+				emit(record.name);
+				emit(" ");
+				emit(var);
+				myRecordVars.push_back(std::make_pair(var, &record));
+			} else {
+				Var var = {name("v"), valueType()};
+				emit(typeName(var.type));
+				emit(" ");
+				emit(var.name);
+				myVars.push_back(var);
+			}
+			emit(semi());
+		}
+		//Loop counters, one per level of nesting. Nothing else
+		// assigns to them, so every loop ends
+		for (unsigned i = 0; i < myShape.blocks; i++){
+			myCounters.push_back(name("c"));
+			indent(1);
+			emit("int ");
+			emit(myCounters.back());
+			emit(semi());
+		}
+
+		//Roughly 24 bytes a statement; small programs get short
+		// functions rather than overshooting by a long one
+		unsigned stmts = myRng.between(1, myShape.stmts);
+		if (stmts > left / 24 + 1){ stmts = static_cast<unsigned>(left / 24 + 1); }
+		stmtList(stmts, 1);
+
+		indent(1);
+		emit(ret());
+		if (fn.ret != VOID){
+			emit(" ");
+			exp(fn.ret, myShape.depth);
+		}
+		emit(semi());
+		emit(close());
+		myFns.push_back(fn);
+	}
+
+	void stmtList(unsigned count, unsigned depth){
+		for (unsigned i = 0; i < count; i++){ stmt(depth); }
+	}
+
+	void stmt(unsigned depth){
+		if (myRng.chance(myShape.strings)){
+			indent(depth);
+			emit("report ");
+			strLit();
+			emit(semi());
+			return;
+		}
+		unsigned pick = myRng.below(10);
+		if ((pick == 6 || pick == 7) && depth > myShape.blocks){ pick = 0; }
+		if (pick == 8 && myFns.empty()){ pick = 0; }
+		indent(depth);
+		switch (pick){
+		case 0: case 1: case 2: {
+			Type type = myRng.chance(75) ? INT : BOOL;
+			lval(type);
+			emit(assign());
+			exp(type, myShape.depth);
+			emit(semi());
+			break;
+		}
+		case 3:
+			lval(INT);
+			emit("++");
+			emit(semi());
+			break;
+		case 4:
+			emit("receive ");
+			lval(valueType());
+			emit(semi());
+			break;
+		case 5:
+			emit("report ");
+			exp(valueType(), myShape.depth);
+			emit(semi());
+			break;
+		case 6:
+			emit("if (");
+			exp(BOOL, myShape.depth);
+			emit(")");
+			emit(open());
+			stmtList(myRng.between(1, 3), depth + 1);
+			indent(depth);
+			emit(close());
+			if (myRng.chance(50)){
+				indent(depth);
+				emit("else");
+				emit(myShape.shanty ? "" : " ");
+				emit(open());
+				stmtList(myRng.between(1, 3), depth + 1);
+				indent(depth);
+				emit(close());
+			}
+			break;
+		case 7: {
+			const std::string& counter = myCounters[depth - 1];
+			emit(counter);
+			emit(assign());
+			emit("0");
+			emit(semi());
+			indent(depth);
+			emit("while (");
+			emit(counter);
+			emit(" < ");
+			emit(std::to_string(myRng.between(1, 9)));
+			emit(")");
+			emit(open());
+			stmtList(myRng.between(1, 3), depth + 1);
+			indent(depth + 1);
+			emit(counter);
+			emit("++");
+			emit(semi());
+			indent(depth);
+			emit(close());
+			break;
+		}
+		case 8:
+			call(myFns[myRng.below(static_cast<unsigned>(myFns.size()))]);
+			emit(semi());
+			break;
+		default:
+			lval(INT);
+			emit("--");
+			emit(semi());
+			break;
+		}
+	}
+
+	//A variable of type, or a record field for an int
+	void lval(Type type){
+		if (type == INT && !myRecordVars.empty() && myRng.chance(20)){
+			const auto& var = myRecordVars[myRng.below(
+				static_cast<unsigned>(myRecordVars.size()))];
+			emit(var.first);
+			emit("[");
+			emit(var.second->fields[myRng.below(
+				static_cast<unsigned>(var.second->fields.size()))]);
+			emit("]");
+			return;
+		}
+		emit(var(type));
+	}
+
+	const std::string& var(Type type){
+		for (unsigned tries = 0; tries < 8; tries++){
+			const Var& var = myVars[myRng.below(
+				static_cast<unsigned>(myVars.size()))];
+			if (var.type == type){ return var.name; }
+		}
+		for (const Var& var : myVars){
+			if (var.type == type){ return var.name; }
+		}
+		return myVars.front().name;
+	}
+
+	/*
+	Expressions nest as a chain, one operand going deeper and the
+	other a leaf, so their size grows with depth rather than doubling.
+	Compound operands are parenthesized, so precedence never matters.
+	*/
+	void exp(Type type, unsigned depth){
+		if (depth == 0 || myRng.chance(depth > 8 ? 5 : 40)){
+			leaf(type);
+			return;
+		}
+		if (type == INT){
+			intExp(depth);
+		} else {
+			boolExp(depth);
+		}
+	}
+
+	void operand(Type type, unsigned depth){
+		if (depth == 0){
+			leaf(type);
+			return;
+		}
+		emit("(");
+		exp(type, depth);
+		emit(")");
+	}
+
+	void intExp(unsigned depth){
+		static const char * plain[] = {" + ", " - ", " * "};
+		static const char * shanty[] = {" plus ", " minus ", " times "};
+		unsigned pick = myRng.below(5);
+		if (pick == 4){
+			emit("-");
+			operand(INT, depth - 1);
+			return;
+		}
+		if (pick == 3){
+			operand(INT, depth - 1);
+			emit(myShape.shanty ? " divide " : " / ");
+			emit(std::to_string(myRng.between(1, 99)));
+			return;
+		}
+		const char * op = myShape.shanty ? shanty[pick] : plain[pick];
+		if (myRng.chance(50)){
+			operand(INT, depth - 1);
+			emit(op);
+			leaf(INT);
+		} else {
+			leaf(INT);
+			emit(op);
+			operand(INT, depth - 1);
+		}
+	}
+
+	void boolExp(unsigned depth){
+		static const char * compare[] = {" < ", " <= ", " > ", " >= ", " == ", " != "};
+		unsigned pick = myRng.below(4);
+		if (pick == 0){
+			emit("!");
+			operand(BOOL, depth - 1);
+		} else if (pick == 1){
+			const char * op = compare[myRng.below(6)];
+			if (myShape.shanty && op[1] == '='){ op = " equals "; }
+			operand(INT, depth - 1);
+			emit(op);
+			leaf(INT);
+		} else {
+			const char * op = pick == 2 ? " && " : " || ";
+			if (myShape.shanty){ op = pick == 2 ? " and " : " or "; }
+			leaf(BOOL);
+			emit(op);
+			operand(BOOL, depth - 1);
+		}
+	}
+
+	void leaf(Type type){
+		unsigned pick = myRng.below(10);
+		if (pick < 2){
+			if (type == INT){
+				emit(std::to_string(myRng.below(1000)));
+			} else if (myShape.shanty){
+				emit(myRng.chance(50) ? "aye" : "nay");
+			} else {
+				emit(myRng.chance(50) ? "true" : "false");
+			}
+			return;
+		}
+		if (pick == 2 && callable(type)){ return; }
+		lval(type);
+	}
+
+	//A call to some earlier function returning type, if there is one
+	bool callable(Type type){
+		for (unsigned tries = 0; tries < 4 && !myFns.empty(); tries++){
+			const Fn& fn = myFns[myRng.below(static_cast<unsigned>(myFns.size()))];
+			if (fn.ret == type){
+				call(fn);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void call(const Fn& fn){
+		emit(fn.name);
+		emit("(");
+		for (size_t i = 0; i < fn.params.size(); i++){
+			if (i > 0){ emit(", "); }
+			leaf(fn.params[i]);
+		}
+		emit(")");
+	}
+
+	void strLit(){
+		static const char * escapes[] = {"\\n", "\\t", "\\\"", "\\\\"};
+		emit("\"");
+		unsigned len = myRng.between(0, myShape.strLen);
+		bool endsInBackslash = false;
+		for (unsigned i = 0; i < len; i++){
+			unsigned pick = myRng.below(40);
+			endsInBackslash = false;
+			if (pick < 2){
+				unsigned esc = myRng.below(4);
+				emit(escapes[esc]);
+				endsInBackslash = esc == 3;
+			} else if (pick < 8){
+				myText += ' ';
+			} else {
+				myText += static_cast<char>('a' + myRng.below(26));
+			}
+		}
+		//cshanty.l also reads a lone backslash as a bad escape, so
+		// \\" scans longer as an unterminated bad string than as a
+		// good one. Keep the closing quote away from it.
+		if (endsInBackslash){ myText += 'x'; }
+		emit("\"");
+	}
+
+	const Shape& myShape;
+	Rng myRng;
+	FILE * myOut;
+	std::string myText;
+	uint64_t myWritten;
+	unsigned myNames;
+	std::vector<Fn> myFns;
+	std::vector<Record> myRecords;
+	std::vector<Var> myGlobals;
+	//In scope in the function being written
+	std::vector<Var> myVars;
+	std::vector<std::pair<std::string, const Record *>> myRecordVars;
+	std::vector<std::string> myCounters;
+};
+
+static void usageAndDie(){
+	fprintf(stderr, "Usage: cshantygen [-seed <n>] [-size <bytes>[K|M|G]]"
+	" [-shape <shape>] [-o <outFile>]\n"
+	" [-stmts <n>] [-depth <n>] [-blocks <n>] [-locals <n>]\n"
+	" [-idlen <n>] [-strings <percent>] [-strlen <n>] [-shanty]\n"
+	"   shapes:");
+	for (const Shape& shape : SHAPES){ fprintf(stderr, " %s", shape.name); }
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static uint64_t parseSize(const char * text){
+	char * end;
+	uint64_t size = strtoull(text, &end, 10);
+	switch (*end){
+	case 'k': case 'K': size <<= 10; break;
+	case 'm': case 'M': size <<= 20; break;
+	case 'g': case 'G': size <<= 30; break;
+	case '\0': break;
+	default: usageAndDie();
+	}
+	return size;
+}
+
+int main(int argc, const char ** argv){
+	uint64_t seed = 1;
+	uint64_t size = 64 << 10;
+	Shape shape = SHAPES[0];
+	const char * outPath = nullptr;
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (arg == "-shanty"){
+			shape.shanty = true;
+			continue;
+		}
+		if (i + 1 >= argc){ usageAndDie(); }
+		const char * value = argv[++i];
+		unsigned n = static_cast<unsigned>(atoi(value));
+		if (arg == "-seed"){ seed = strtoull(value, nullptr, 10); }
+		else if (arg == "-size"){ size = parseSize(value); }
+		else if (arg == "-o"){ outPath = value; }
+		else if (arg == "-stmts"){ shape.stmts = n > 0 ? n : 1; }
+		else if (arg == "-depth"){ shape.depth = n; }
+		else if (arg == "-blocks"){ shape.blocks = n; }
+		else if (arg == "-locals"){ shape.locals = n > 0 ? n : 1; }
+		else if (arg == "-idlen"){ shape.idLen = n; }
+		else if (arg == "-strings"){ shape.strings = n; }
+		else if (arg == "-strlen"){ shape.strLen = n; }
+		else if (arg == "-shape"){
+			bool found = false;
+			for (const Shape& preset : SHAPES){
+				if (strcmp(preset.name, value) == 0){
+					shape = preset;
+					found = true;
+				}
+			}
+			if (!found){ usageAndDie(); }
+		} else {
+			usageAndDie();
+		}
+	}
+
+	FILE * out = stdout;
+	if (outPath != nullptr){
+		out = fopen(outPath, "w");
+		if (out == nullptr){
+			fprintf(stderr, "Bad output file %s\n", outPath);
+			return 1;
+		}
+	}
+	ProgramGen(shape, seed, out).run(size);
+	if (out != stdout){ fclose(out); }
+	return 0;
+}
@@ -0,0 +1,837 @@
+#include <sstream>
+#include <unordered_map>
+#include "bytecode.hpp"
+#include "errors.hpp"
+#include "visitor.hpp"
+
+namespace cshanty{
+
+const char * BcProgram::opName(uint16_t op){
+#define CSHANTY_OPCODE_NAME(name) #name,
+	static const char * const names[OP_LIMIT] = {
+		CSHANTY_OPCODES(CSHANTY_OPCODE_NAME)
+	};
+#undef CSHANTY_OPCODE_NAME
+	return op < OP_LIMIT ? names[op] : "?";
+}
+
+std::string BcProgram::disassemble() const {
+	std::ostringstream out;
+	for (const BcFunction& fn : functions){
+		out << fn.name << ": " << fn.params << " params, "
+		<< fn.frameSize << " registers\n";
+		for (size_t i = 0; i < fn.code.size(); i++){
+			const Instr& in = fn.code[i];
+			out << "  " << i << "\t" << opName(in.op) << "\t" << in.a
+			<< " " << in.b << " " << in.c << " " << in.k << "\n";
+		}
+	}
+	return out.str();
+}
+
+struct RecordLayout;
+
+/** The type of a value, and so how many slots it takes **/
+struct ValueType{
+	enum Base : uint8_t { INT, BOOL, STRING, VOID, RECORD };
+	Base base;
+	const RecordLayout * record;
+
+	ValueType(Base baseIn = INT, const RecordLayout * recordIn = nullptr)
+	: base(baseIn), record(recordIn){ }
+	uint32_t slots() const;
+};
+
+struct RecordLayout{
+	struct Field{
+		Symbol name;
+		ValueType type;
+		uint32_t offset;
+	};
+	std::vector<Field> fields;
+	uint32_t size = 0;
+
+	const Field * field(Symbol name) const {
+		for (const Field& f : fields){
+			if (f.name == name){ return &f; }
+		}
+		return nullptr;
+	}
+};
+
+uint32_t ValueType::slots() const {
+	if (base == RECORD){ return record->size; }
+	return base == VOID ? 0 : 1;
+}
+
+/** Where a variable, or part of one, lives **/
+struct Location{
+	bool global;
+	uint32_t slot;
+};
+
+struct Variable{
+	ValueType type;
+	Location loc;
+};
+
+struct FnInfo{
+	uint32_t index;
+	ValueType ret;
+	std::vector<ValueType> params;
+	uint32_t paramSlots;
+};
+
+/*
+The register limit is that of the 16-bit operands; the last
+register is kept back as "no register".
+*/
+static const uint32_t MAX_REGS = 0xFFFF;
+static const uint16_t NO_REG = 0xFFFF;
+
+/**
+* \class BytecodeCompiler
+* Compiles a tree function by function, in one walk. Registers are
+* handed out like a stack: each variable gets the next free ones
+* for the rest of its scope, and an expression's temporaries are
+* taken above them and given back once it is compiled. A local
+* scalar is read straight from its register, without a copy.
+**/
+class BytecodeCompiler{
+public:
+	BytecodeCompiler(const LineTable& lines, BcProgram& out)
+	: myLines(lines), myOut(out), myFn(nullptr), myNext(0), myMax(0){ }
+
+	void program(const ProgramNode * root){
+		myScopes.emplace_back();
+		for (const DeclNode * decl : *root->globals()){
+			switch (decl->kind()){
+			case KIND_VAR_DECL:
+				globalVar(static_cast<const VarDeclNode *>(decl));
+				break;
+			case KIND_FN_DECL:
+				fnDecl(static_cast<const FnDeclNode *>(decl));
+				break;
+			case KIND_RECORD_TYPE_DECL:
+				recordDecl(static_cast<const RecordTypeDeclNode *>(decl));
+				break;
+			default:
+				break;
+			}
+		}
+		auto main = myFunctions.find(Interner::global().intern("main", 4).id());
+		if (main == myFunctions.end()){
+			error(root->pos(), "No main function");
+		}
+		if (!main->second.params.empty()){
+			error(root->pos(), "main takes no arguments");
+		}
+		myOut.main = main->second.index;
+	}
+private:
+	[[noreturn]] void error(const Position& pos, const std::string& msg){
+		Report::fatal(myLines.line(pos.start()), myLines.col(pos.start()),
+			msg.c_str());
+		throw new AbortError(1);
+	}
+
+	//Declarations
+
+	ValueType type(const TypeNode * node){
+		switch (node->kind()){
+		case KIND_INT_TYPE: return ValueType(ValueType::INT);
+		case KIND_BOOL_TYPE: return ValueType(ValueType::BOOL);
+		case KIND_STRING_TYPE: return ValueType(ValueType::STRING);
+		case KIND_VOID_TYPE: return ValueType(ValueType::VOID);
+		default: break;
+		}
+		const IDNode * id = static_cast<const RecordTypeNode *>(node)->id();
+		auto found = myRecords.find(id->getName().id());
+		if (found == myRecords.end()){
+			error(id->pos(), "Undeclared record type " + name(id));
+		}
+		return ValueType(ValueType::RECORD, found->second);
+	}
+
+	ValueType varType(const VarDeclNode * decl){
+		ValueType t = type(decl->type());
+		if (t.base == ValueType::VOID){
+			error(decl->id()->pos(), "Variable of type void");
+		}
+		return t;
+	}
+
+	void declare(const IDNode * id, const Variable& var){
+		auto inserted = myScopes.back().emplace(id->getName().id(), var);
+		if (!inserted.second){
+			error(id->pos(), "Multiply declared " + name(id));
+		}
+	}
+
+	void globalVar(const VarDeclNode * decl){
+		ValueType t = varType(decl);
+		declare(decl->id(), Variable{t, Location{true, myOut.globals}});
+		myOut.globals += t.slots();
+	}
+
+	void recordDecl(const RecordTypeDeclNode * decl){
+		myLayouts.emplace_back(new RecordLayout());
+		RecordLayout * layout = myLayouts.back().get();
+		for (const VarDeclNode * field : *decl->fields()){
+			ValueType t = varType(field);
+			if (layout->field(field->id()->getName()) != nullptr){
+				error(field->id()->pos(), "Multiply declared field "
+					+ name(field->id()));
+			}
+			layout->fields.push_back(RecordLayout::Field{
+				field->id()->getName(), t, layout->size});
+			layout->size += t.slots();
+		}
+		if (!myRecords.emplace(decl->id()->getName().id(), layout).second){
+			error(decl->id()->pos(), "Multiply declared record "
+				+ name(decl->id()));
+		}
+	}
+
+	void fnDecl(const FnDeclNode * decl){
+		FnInfo info;
+		info.index = static_cast<uint32_t>(myOut.functions.size());
+		info.ret = type(decl->type());
+		if (info.ret.base == ValueType::RECORD){
+			error(decl->type()->pos(), "Records can't be returned");
+		}
+		info.paramSlots = 0;
+		if (decl->formals() != nullptr){
+			for (const FormalDeclNode * formal : *decl->formals()){
+				info.params.push_back(varType(formal));
+				info.paramSlots += info.params.back().slots();
+			}
+		}
+		uint32_t id = decl->id()->getName().id();
+		if (myFunctions.count(id) > 0
+		  || myScopes.front().count(id) > 0){
+			error(decl->id()->pos(), "Multiply declared " + name(decl->id()));
+		}
+		//Registered before the body, so it can call itself
+		myFunctions.emplace(id, info);
+
+		myOut.functions.emplace_back();
+		myFn = &myOut.functions.back();
+		myFn->name = name(decl->id());
+		myFn->params = info.paramSlots;
+		myRet = info.ret;
+		myNext = 0;
+		myMax = 1;
+		myScopes.emplace_back();
+		if (decl->formals() != nullptr){
+			size_t i = 0;
+			for (const FormalDeclNode * formal : *decl->formals()){
+				const ValueType& t = info.params[i++];
+				declare(formal->id(), Variable{t, Location{false, myNext}});
+				take(formal->pos(), t.slots());
+			}
+		}
+		stmts(decl->body());
+		//Falling off the end returns nothing, or 0
+		if (info.ret.base == ValueType::VOID){
+			emit(decl->pos(), OP_RETV);
+		} else {
+			uint16_t zero = temp(decl->pos());
+			emit(decl->pos(), OP_LOADI, zero, 0, 0, 0);
+			emit(decl->pos(), OP_RET, zero);
+		}
+		myScopes.pop_back();
+		myFn->frameSize = myMax;
+		myFn = nullptr;
+	}
+
+	//Registers
+
+	uint32_t take(const Position& pos, uint32_t count){
+		uint32_t first = myNext;
+		myNext += count;
+		if (myNext >= MAX_REGS){ error(pos, "Function too large"); }
+		if (myNext > myMax){ myMax = myNext; }
+		return first;
+	}
+
+	uint16_t temp(const Position& pos){
+		return static_cast<uint16_t>(take(pos, 1));
+	}
+
+	size_t emit(const Position& pos, Opcode op, uint32_t a = 0,
+		uint32_t b = 0, uint32_t c = 0, int32_t k = 0){
+		myFn->code.push_back(Instr{static_cast<uint16_t>(op),
+			static_cast<uint16_t>(a), static_cast<uint16_t>(b),
+			static_cast<uint16_t>(c), k});
+		myFn->offsets.push_back(pos.start());
+		return myFn->code.size() - 1;
+	}
+
+	int32_t here() const { return static_cast<int32_t>(myFn->code.size()); }
+
+	void patch(const std::vector<size_t>& jumps){
+		for (size_t jump : jumps){ myFn->code[jump].k = here(); }
+	}
+
+	//Names
+
+	static std::string name(const IDNode * id){
+		return id->getName().str();
+	}
+
+	const Variable& variable(const IDNode * id){
+		uint32_t key = id->getName().id();
+		for (auto scope = myScopes.rbegin(); scope != myScopes.rend(); ++scope){
+			auto found = scope->find(key);
+			if (found != scope->end()){ return found->second; }
+		}
+		error(id->pos(), "Undeclared identifier " + name(id));
+	}
+
+	/* Where an lvalue lives, and its type */
+	Variable lval(const LValNode * node){
+		if (node->kind() == KIND_ID){
+			return variable(static_cast<const IDNode *>(node));
+		}
+		const IndexNode * index = static_cast<const IndexNode *>(node);
+		Variable base = variable(index->recordId());
+		if (base.type.base != ValueType::RECORD){
+			error(index->recordId()->pos(), name(index->recordId())
+				+ " is not a record");
+		}
+		const RecordLayout::Field * field =
+			base.type.record->field(index->fieldId()->getName());
+		if (field == nullptr){
+			error(index->fieldId()->pos(), "No field "
+				+ name(index->fieldId()) + " in " + name(index->recordId()));
+		}
+		return Variable{field->type,
+			Location{base.loc.global, base.loc.slot + field->offset}};
+	}
+
+	//Statements
+
+	void stmts(const NodeList<StmtNode *> * list){
+		for (const StmtNode * stmt : *list){ this->stmt(stmt); }
+	}
+
+	/* A block: its variables' registers are free again after it */
+	void block(const NodeList<StmtNode *> * list){
+		uint32_t mark = myNext;
+		myScopes.emplace_back();
+		stmts(list);
+		myScopes.pop_back();
+		myNext = mark;
+	}
+
+	void stmt(const StmtNode * stmt){
+		const Position& pos = stmt->pos();
+		switch (stmt->kind()){
+		case KIND_VAR_DECL: {
+			const VarDeclNode * decl = static_cast<const VarDeclNode *>(stmt);
+			ValueType t = varType(decl);
+			uint32_t first = take(pos, t.slots());
+			for (uint32_t i = 0; i < t.slots(); i++){
+				emit(pos, OP_LOADI, first + i, 0, 0, 0);
+			}
+			declare(decl->id(), Variable{t, Location{false, first}});
+			break;
+		}
+		case KIND_ASSIGN_STMT:
+			assign(static_cast<const AssignStmtNode *>(stmt)->assign(), NO_REG);
+			break;
+		case KIND_CALL_STMT:
+			call(static_cast<const CallStmtNode *>(stmt)->call(), NO_REG);
+			break;
+		case KIND_POST_INC_STMT:
+			step(static_cast<const PostIncStmtNode *>(stmt)->lval(), 1);
+			break;
+		case KIND_POST_DEC_STMT:
+			step(static_cast<const PostDecStmtNode *>(stmt)->lval(), -1);
+			break;
+		case KIND_RECEIVE_STMT:
+			receive(static_cast<const ReceiveStmtNode *>(stmt)->lval());
+			break;
+		case KIND_REPORT_STMT:
+			report(static_cast<const ReportStmtNode *>(stmt)->exp());
+			break;
+		case KIND_IF_STMT: {
+			const IfStmtNode * node = static_cast<const IfStmtNode *>(stmt);
+			std::vector<size_t> skip;
+			branch(node->cond(), false, skip);
+			block(node->body());
+			patch(skip);
+			break;
+		}
+		case KIND_IF_ELSE_STMT: {
+			const IfElseStmtNode * node =
+				static_cast<const IfElseStmtNode *>(stmt);
+			std::vector<size_t> toElse;
+			branch(node->cond(), false, toElse);
+			block(node->thenBranch());
+			size_t toEnd = emit(pos, OP_JMP);
+			patch(toElse);
+			block(node->elseBranch());
+			patch({toEnd});
+			break;
+		}
+		case KIND_WHILE_STMT: {
+			//The test goes after the body, so each
+			// iteration takes a single jump
+			const WhileStmtNode * node = static_cast<const WhileStmtNode *>(stmt);
+			size_t toTest = emit(pos, OP_JMP);
+			int32_t body = here();
+			block(node->body());
+			patch({toTest});
+			std::vector<size_t> again;
+			branch(node->cond(), true, again);
+			for (size_t jump : again){ myFn->code[jump].k = body; }
+			break;
+		}
+		case KIND_RETURN_STMT: {
+			const ExpNode * exp = static_cast<const ReturnStmtNode *>(stmt)->exp();
+			if (exp == nullptr){
+				if (myRet.base != ValueType::VOID){
+					error(pos, "Missing return value");
+				}
+				emit(pos, OP_RETV);
+				break;
+			}
+			if (myRet.base == ValueType::VOID){
+				error(exp->pos(), "Return with a value in a void function");
+			}
+			uint32_t mark = myNext;
+			emit(pos, OP_RET, operand(exp, nullptr));
+			myNext = mark;
+			break;
+		}
+		default:
+			error(pos, "Unexpected declaration");
+		}
+	}
+
+	void step(const LValNode * node, int32_t delta){
+		Variable var = lval(node);
+		scalar(node->pos(), var.type);
+		if (!var.loc.global){
+			emit(node->pos(), OP_ADDI, var.loc.slot, var.loc.slot, 0, delta);
+			return;
+		}
+		uint32_t mark = myNext;
+		uint16_t t = temp(node->pos());
+		emit(node->pos(), OP_LOADG, t, 0, 0, slot(var.loc));
+		emit(node->pos(), OP_ADDI, t, t, 0, delta);
+		emit(node->pos(), OP_STOREG, t, 0, 0, slot(var.loc));
+		myNext = mark;
+	}
+
+	void receive(const LValNode * node){
+		Variable var = lval(node);
+		Opcode op = var.type.base == ValueType::BOOL ? OP_READB
+		  : var.type.base == ValueType::STRING ? OP_READS : OP_READI;
+		scalar(node->pos(), var.type);
+		if (!var.loc.global){
+			emit(node->pos(), op, var.loc.slot);
+			return;
+		}
+		uint32_t mark = myNext;
+		uint16_t t = temp(node->pos());
+		emit(node->pos(), op, t);
+		emit(node->pos(), OP_STOREG, t, 0, 0, slot(var.loc));
+		myNext = mark;
+	}
+
+	void report(const ExpNode * exp){
+		uint32_t mark = myNext;
+		ValueType t;
+		uint16_t reg = operand(exp, &t);
+		scalar(exp->pos(), t);
+		Opcode op = t.base == ValueType::BOOL ? OP_WRITEB
+		  : t.base == ValueType::STRING ? OP_WRITES : OP_WRITEI;
+		emit(exp->pos(), op, reg);
+		myNext = mark;
+	}
+
+	void scalar(const Position& pos, const ValueType& t){
+		if (t.base == ValueType::RECORD){
+			error(pos, "Can't use a whole record here");
+		}
+		if (t.base == ValueType::VOID){
+			error(pos, "Use of a void value");
+		}
+	}
+
+	static int32_t slot(const Location& loc){
+		return static_cast<int32_t>(loc.slot);
+	}
+
+	//Expressions
+
+	/*
+	Assign; if dest isn't NO_REG, also put the assigned
+	value there. Records are copied slot by slot
+	*/
+	ValueType assign(const AssignExpNode * node, uint16_t dest){
+		Variable var = lval(node->lval());
+		const Position& pos = node->pos();
+		if (var.type.base == ValueType::RECORD){
+			if (dest != NO_REG){ error(pos, "Can't use a whole record here"); }
+			Variable from = recordValue(node->exp(), var.type);
+			copy(pos, var.loc, from.loc, var.type.slots());
+			return var.type;
+		}
+		uint32_t mark = myNext;
+		if (!var.loc.global){
+			into(node->exp(), var.loc.slot);
+			if (dest != NO_REG && dest != var.loc.slot){
+				emit(pos, OP_MOV, dest, var.loc.slot);
+			}
+		} else {
+			uint16_t reg = dest != NO_REG ? dest : temp(pos);
+			into(node->exp(), reg);
+			emit(pos, OP_STOREG, reg, 0, 0, slot(var.loc));
+		}
+		myNext = mark;
+		return var.type;
+	}
+
+	Variable recordValue(const ExpNode * exp, const ValueType& want){
+		if (exp->kind() != KIND_ID && exp->kind() != KIND_INDEX){
+			error(exp->pos(), "Expected a record");
+		}
+		Variable var = lval(static_cast<const LValNode *>(exp));
+		if (var.type.record != want.record){
+			error(exp->pos(), "Record types differ");
+		}
+		return var;
+	}
+
+	void copy(const Position& pos, Location to, Location from, uint32_t n){
+		uint32_t mark = myNext;
+		uint16_t t = temp(pos);
+		for (uint32_t i = 0; i < n; i++){
+			Location src{from.global, from.slot + i};
+			Location dst{to.global, to.slot + i};
+			if (!src.global && !dst.global){
+				emit(pos, OP_MOV, dst.slot, src.slot);
+			} else if (!dst.global){
+				emit(pos, OP_LOADG, dst.slot, 0, 0, slot(src));
+			} else if (!src.global){
+				emit(pos, OP_STOREG, src.slot, 0, 0, slot(dst));
+			} else {
+				emit(pos, OP_LOADG, t, 0, 0, slot(src));
+				emit(pos, OP_STOREG, t, 0, 0, slot(dst));
+			}
+		}
+		myNext = mark;
+	}
+
+	/*
+	The register holding exp's value: a local's own register,
+	or a new temporary holding it
+	*/
+	uint16_t operand(const ExpNode * exp, ValueType * type){
+		if (exp->kind() == KIND_ID || exp->kind() == KIND_INDEX){
+			Variable var = lval(static_cast<const LValNode *>(exp));
+			if (!var.loc.global && var.type.base != ValueType::RECORD){
+				if (type != nullptr){ *type = var.type; }
+				return static_cast<uint16_t>(var.loc.slot);
+			}
+		}
+		uint16_t reg = temp(exp->pos());
+		ValueType t = into(exp, reg);
+		if (type != nullptr){ *type = t; }
+		return reg;
+	}
+
+	/* Compile exp so that its value ends up in R[dest] */
+	ValueType into(const ExpNode * exp, uint32_t dest){
+		const Position& pos = exp->pos();
+		uint32_t mark = myNext;
+		ValueType result(ValueType::INT);
+		switch (exp->kind()){
+		case KIND_INT_LIT:
+			emit(pos, OP_LOADI, dest, 0, 0,
+				static_cast<const IntLitNode *>(exp)->value());
+			break;
+		case KIND_STR_LIT:
+			emit(pos, OP_LOADI, dest, 0, 0,
+				string(static_cast<const StrLitNode *>(exp)));
+			result = ValueType(ValueType::STRING);
+			break;
+		case KIND_TRUE:
+		case KIND_FALSE:
+			emit(pos, OP_LOADI, dest, 0, 0, exp->kind() == KIND_TRUE ? 1 : 0);
+			result = ValueType(ValueType::BOOL);
+			break;
+		case KIND_ID:
+		case KIND_INDEX: {
+			Variable var = lval(static_cast<const LValNode *>(exp));
+			scalar(pos, var.type);
+			if (var.loc.global){
+				emit(pos, OP_LOADG, dest, 0, 0, slot(var.loc));
+			} else if (var.loc.slot != dest){
+				emit(pos, OP_MOV, dest, var.loc.slot);
+			}
+			result = var.type;
+			break;
+		}
+		case KIND_ASSIGN_EXP:
+			result = assign(static_cast<const AssignExpNode *>(exp),
+				static_cast<uint16_t>(dest));
+			break;
+		case KIND_CALL_EXP:
+			result = call(static_cast<const CallExpNode *>(exp),
+				static_cast<uint16_t>(dest));
+			scalar(pos, result);
+			break;
+		case KIND_NEG:
+		case KIND_NOT: {
+			uint16_t reg = operand(static_cast<const UnaryExpNode *>(exp)->exp(),
+				nullptr);
+			emit(pos, exp->kind() == KIND_NEG ? OP_NEG : OP_NOT, dest, reg);
+			if (exp->kind() == KIND_NOT){ result = ValueType(ValueType::BOOL); }
+			break;
+		}
+		case KIND_AND:
+		case KIND_OR: {
+			std::vector<size_t> isFalse;
+			branch(exp, false, isFalse);
+			emit(pos, OP_LOADI, dest, 0, 0, 1);
+			size_t toEnd = emit(pos, OP_JMP);
+			patch(isFalse);
+			emit(pos, OP_LOADI, dest, 0, 0, 0);
+			patch({toEnd});
+			result = ValueType(ValueType::BOOL);
+			break;
+		}
+		default:
+			result = binary(static_cast<const BinaryExpNode *>(exp), dest);
+			break;
+		}
+		myNext = mark;
+		return result;
+	}
+
+	ValueType binary(const BinaryExpNode * exp, uint32_t dest){
+		const Position& pos = exp->pos();
+		const ExpNode * rhs = exp->rhs();
+		//x + k and x - k take the constant as an operand
+		if ((exp->kind() == KIND_PLUS || exp->kind() == KIND_MINUS)
+		  && rhs->kind() == KIND_INT_LIT){
+			int32_t k = static_cast<const IntLitNode *>(rhs)->value();
+			uint16_t l = operand(exp->lhs(), nullptr);
+			if (exp->kind() == KIND_MINUS){
+				k = static_cast<int32_t>(0u - static_cast<uint32_t>(k));
+			}
+			emit(pos, OP_ADDI, dest, l, 0, k);
+			return ValueType(ValueType::INT);
+		}
+		ValueType lt;
+		uint16_t l = operand(exp->lhs(), &lt);
+		l = stable(exp->lhs(), l, rhs);
+		uint16_t r = operand(rhs, nullptr);
+		emit(pos, binaryOp(exp->kind(), lt), dest, l, r);
+		if (exp->kind() == KIND_PLUS || exp->kind() == KIND_MINUS
+		  || exp->kind() == KIND_TIMES || exp->kind() == KIND_DIVIDE){
+			return ValueType(ValueType::INT);
+		}
+		return ValueType(ValueType::BOOL);
+	}
+
+	/*
+	A left operand read straight from a local's register would
+	see an assignment to that local in the right operand, so in
+	that case it is copied first
+	*/
+	uint16_t stable(const ExpNode * lhs, uint16_t reg, const ExpNode * rhs){
+		if (reg == myNext - 1 || !assigns(rhs)){ return reg; }
+		uint16_t copy = temp(lhs->pos());
+		emit(lhs->pos(), OP_MOV, copy, reg);
+		return copy;
+	}
+
+	static bool assigns(const ASTNode * node){
+		if (node->kind() == KIND_ASSIGN_EXP){ return true; }
+		bool found = false;
+		forEachChild(node, [&found](const ASTNode * child){
+			if (!found && assigns(child)){ found = true; }
+		});
+		return found;
+	}
+
+	static Opcode binaryOp(NodeKind kind, const ValueType& lhs){
+		bool strings = lhs.base == ValueType::STRING;
+		switch (kind){
+		case KIND_PLUS: return OP_ADD;
+		case KIND_MINUS: return OP_SUB;
+		case KIND_TIMES: return OP_MUL;
+		case KIND_DIVIDE: return OP_DIV;
+		case KIND_EQUALS: return strings ? OP_STREQ : OP_EQ;
+		case KIND_NOT_EQUALS: return strings ? OP_STRNE : OP_NE;
+		case KIND_LESS: return OP_LT;
+		case KIND_LESS_EQ: return OP_LE;
+		case KIND_GREATER: return OP_GT;
+		default: return OP_GE;
+		}
+	}
+
+	/*
+	Jump (adding the jumps to jumps, for patching) when cond is
+	when, and fall through when it isn't. And, or and not are
+	compiled to jumps alone; comparisons of ints and bools to a
+	single compare-and-jump
+	*/
+	void branch(const ExpNode * cond, bool when, std::vector<size_t>& jumps){
+		const Position& pos = cond->pos();
+		uint32_t mark = myNext;
+		switch (cond->kind()){
+		case KIND_TRUE:
+		case KIND_FALSE:
+			if ((cond->kind() == KIND_TRUE) == when){
+				jumps.push_back(emit(pos, OP_JMP));
+			}
+			return;
+		case KIND_NOT:
+			branch(static_cast<const NotNode *>(cond)->exp(), !when, jumps);
+			return;
+		case KIND_AND:
+		case KIND_OR: {
+			const BinaryExpNode * exp = static_cast<const BinaryExpNode *>(cond);
+			//Whether the left operand alone can decide
+			bool decides = (cond->kind() == KIND_AND) != when;
+			if (decides){
+				branch(exp->lhs(), when, jumps);
+				branch(exp->rhs(), when, jumps);
+			} else {
+				std::vector<size_t> skip;
+				branch(exp->lhs(), !when, skip);
+				branch(exp->rhs(), when, jumps);
+				patch(skip);
+			}
+			return;
+		}
+		case KIND_EQUALS: case KIND_NOT_EQUALS: case KIND_LESS:
+		case KIND_LESS_EQ: case KIND_GREATER: case KIND_GREATER_EQ: {
+			const BinaryExpNode * exp = static_cast<const BinaryExpNode *>(cond);
+			ValueType lt;
+			uint16_t l = operand(exp->lhs(), &lt);
+			l = stable(exp->lhs(), l, exp->rhs());
+			uint16_t r = operand(exp->rhs(), nullptr);
+			if (lt.base != ValueType::STRING){
+				NodeKind kind = when ? cond->kind() : negate(cond->kind());
+				jumps.push_back(emit(pos, compareJump(kind), l, r));
+				myNext = mark;
+				return;
+			}
+			uint16_t t = temp(pos);
+			emit(pos, binaryOp(cond->kind(), lt), t, l, r);
+			jumps.push_back(emit(pos, when ? OP_JT : OP_JF, t));
+			myNext = mark;
+			return;
+		}
+		default: {
+			uint16_t reg = operand(cond, nullptr);
+			jumps.push_back(emit(pos, when ? OP_JT : OP_JF, reg));
+			myNext = mark;
+			return;
+		}
+		}
+	}
+
+	static NodeKind negate(NodeKind kind){
+		switch (kind){
+		case KIND_EQUALS: return KIND_NOT_EQUALS;
+		case KIND_NOT_EQUALS: return KIND_EQUALS;
+		case KIND_LESS: return KIND_GREATER_EQ;
+		case KIND_LESS_EQ: return KIND_GREATER;
+		case KIND_GREATER: return KIND_LESS_EQ;
+		default: return KIND_LESS;
+		}
+	}
+
+	static Opcode compareJump(NodeKind kind){
+		switch (kind){
+		case KIND_EQUALS: return OP_JEQ;
+		case KIND_NOT_EQUALS: return OP_JNE;
+		case KIND_LESS: return OP_JLT;
+		case KIND_LESS_EQ: return OP_JLE;
+		case KIND_GREATER: return OP_JGT;
+		default: return OP_JGE;
+		}
+	}
+
+	/*
+	The arguments are placed at the bottom of a fresh window
+	above every register in use, which becomes the callee's
+	window; its result comes back in the first register
+	*/
+	ValueType call(const CallExpNode * node, uint16_t dest){
+		const IDNode * callee = node->callee();
+		auto found = myFunctions.find(callee->getName().id());
+		if (found == myFunctions.end()){
+			error(callee->pos(), "Undeclared function " + name(callee));
+		}
+		const FnInfo& fn = found->second;
+		size_t argc = node->args() == nullptr ? 0 : node->args()->size();
+		if (argc != fn.params.size()){
+			error(node->pos(), "Function " + name(callee) + " takes "
+				+ std::to_string(fn.params.size()) + " arguments");
+		}
+		uint32_t mark = myNext;
+		uint32_t base = take(node->pos(), fn.paramSlots > 0 ? fn.paramSlots : 1);
+		if (argc > 0){
+			uint32_t at = base;
+			size_t i = 0;
+			for (const ExpNode * arg : *node->args()){
+				const ValueType& want = fn.params[i++];
+				if (want.base == ValueType::RECORD){
+					Variable from = recordValue(arg, want);
+					copy(arg->pos(), Location{false, at}, from.loc, want.slots());
+				} else {
+					into(arg, at);
+				}
+				at += want.slots();
+			}
+		}
+		emit(node->pos(), OP_CALL, base, 0, 0, static_cast<int32_t>(fn.index));
+		if (dest != NO_REG && fn.ret.base != ValueType::VOID && dest != base){
+			emit(node->pos(), OP_MOV, dest, base);
+		}
+		myNext = mark;
+		return fn.ret;
+	}
+
+	/* The index of a literal's text in the string table */
+	int32_t string(const StrLitNode * literal){
+		std::string text = literal->text();
+		auto found = myStrings.find(text);
+		if (found != myStrings.end()){ return found->second; }
+		int32_t index = static_cast<int32_t>(myOut.strings.size());
+		myOut.strings.push_back(text);
+		myStrings.emplace(text, index);
+		return index;
+	}
+
+	const LineTable& myLines;
+	BcProgram& myOut;
+	BcFunction * myFn;
+	ValueType myRet;
+	uint32_t myNext;
+	uint32_t myMax;
+	std::vector<std::unordered_map<uint32_t, Variable>> myScopes;
+	std::unordered_map<uint32_t, FnInfo> myFunctions;
+	std::unordered_map<uint32_t, const RecordLayout *> myRecords;
+	std::vector<std::unique_ptr<RecordLayout>> myLayouts;
+	std::unordered_map<std::string, int32_t> myStrings;
+};
+
+void compileBytecode(const ProgramNode * root, const LineTable& lines,
+	BcProgram& out){
+	out = BcProgram();
+	BytecodeCompiler compiler(lines, out);
+	compiler.program(root);
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef CSHANTY_BYTECODE_H
+#define CSHANTY_BYTECODE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+
+namespace cshanty{
+
+/*
+The instruction set. R is the current function's register
+window, G the globals, k the instruction's 32-bit operand.
+Booleans are 0 and 1, strings are indices into the string
+table, and records occupy one slot per (scalar) field.
+*/
+#define CSHANTY_OPCODES(X) \
+	X(MOV)     /* R[a] = R[b] */ \
+	X(LOADI)   /* R[a] = k */ \
+	X(LOADG)   /* R[a] = G[k] */ \
+	X(STOREG)  /* G[k] = R[a] */ \
+	X(ADD)     /* R[a] = R[b] + R[c], and so on */ \
+	X(SUB) \
+	X(MUL) \
+	X(DIV) \
+	X(ADDI)    /* R[a] = R[b] + k */ \
+	X(NEG)     /* R[a] = -R[b] */ \
+	X(NOT)     /* R[a] = !R[b] */ \
+	X(EQ)      /* R[a] = R[b] == R[c], and so on */ \
+	X(NE) \
+	X(LT) \
+	X(LE) \
+	X(GT) \
+	X(GE) \
+	X(STREQ)   /* R[a] = the strings R[b] and R[c] are equal */ \
+	X(STRNE) \
+	X(JMP)     /* goto k */ \
+	X(JT)      /* if (R[a]) goto k */ \
+	X(JF)      /* if (!R[a]) goto k */ \
+	X(JEQ)     /* if (R[a] == R[b]) goto k, and so on */ \
+	X(JNE) \
+	X(JLT) \
+	X(JLE) \
+	X(JGT) \
+	X(JGE) \
+	X(CALL)    /* call function k, its window starting at R[a] */ \
+	X(RET)     /* return R[a], which the caller finds in its R[a] */ \
+	X(RETV)    /* return nothing */ \
+	X(WRITEI)  /* report R[a] as an int, a bool or a string */ \
+	X(WRITEB) \
+	X(WRITES) \
+	X(READI)   /* receive R[a] as an int, a bool or a string */ \
+	X(READB) \
+	X(READS)
+
+#define CSHANTY_OPCODE_ENUM(name) OP_##name,
+enum Opcode : uint16_t{
+	CSHANTY_OPCODES(CSHANTY_OPCODE_ENUM)
+	OP_LIMIT
+};
+#undef CSHANTY_OPCODE_ENUM
+
+/** One instruction: three register operands and a constant **/
+struct Instr{
+	uint16_t op;
+	uint16_t a;
+	uint16_t b;
+	uint16_t c;
+	int32_t k;
+};
+
+struct BcFunction{
+	std::string name;
+	//Registers taken by the parameters, which come first
+	uint32_t params = 0;
+	//Registers the function uses in all
+	uint32_t frameSize = 1;
+	std::vector<Instr> code;
+	//Source offset of each instruction, for runtime errors
+	std::vector<uint32_t> offsets;
+};
+
+/**
+* \class BcProgram
+* A program compiled to bytecode by compileBytecode and run by a VM
+* (vm.hpp). Each function runs in a window of registers; a call
+* places the arguments at the bottom of a window at the top of the
+* caller's and slides the callee's window there.
+**/
+struct BcProgram{
+	std::vector<BcFunction> functions;
+	uint32_t globals = 0;
+	//String literals, escapes already interpreted
+	std::vector<std::string> strings;
+	uint32_t main = 0;
+
+	/** The mnemonic of an opcode ("ADDI") **/
+	static const char * opName(uint16_t op);
+	/** A listing of every function's code **/
+	std::string disassemble() const;
+};
+
+/**
+* Compile the program under root into out. Anything that can't be
+* compiled (an undeclared name, a call with the wrong number of
+* arguments, no main(), ...) is reported as a fatal error at its
+* position in lines, and compilation is abandoned with an
+* AbortError. The types of operands are otherwise trusted.
+**/
+void compileBytecode(const ProgramNode * root, const LineTable& lines,
+	BcProgram& out);
+
+}
+
+#endif
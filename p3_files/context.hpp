@@ -0,0 +1,40 @@
+#ifndef CSHANTY_CONTEXT_H
+#define CSHANTY_CONTEXT_H
+
+#include "arena.hpp"
+#include "position.hpp"
+#include "source.hpp"
+
+namespace cshanty{
+
+/**
+* \class CompilationContext
+* Per-compilation state shared by the scanner, the parser and
+* later passes. Owns the arena that every token, position and AST
+* node is allocated from, so an entire tree is released with a
+* single reset(), along with the line table used to turn positions
+* back into line and column numbers. The source text stays open
+* until the next file is opened, since lexemes point into it.
+**/
+class CompilationContext{
+public:
+	CompilationContext(){ }
+	CompilationContext(const CompilationContext&) = delete;
+	CompilationContext& operator=(const CompilationContext&) = delete;
+
+	Arena& arena(){ return myArena; }
+	LineTable& lines(){ return myLines; }
+	SourceFile& source(){ return mySource; }
+	void reset(){
+		myArena.reset();
+		myLines.clear();
+	}
+private:
+	Arena myArena;
+	LineTable myLines;
+	SourceFile mySource;
+};
+
+}
+
+#endif
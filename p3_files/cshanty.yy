@@ -13,7 +13,7 @@
 	#include "tokens.hpp"
    	#include "ast.hpp"
 	namespace cshanty {
-		class Scanner;
+		class TokenSource;
 	}
 
 //The following definition is required when
@@ -29,7 +29,7 @@
 //End "requires" code
 }
 
-%parse-param { cshanty::Scanner &scanner }
+%parse-param { cshanty::TokenSource &scanner }
 %parse-param { cshanty::ProgramNode** root }
 %code{
    // C std code for utility functions
@@ -38,13 +38,19 @@
    #include <fstream>
 
    // Our code for interoperation between scanner/parser
-   #include "scanner.hpp"
+   #include "tokensource.hpp"
+   #include "errors.hpp"
    #include "tokens.hpp"
 
-  //Request tokens from our scanner member, not
+  //Request tokens from our scanner member (the flex
+  // scanner or a replayed token stream), not
   // from a global function
   #undef yylex
   #define yylex scanner.yylex
+
+  //Everything the parser builds is placed in the
+  // scanner's compilation arena
+  #define ARENA scanner.arena()
 }
 
 /*
@@ -62,7 +68,7 @@ project)
 	 cshanty::IntLitToken*									 transIntToken;
 	 cshanty::StrToken*											 transStrToken;
    cshanty::ProgramNode*                   transProgram;
-   std::list<cshanty::DeclNode *> *        transDeclList;
+   cshanty::NodeList<cshanty::DeclNode *> *        transDeclList;
    cshanty::DeclNode *                     transDecl;
    cshanty::VarDeclNode *                  transVarDecl;
    cshanty::TypeNode *                     transType;
@@ -73,11 +79,11 @@ project)
    cshanty::CallExpNode *				   					transCallExp;
    cshanty::FnDeclNode *				   					transFnDecl;
    cshanty::FormalDeclNode *			   				transFormalDecl;
-   std::list<cshanty::VarDeclNode *> * 	    transVarDeclList;
-   std::list<cshanty::StmtNode *> *    	    transStmtList;
-   std::list<cshanty::ExpNode *> *		   		transActualsList;
+   cshanty::NodeList<cshanty::VarDeclNode *> * 	    transVarDeclList;
+   cshanty::NodeList<cshanty::StmtNode *> *    	    transStmtList;
+   cshanty::NodeList<cshanty::ExpNode *> *		   		transActualsList;
    cshanty::ExpNode *					   						transTerm;
-   std::list<cshanty::FormalDeclNode *> *  transFormals;
+   cshanty::NodeList<cshanty::FormalDeclNode *> *  transFormals;
    cshanty::RecordTypeDeclNode *   				 transRecordTypeDecl;
    cshanty::AssignExpNode * transAssignExp;
 }
@@ -177,7 +183,7 @@ project)
 
 program 	: globals
 		  {
-		  $$ = new ProgramNode($1);
+		  $$ = new (ARENA) ProgramNode($1);
 		  *root = $$;
 		  }
 
@@ -189,7 +195,7 @@ globals 	: globals decl
 	  	  }
 		| /* epsilon */
 		  {
-		  $$ = new std::list<DeclNode * >();
+		  $$ = newList<DeclNode *>(ARENA);
 		  }
 
 decl 		: varDecl
@@ -209,20 +215,20 @@ decl 		: varDecl
 
 recordDecl	: RECORD id OPEN varDeclList CLOSE
 		{
-			Position * p = new Position($1->pos(), $5->pos());
-			//$$ = new RecordTypeDeclNode(p, $2, $4);
+			Position p($1->pos(), $5->pos());
+			$$ = new (ARENA) RecordTypeDeclNode(p, $2, $4);
 
 		}
 
 varDecl 	: type id SEMICOL //works
 		  {
-		    Position * p = new Position($1->pos(), $3->pos());
-		    $$ = new VarDeclNode(p, $1, $2);
+		    Position p($1->pos(), $3->pos());
+		    $$ = new (ARENA) VarDeclNode(p, $1, $2);
 		  }
 
 varDeclList  : varDecl //doesn't work
 			{
-				$$ = new std::list<VarDeclNode*>();
+				$$ = newList<VarDeclNode *>(ARENA);
 				VarDeclNode * vdNode  = $1;
 				$$->push_back(vdNode);
 			}
@@ -233,27 +239,27 @@ varDeclList  : varDecl //doesn't work
 				$$->push_back(vdNode);
 			}
 
-type 		: INT { $$ = new IntTypeNode($1->pos()); } //works
-		| BOOL { $$ = new BoolTypeNode($1->pos()); }
-		| id { $$ = new RecordTypeNode($1->pos(), $1); }
-		| STRING { $$ = new StringTypeNode($1->pos()); }
-		| VOID { $$ = new VoidTypeNode($1->pos()); }
+type 		: INT { $$ = new (ARENA) IntTypeNode($1->pos()); } //works
+		| BOOL { $$ = new (ARENA) BoolTypeNode($1->pos()); }
+		| id { $$ = new (ARENA) RecordTypeNode($1->pos(), $1); }
+		| STRING { $$ = new (ARENA) StringTypeNode($1->pos()); }
+		| VOID { $$ = new (ARENA) VoidTypeNode($1->pos()); }
 
 fnDecl 		: type id LPAREN RPAREN OPEN stmtList CLOSE
 			{
-				Position* p = new Position($1->pos(), $7->pos());
-				$$ = new FnDeclNode(p, $1, $2, nullptr, $6); //will need to add an if in unparse
+				Position p($1->pos(), $7->pos());
+				$$ = new (ARENA) FnDeclNode(p, $1, $2, nullptr, $6); //will need to add an if in unparse
 
 			}
 		| type id LPAREN formals RPAREN OPEN stmtList CLOSE
 			{
-				Position* p = new Position($1->pos(), $8->pos());
-				$$ = new FnDeclNode(p, $1, $2, $4, $7);
+				Position p($1->pos(), $8->pos());
+				$$ = new (ARENA) FnDeclNode(p, $1, $2, $4, $7);
 			}
 
 formals 	: formalDecl
 			{
-	  	  $$ = new std::list<FormalDeclNode*>();
+	  	  $$ = newList<FormalDeclNode *>(ARENA);
 				FormalDeclNode * fNode  = $1;
 				$$->push_back(fNode);
 			}
@@ -266,11 +272,11 @@ formals 	: formalDecl
 
 formalDecl 	: type id
 	{
-		Position* p = new Position($1->pos(), $2->pos());
-		$$ = new FormalDeclNode(p, $1, $2);
+		Position p($1->pos(), $2->pos());
+		$$ = new (ARENA) FormalDeclNode(p, $1, $2);
 	}
 
-stmtList 	: /* epsilon */ { $$ = new std::list<StmtNode*>(); }
+stmtList 	: /* epsilon */ { $$ = newList<StmtNode *>(ARENA); }
 		| stmtList stmt
 		{
 				$$ = $1;
@@ -284,52 +290,51 @@ stmt		: varDecl
 			}
 		| assignExp SEMICOL
 			{
-				printf("\ngot here\n");
-				$$ = new AssignStmtNode($1->pos(), $1);
+				$$ = new (ARENA) AssignStmtNode($1->pos(), $1);
 			}
 		| lval DEC SEMICOL
 			{
-				$$ = new PostDecStmtNode($1->pos(), $1);
+				$$ = new (ARENA) PostDecStmtNode($1->pos(), $1);
 			}
 		| lval INC SEMICOL
 			{
-				$$ = new PostIncStmtNode($1->pos(), $1);
+				$$ = new (ARENA) PostIncStmtNode($1->pos(), $1);
 			}
 		| RECEIVE lval SEMICOL
 			{
-				$$ = new ReceiveStmtNode($1->pos(), $2);
+				$$ = new (ARENA) ReceiveStmtNode($1->pos(), $2);
 			}
 		| REPORT exp SEMICOL
 			{
-				$$ = new ReportStmtNode($2->pos(), $2);
+				$$ = new (ARENA) ReportStmtNode($2->pos(), $2);
 			}
 		| IF LPAREN exp RPAREN OPEN stmtList CLOSE
 			{
-				Position* p = new Position($3->pos(), $7->pos());
-				$$ = new IfStmtNode(p, $3, $6);
+				Position p($3->pos(), $7->pos());
+				$$ = new (ARENA) IfStmtNode(p, $3, $6);
 			}
 		| IF LPAREN exp RPAREN OPEN stmtList CLOSE ELSE OPEN stmtList CLOSE
 			{
-				Position* p = new Position($1->pos(), $11->pos());
-				$$ = new IfElseStmtNode(p, $3, $6, $10);
+				Position p($1->pos(), $11->pos());
+				$$ = new (ARENA) IfElseStmtNode(p, $3, $6, $10);
 			}
 		| WHILE LPAREN exp RPAREN OPEN stmtList CLOSE
 			{
-				Position* p = new Position($1->pos(), $7->pos());
-				$$ = new WhileStmtNode(p, $3, $6);
+				Position p($1->pos(), $7->pos());
+				$$ = new (ARENA) WhileStmtNode(p, $3, $6);
 			}
 		| RETURN exp SEMICOL
 			{
-				$$ = new ReturnStmtNode($2->pos(), $2);
+				$$ = new (ARENA) ReturnStmtNode($2->pos(), $2);
 			}
 		| RETURN SEMICOL
 			{
-				$$ = new ReturnStmtNode($2->pos(), nullptr);
+				$$ = new (ARENA) ReturnStmtNode($2->pos(), nullptr);
 			}
 		| callExp SEMICOL
 			{
-				Position* p = new Position($1->pos(), $2->pos());
-				$$ = new CallStmtNode(p, $1);
+				Position p($1->pos(), $2->pos());
+				$$ = new (ARENA) CallStmtNode(p, $1);
 			}
 
 exp		: assignExp
@@ -341,73 +346,73 @@ exp		: assignExp
 			}
 		| exp MINUS exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new MinusNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) MinusNode(p, $1, $3);
 			}
 		| exp PLUS exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new PlusNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) PlusNode(p, $1, $3);
 			}
 		| exp TIMES exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new TimesNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) TimesNode(p, $1, $3);
 			}
 		| exp DIVIDE exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new DivideNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) DivideNode(p, $1, $3);
 			}
 		| exp AND exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new AndNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) AndNode(p, $1, $3);
 			}
 		| exp OR exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new OrNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) OrNode(p, $1, $3);
 			}
 		| exp EQUALS exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new EqualsNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) EqualsNode(p, $1, $3);
 			}
 		| exp NOTEQUALS exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new NotEqualsNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) NotEqualsNode(p, $1, $3);
 			}
 		| exp GREATER exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new GreaterNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) GreaterNode(p, $1, $3);
 			}
 		| exp GREATEREQ exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new GreaterEqNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) GreaterEqNode(p, $1, $3);
 			}
 		| exp LESS exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new LessNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) LessNode(p, $1, $3);
 			}
 		| exp LESSEQ exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new LessEqNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) LessEqNode(p, $1, $3);
 			}
 		| NOT exp
 			{
-				Position* p = new Position($1->pos(), $2->pos());
-				$$ = new NotNode(p);
+				Position p($1->pos(), $2->pos());
+				$$ = new (ARENA) NotNode(p, $2);
 			}
 		| MINUS term
 			{
-				Position* p = new Position($1->pos(), $2->pos());
-				$$ = new NegNode(p);
+				Position p($1->pos(), $2->pos());
+				$$ = new (ARENA) NegNode(p, $2);
 			}
 		| term
 			{
@@ -416,23 +421,24 @@ exp		: assignExp
 
 assignExp	: lval ASSIGN exp
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new AssignExpNode(p, $1, $3);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) AssignExpNode(p, $1, $3);
 			}
 
 callExp		: id LPAREN RPAREN
 			{
-				Position* p = new Position($1->pos(), $3->pos());
-				$$ = new CallExpNode(p, $1, nullptr);
+				Position p($1->pos(), $3->pos());
+				$$ = new (ARENA) CallExpNode(p, $1, nullptr);
 			}
 		| id LPAREN actualsList RPAREN
 			{
-				Position* p = new Position($1->pos(), $4->pos());
-				$$ = new CallExpNode(p, $1, $3);
+				Position p($1->pos(), $4->pos());
+				$$ = new (ARENA) CallExpNode(p, $1, $3);
 			}
 
 actualsList	: exp
 			{
+				$$ = newList<ExpNode *>(ARENA);
 				ExpNode* expNode = $1;
 				$$->push_back(expNode);
 
@@ -446,30 +452,30 @@ actualsList	: exp
 
 
 term 		: lval { $$ = $1; }
-		| INTLITERAL { $$ = new IntLitNode($1->pos(),$1->num()); }
-		| STRLITERAL { $$ = new StrLitNode($1->pos(), $1->str()); }
-		| TRUE { $$ = new TrueNode($1->pos()); }
-		| FALSE { $$ = new FalseNode($1->pos()); }
+		| INTLITERAL { $$ = new (ARENA) IntLitNode($1->pos(),$1->num()); }
+		| STRLITERAL { $$ = new (ARENA) StrLitNode($1->pos(), $1->str()); }
+		| TRUE { $$ = new (ARENA) TrueNode($1->pos()); }
+		| FALSE { $$ = new (ARENA) FalseNode($1->pos()); }
 		| LPAREN exp RPAREN { $$ = $2; }
 		| callExp { $$ = $1;}
 
 lval		: id { $$ = $1; }
 		| id LBRACE id RBRACE
 			{
-				Position* p = new Position($1->pos(), $4->pos());
-				$$ = new IndexNode(p, $1, $3);
+				Position p($1->pos(), $4->pos());
+				$$ = new (ARENA) IndexNode(p, $1, $3);
 			}
 
 id		: ID
 		  {
-		  Position * pos = $1->pos();
-		  $$ = new IDNode(pos, $1->value());
+		  Position pos = $1->pos();
+		  $$ = new (ARENA) IDNode(pos, $1->value());
 		  }
 
 
 %%
 
 void cshanty::Parser::error(const std::string& msg){
-	std::cout << msg << std::endl;
-	std::cerr << "syntax error" << std::endl;
+	Report::out() << msg << std::endl;
+	Report::err() << "syntax error" << std::endl;
 }
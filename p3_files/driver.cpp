@@ -0,0 +1,519 @@
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "driver.hpp"
+#include "errors.hpp"
+#include "astcache.hpp"
+#include "asmgen.hpp"
+#include "astmemory.hpp"
+#include "bytecode.hpp"
+#include "fastscanner.hpp"
+#include "incremental.hpp"
+#include "jit.hpp"
+#include "names.hpp"
+#include "scanner.hpp"
+#include "simplify.hpp"
+#include "tokstream.hpp"
+#include "typecheck.hpp"
+#include "vm.hpp"
+
+namespace cshanty{
+
+/*
+Regular files are mapped and scanned in place; pipes and
+stdin go through the stream path.
+*/
+static void openInput(const char * inPath, CompilationContext& ctx){
+	if (!ctx.source().open(inPath)){
+		std::string msg = "Bad input stream ";
+		if (ctx.source().tooLarge()){
+			msg = "Input of 4GB or more, which positions can't address: ";
+		}
+		msg += inPath;
+		throw new InternalError(msg.c_str());
+	}
+}
+
+/*
+While a tree that will be cached is built, the diagnostics of its
+scan and parse are held back, to be kept with it (and replayed on
+a hit) as well as passed on. They are passed on however the build
+ends, so an abort reports them too.
+*/
+class HeldDiagnostics{
+public:
+	HeldDiagnostics() : myErr(Report::err()), myOut(Report::out()),
+	  myHolding(false){ }
+	~HeldDiagnostics(){ release(); }
+
+	void hold(){
+		Report::redirect(&myHeld, &myOut);
+		myHolding = true;
+	}
+
+	/** Pass on what was held, and return it **/
+	std::string release(){
+		if (!myHolding){ return ""; }
+		myHolding = false;
+		Report::redirect(&myErr, &myOut);
+		std::string text = myHeld.str();
+		myErr << text;
+		return text;
+	}
+private:
+	std::ostream& myErr;
+	std::ostream& myOut;
+	std::ostringstream myHeld;
+	bool myHolding;
+};
+
+bool Driver::run(const char * inPath){
+	if (myOpts.editsFile != nullptr){ return runEdits(inPath); }
+	bool ok = true;
+	//Checking and running need the tree itself, which
+	// the AST cache doesn't keep
+	bool wantTypes = myOpts.checkTypes || myOpts.run || myOpts.jit
+	  || myOpts.asmFile != nullptr;
+	bool wantTree = myOpts.checkNames || wantTypes;
+	bool wantAST = myOpts.checkParse || myOpts.unparseFile != nullptr
+	  || wantTree;
+	bool wantTokens = myOpts.tokensFile != nullptr
+	  || myOpts.tokenStreamFile != nullptr;
+	std::vector<Token *> tokens;
+	myStats.reset();
+	if (myOpts.stats || myOpts.statsFile != nullptr){
+		myStats.reset(new Stats(inPath));
+	}
+
+	{
+		Stats::Phase phase(myStats.get(), "read");
+		openInput(inPath, myCtx);
+	}
+	bool replay = TokenReplay::isTokenStream(myCtx.source());
+
+	//This pointer will be set to the root of the
+	// AST after parsing, or rebuilt from a cached copy
+	ProgramNode * root = nullptr;
+	bool checked = true;
+	TypeTable types;
+	//The tree as the caches keep it, flattened only
+	// when one of them is in use
+	FlatAST flat;
+	//A cached tree stands in for the scan and parse,
+	// unless the tokens themselves are wanted
+	bool cacheable = wantAST && !wantTokens && !wantTree
+	  && !replay && myCtx.source().mapped();
+	bool remembered = myOpts.treeCache != nullptr && cacheable;
+	bool inMemory = false;
+	//What the parse of a cached tree reported
+	std::string diagnostics;
+	if (remembered){
+		Stats::Phase phase(myStats.get(), "cache");
+		root = myOpts.treeCache->find(inPath, myCtx.source(),
+			myOpts.optimize, myCtx.arena(), diagnostics);
+		inMemory = root != nullptr;
+		if (inMemory){ Report::err() << diagnostics; }
+	}
+	bool cached = myOpts.cacheDir != nullptr && cacheable && !inMemory;
+	uint64_t sourceHash = 0;
+	if (cached){
+		Stats::Phase phase(myStats.get(), "cache");
+		const SourceFile& src = myCtx.source();
+		sourceHash = AstCache::hash(src.data(), src.size());
+		//Simplified trees are cached apart from plain ones
+		if (myOpts.optimize){ sourceHash = ~sourceHash; }
+		if (AstCache(myOpts.cacheDir).load(myCtx, sourceHash, flat,
+		  diagnostics)){
+			root = flat.toTree(myCtx.arena());
+			if (root != nullptr){ Report::err() << diagnostics; }
+		}
+	}
+
+	std::unique_ptr<TokenSource> source;
+	if (replay){
+		TokenReplay * replay = new TokenReplay(myCtx);
+		source.reset(replay);
+		if (!replay->valid()){
+			Report::err() << "Error: Corrupt token stream " << inPath << std::endl;
+			myCtx.reset();
+			return false;
+		}
+	} else if (myOpts.fastScan){
+		source.reset(new FastScanner(myCtx));
+	} else {
+		source.reset(new Scanner(myCtx));
+	}
+	TokenSource& scanner = *source;
+	bool parse = wantAST && root == nullptr;
+	bool scanFirst = myStats != nullptr && (parse || wantTokens);
+	//-m also accounts for the tokens the parser was fed
+	if (wantTokens || scanFirst || myOpts.arenaStats){
+		scanner.record(&tokens);
+	}
+	HeldDiagnostics held;
+	if (parse && (cached || remembered)){ held.hold(); }
+
+	try {
+		if (scanFirst){
+			Stats::Phase phase(myStats.get(), "scan");
+			scanner.drain();
+		}
+		if (parse){
+			try {
+				Stats::Phase phase(myStats.get(), "parse");
+				std::unique_ptr<TokenRun> run;
+				if (scanFirst){
+					run.reset(new TokenRun(myCtx, tokens,
+						tokens.back()->pos().end()));
+				}
+				Parser parser(scanFirst ? *run : scanner, &root);
+				if (parser.parse() != 0){ root = nullptr; }
+			} catch (ToDoError * e){
+				Report::err() << "ToDo: " << e->msg() << std::endl;
+				throw new AbortError(1);
+			}
+			if (root != nullptr && wantTree){
+				Stats::Phase phase(myStats.get(), "names");
+				if (!analyzeNames(root, myCtx.lines())){
+					Report::err() << "Name analysis failed" << std::endl;
+					checked = false;
+					ok = false;
+				}
+			}
+			if (root != nullptr && checked && wantTypes){
+				Stats::Phase phase(myStats.get(), "types");
+				if (!checkTypes(root, myCtx.lines(), types)){
+					Report::err() << "Type analysis failed" << std::endl;
+					checked = false;
+					ok = false;
+				}
+				if (myStats != nullptr){ myStats->setTypes(types.size()); }
+			}
+			if (root != nullptr && myOpts.optimize){
+				Stats::Phase phase(myStats.get(), "simplify");
+				root = simplify(root, myCtx.arena());
+			}
+			diagnostics = held.release();
+			if (root != nullptr && (cached || remembered)){
+				Stats::Phase phase(myStats.get(), "flatten");
+				flat.build(root);
+			}
+			if (cached && root != nullptr){
+				Stats::Phase phase(myStats.get(), "cache");
+				if (!AstCache(myOpts.cacheDir).store(myCtx, sourceHash, flat,
+				  diagnostics)){
+					Report::err() << "Warning: Can't write to AST cache "
+					<< myOpts.cacheDir << std::endl;
+				}
+			}
+			if (root == nullptr && (myOpts.checkParse || wantTree)){
+				Report::err() << "Parse failed" << std::endl;
+				ok = false;
+			}
+		}
+		//Parsed here or loaded from the AST cache
+		if (remembered && !inMemory && root != nullptr){
+			Stats::Phase phase(myStats.get(), "cache");
+			myOpts.treeCache->store(inPath, myCtx.source(),
+				myOpts.optimize, flat, diagnostics);
+		}
+		//Pick up anything the parser didn't get to
+		if (wantTokens){ scanner.drain(); }
+		if (myStats != nullptr){
+			myStats->setSourceBytes(myCtx.source().size());
+			myStats->countTokens(tokens);
+			if (root != nullptr){ myStats->countTree(root); }
+		}
+	} catch (AbortError * e){
+		//Tokens scanned before the error are still listed
+		if (myOpts.tokensFile != nullptr){ ok = writeTokens(tokens) && ok; }
+		myCtx.reset();
+		throw;
+	}
+
+	if (wantTokens){
+		Stats::Phase phase(myStats.get(), "write tokens");
+		if (myOpts.tokensFile != nullptr){
+			ok = writeTokens(tokens) && ok;
+		}
+		if (myOpts.tokenStreamFile != nullptr){
+			ok = writeTokenStream(tokens) && ok;
+		}
+	}
+
+	if (myOpts.unparseFile != nullptr){
+		Stats::Phase phase(myStats.get(), "unparse");
+		ok = writeAST(root) && ok;
+	}
+
+	if (myOpts.asmFile != nullptr && root != nullptr && checked){
+		Stats::Phase phase(myStats.get(), "codegen");
+		try {
+			ok = writeAssembly(root, types) && ok;
+		} catch (AbortError * e){
+			myCtx.reset();
+			throw;
+		}
+	}
+
+	if ((myOpts.run || myOpts.jit) && root != nullptr && checked){
+		try {
+			execute(root, types);
+		} catch (AbortError * e){
+			myCtx.reset();
+			throw;
+		}
+	}
+
+	AstMemory memory;
+	bool measure = root != nullptr
+	  && (myOpts.arenaStats || myStats != nullptr);
+	if (measure){ memory.measure(root, myCtx.source(), tokens); }
+	if (myOpts.arenaStats){
+		reportArena();
+		if (measure){ memory.writeText(Report::err()); }
+	}
+	if (myStats != nullptr){
+		if (measure){ myStats->setMemory(memory); }
+		ok = reportStats() && ok;
+	}
+	myCtx.reset();
+	return ok;
+}
+
+struct Edit{
+	uint32_t start;
+	uint32_t removed;
+	std::string text;
+};
+
+/*
+An edits file (-e) has one edit per line: the byte offset where it
+starts and the number of bytes it replaces, both in the text as the
+edits before it left it, then a space and the replacement, which
+runs to the end of the line and may use \n, \t and \\.
+*/
+static std::vector<Edit> readEdits(const char * path){
+	std::ifstream in(path);
+	if (!in.good()){
+		std::string msg = "Bad edits file ";
+		msg += path;
+		throw new InternalError(msg.c_str());
+	}
+	std::vector<Edit> edits;
+	std::string line;
+	while (std::getline(in, line)){
+		Edit edit;
+		unsigned long start;
+		unsigned long removed;
+		int used = 0;
+		if (sscanf(line.c_str(), "%lu %lu%n", &start, &removed, &used) < 2
+		  || (static_cast<size_t>(used) < line.size() && line[static_cast<size_t>(used)] != ' ')
+		  || start > UINT32_MAX || removed > UINT32_MAX){
+			std::string msg = "Bad edit in ";
+			msg += path;
+			msg += ": " + line;
+			throw new InternalError(msg.c_str());
+		}
+		edit.start = static_cast<uint32_t>(start);
+		edit.removed = static_cast<uint32_t>(removed);
+		for (size_t i = static_cast<size_t>(used) + 1; i < line.size(); i++){
+			char c = line[i];
+			if (c == '\\' && i + 1 < line.size()){
+				c = line[++i];
+				if (c == 'n'){ c = '\n'; }
+				else if (c == 't'){ c = '\t'; }
+			}
+			edit.text += c;
+		}
+		edits.push_back(edit);
+	}
+	return edits;
+}
+
+/*
+With -e the input is parsed once by an IncrementalParser, and each
+edit then relexes and reparses only the declarations it touches.
+The tokens and tree that result are written as a full parse of the
+edited text would have them (p3_tests checks that they match).
+*/
+bool Driver::runEdits(const char * inPath){
+	std::vector<Edit> edits = readEdits(myOpts.editsFile);
+	openInput(inPath, myCtx);
+	const SourceFile& src = myCtx.source();
+	std::string text;
+	if (src.mapped()){
+		text.assign(src.data(), src.size());
+	} else {
+		text.assign(std::istreambuf_iterator<char>(*src.stream()),
+			std::istreambuf_iterator<char>());
+	}
+
+	IncrementalParser parser(myCtx, myOpts.fastScan);
+	parser.parse(text.data(), text.size());
+	for (const Edit& edit : edits){
+		parser.edit(edit.start, edit.removed, edit.text.data(),
+			edit.text.size());
+	}
+
+	bool ok = true;
+	if (myOpts.tokensFile != nullptr){
+		ok = writeTokens(parser.tokens()) && ok;
+	}
+	if (parser.root() == nullptr && myOpts.checkParse){
+		Report::err() << "Parse failed" << std::endl;
+		ok = false;
+	}
+	if (myOpts.unparseFile != nullptr){
+		ok = writeAST(parser.root()) && ok;
+	}
+	myCtx.reset();
+	return ok;
+}
+
+/*
+Output files are written by a Writer straight to the file
+descriptor. A file that can't be created, or a write to it that
+fails (a full disk, say), is reported and gives false.
+*/
+static bool writeFile(const char * outPath,
+	const std::function<void(Writer&)>& emit){
+	int fd = ::open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0){
+		Report::err() << "Error: Bad output file " << outPath << std::endl;
+		return false;
+	}
+	bool ok;
+	{
+		Writer out(fd);
+		emit(out);
+		out.flush();
+		ok = out.good();
+	}
+	ok = ::close(fd) == 0 && ok;
+	if (!ok){
+		Report::err() << "Error: Can't write output file " << outPath << std::endl;
+	}
+	return ok;
+}
+
+/* As writeFile, except that -- means standard output */
+static bool writeOutput(const char * outPath,
+	const std::function<void(Writer&)>& emit){
+	if (strcmp(outPath, "--") != 0){ return writeFile(outPath, emit); }
+	Writer out(Report::out());
+	emit(out);
+	out.flush();
+	if (!out.good()){
+		Report::err() << "Error: Can't write standard output" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Driver::writeTokens(const std::vector<Token *>& tokens){
+	return writeOutput(myOpts.tokensFile, [&](Writer& out){
+		TokenSource::writeTokens(tokens, myCtx.lines(), out);
+	});
+}
+
+/*
+Only written after a complete scan: a stream cut short
+by a lexical error would replay as a different program.
+*/
+bool Driver::writeTokenStream(const std::vector<Token *>& tokens){
+	return writeFile(myOpts.tokenStreamFile, [&](Writer& out){
+		cshanty::writeTokenStream(tokens, myCtx.lines(), out);
+	});
+}
+
+bool Driver::writeAST(const ProgramNode * root){
+	if (root == nullptr){
+		Report::err() << "No AST built\n";
+		return false;
+	}
+	return writeOutput(myOpts.unparseFile, [&](Writer& out){
+		root->unparseParallel(out, myOpts.unparseJobs);
+	});
+}
+
+bool Driver::writeAssembly(const ProgramNode * root, TypeTable& types){
+	return writeOutput(myOpts.asmFile, [&](Writer& out){
+		cshanty::writeAssembly(root, myCtx.lines(), types, out);
+	});
+}
+
+/*
+The program's report output shares standard output with
+the compiler's, and receive reads standard input
+*/
+void Driver::execute(const ProgramNode * root, TypeTable& types){
+	Writer out(Report::out());
+	if (myOpts.jit){
+		Jit jit(myCtx.lines(), types, out, std::cin);
+		{
+			Stats::Phase phase(myStats.get(), "jit");
+			jit.compile(root, myStats.get());
+		}
+		Stats::Phase phase(myStats.get(), "run");
+		jit.run();
+		return;
+	}
+	BcProgram program;
+	{
+		Stats::Phase phase(myStats.get(), "compile");
+		compileBytecode(root, myCtx.lines(), program);
+	}
+	VM vm(program, myCtx.lines(), out, std::cin);
+	{
+		Stats::Phase phase(myStats.get(), "run");
+		vm.run();
+	}
+	if (myStats != nullptr){ myStats->setInstructions(vm.instructions()); }
+}
+
+/*
+The text report goes with the diagnostics; the JSON
+one to its own file, or to standard output for --
+*/
+bool Driver::reportStats(){
+	myStats->countArena(myCtx.arena());
+	if (myOpts.stats){ myStats->writeText(Report::err()); }
+	const char * outPath = myOpts.statsFile;
+	if (outPath == nullptr){ return true; }
+	if (strcmp(outPath, "--") == 0){
+		myStats->writeJSON(Report::out());
+		return true;
+	}
+	std::ofstream out(outPath);
+	if (!out.good()){
+		Report::err() << "Error: Bad output file " << outPath << std::endl;
+		return false;
+	}
+	myStats->writeJSON(out);
+	out.close();
+	if (!out.good()){
+		Report::err() << "Error: Can't write output file " << outPath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void Driver::reportArena(){
+	const Arena& arena = myCtx.arena();
+	Report::err() << "arena: "
+	<< arena.bytesUsed() << " bytes in "
+	<< arena.allocations() << " allocations, "
+	<< arena.bytesReserved() << " bytes reserved; malloc would use ~"
+	<< arena.mallocBytes() << " bytes\n";
+}
+
+} //End namespace cshanty
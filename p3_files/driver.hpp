@@ -0,0 +1,88 @@
+#ifndef CSHANTY_DRIVER_H
+#define CSHANTY_DRIVER_H
+
+#include <memory>
+#include <vector>
+#include "context.hpp"
+#include "flatast.hpp"
+#include "stats.hpp"
+#include "treecache.hpp"
+#include "types.hpp"
+
+namespace cshanty{
+
+/** What cshantyc has been asked to produce for an input **/
+struct DriverOptions{
+	const char * tokensFile = nullptr;
+	//Binary token stream, replayable in place of the source
+	const char * tokenStreamFile = nullptr;
+	bool checkParse = false;
+	//Resolve names (names.hpp), reporting misused ones
+	bool checkNames = false;
+	//Check types (typecheck.hpp), after names
+	bool checkTypes = false;
+	//Simplify the tree (simplify.hpp) before it is used
+	bool optimize = false;
+	const char * unparseFile = nullptr;
+	//Arena usage, and the AST's memory by class (-m)
+	bool arenaStats = false;
+	//Scan with FastScanner rather than the flex Scanner
+	bool fastScan = false;
+	//Directory of serialized ASTs keyed by source hash
+	const char * cacheDir = nullptr;
+	//ASTs kept in memory across runs, by path (--server)
+	TreeCache * treeCache = nullptr;
+	//Worker threads for unparsing (single-file runs)
+	unsigned unparseJobs = 1;
+	//Per-phase timings and counts, as text on stderr
+	// and/or as JSON to statsFile
+	bool stats = false;
+	const char * statsFile = nullptr;
+	//Compile to bytecode and run it (vm.hpp)
+	bool run = false;
+	//Compile to machine code in memory and run it (jit.hpp)
+	bool jit = false;
+	//x86-64 assembly for the program (asmgen.hpp)
+	const char * asmFile = nullptr;
+	//Edits to apply to the input, reparsing incrementally
+	// (incremental.hpp), before the tokens and tree are written
+	const char * editsFile = nullptr;
+};
+
+/**
+* \class Driver
+* Runs the requested phases over one input file. The file is read
+* and scanned exactly once: when tokens are wanted alongside a parse,
+* the scanner records every token it hands the parser, and both the
+* token listing and the unparse are served from that one token buffer
+* and AST. An input that is itself a binary token stream (see
+* tokstream.hpp) is replayed rather than scanned.
+*
+* With -stats the whole input is scanned before parsing starts, so
+* that the two are timed apart; lexical errors are then reported
+* ahead of any syntax errors rather than interleaved with them.
+**/
+class Driver{
+public:
+	Driver(const DriverOptions& opts) : myOpts(opts){ }
+	/** Process inPath. Returns false if any requested output failed **/
+	bool run(const char * inPath);
+	CompilationContext& context(){ return myCtx; }
+private:
+	bool runEdits(const char * inPath);
+	bool writeTokens(const std::vector<Token *>& tokens);
+	bool writeTokenStream(const std::vector<Token *>& tokens);
+	bool writeAST(const ProgramNode * root);
+	bool writeAssembly(const ProgramNode * root, TypeTable& types);
+	void execute(const ProgramNode * root, TypeTable& types);
+	void reportArena();
+	bool reportStats();
+
+	DriverOptions myOpts;
+	CompilationContext myCtx;
+	std::unique_ptr<Stats> myStats;
+};
+
+}
+
+#endif
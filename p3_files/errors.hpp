@@ -26,14 +26,47 @@ private:
 	const char * myMsg;
 };
 
+/**
+* Thrown in place of calling exit() when compilation of a file can't
+* continue, so that one bad input doesn't take down a whole batch.
+**/
+class AbortError{
+public:
+	AbortError(int codeIn) : myCode(codeIn){}
+	int code(){ return myCode; }
+private:
+	int myCode;
+};
+
 class Report{
 public:
+	/*
+	Diagnostics go to err() and other compiler chatter to out().
+	These are std::cerr and std::cout unless the current thread has
+	redirected them (batch mode buffers them per file so the output
+	of concurrent compilations isn't interleaved).
+	*/
+	static std::ostream& err(){
+		std::ostream * sink = errSink();
+		return sink == nullptr ? std::cerr : *sink;
+	}
+
+	static std::ostream& out(){
+		std::ostream * sink = outSink();
+		return sink == nullptr ? std::cout : *sink;
+	}
+
+	static void redirect(std::ostream * errIn, std::ostream * outIn){
+		errSink() = errIn;
+		outSink() = outIn;
+	}
+
 	static void fatal(
 		size_t l, 
 		size_t c, 
 		const char * msg
 	){
-		std::cerr << "FATAL [" << l << "," << c << "]: " 
+		err() << "FATAL [" << l << "," << c << "]: " 
 		<< msg  << std::endl;
 	}
 
@@ -50,7 +83,7 @@ public:
 		size_t c,
 		const char * msg
 	){
-		std::cerr << "*WARNING* [" << l << "," << c << "]: " 
+		err() << "*WARNING* [" << l << "," << c << "]: " 
 		<< msg  << std::endl;
 	}
 
@@ -61,6 +94,16 @@ public:
 	){
 		warn(l,c,msg.c_str());
 	}
+private:
+	static std::ostream *& errSink(){
+		static thread_local std::ostream * sink = nullptr;
+		return sink;
+	}
+
+	static std::ostream *& outSink(){
+		static thread_local std::ostream * sink = nullptr;
+		return sink;
+	}
 };
 
 }
@@ -0,0 +1,416 @@
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <string>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "fastscanner.hpp"
+#include "interner.hpp"
+
+namespace cshanty{
+
+using TokenKind = cshanty::Parser::token;
+
+/*
+Character classes, each as a scalar test and (with SSE2) as a test
+of 16 bytes at once giving 0xFF in the bytes that belong. span()
+finds the end of a run of a class, a block at a time while there
+are 16 bytes left and a byte at a time after that, so nothing is
+read past the end of the source.
+*/
+#if defined(__SSE2__)
+//Bytes in [lo, hi]. Bytes from 0x80 up compare as negative, so
+// they are never in an ASCII range
+static inline __m128i inRange(__m128i v, char lo, char hi){
+	__m128i above = _mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1)));
+	__m128i below = _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(hi + 1)));
+	return _mm_and_si128(above, below);
+}
+
+static inline __m128i equal(__m128i v, char c){
+	return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+#endif
+
+//[ \t]
+struct Blank{
+	static bool byte(char c){ return c == ' ' || c == '\t'; }
+#if defined(__SSE2__)
+	static __m128i block(__m128i v){
+		return _mm_or_si128(equal(v, ' '), equal(v, '\t'));
+	}
+#endif
+};
+
+//{LETTER}|{DIGIT}|_
+struct WordChar{
+	static bool byte(char c){
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+		  || (c >= '0' && c <= '9') || c == '_';
+	}
+#if defined(__SSE2__)
+	static __m128i block(__m128i v){
+		//Setting bit 5 folds upper case onto lower case, and
+		// nothing else onto a-z
+		__m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		return _mm_or_si128(
+			_mm_or_si128(inRange(folded, 'a', 'z'), inRange(v, '0', '9')),
+			equal(v, '_'));
+	}
+#endif
+};
+
+//{DIGIT}
+struct Digit{
+	static bool byte(char c){ return c >= '0' && c <= '9'; }
+#if defined(__SSE2__)
+	static __m128i block(__m128i v){ return inRange(v, '0', '9'); }
+#endif
+};
+
+//[^\n], the body of a comment
+struct NotNewline{
+	static bool byte(char c){ return c != '\n'; }
+#if defined(__SSE2__)
+	static __m128i block(__m128i v){
+		return _mm_xor_si128(equal(v, '\n'), _mm_set1_epi8(-1));
+	}
+#endif
+};
+
+//[^\\\n"], the characters a string literal takes as they are
+struct StrPlain{
+	static bool byte(char c){ return c != '"' && c != '\\' && c != '\n'; }
+#if defined(__SSE2__)
+	static __m128i block(__m128i v){
+		__m128i stop = _mm_or_si128(_mm_or_si128(equal(v, '"'),
+			equal(v, '\\')), equal(v, '\n'));
+		return _mm_xor_si128(stop, _mm_set1_epi8(-1));
+	}
+#endif
+};
+
+template <typename Class>
+static const char * span(const char * p, const char * end){
+#if defined(__SSE2__)
+	while (end - p >= 16){
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		unsigned out = ~static_cast<unsigned>(
+			_mm_movemask_epi8(Class::block(v))) & 0xFFFFu;
+		if (out != 0){ return p + __builtin_ctz(out); }
+		p += 16;
+	}
+#endif
+	while (p < end && Class::byte(*p)){ p++; }
+	return p;
+}
+
+/*
+Keywords are identifiers as far as span() is concerned; one is
+only a keyword if it is the whole run, as "iff" is an ID in flex.
+*/
+static int keyword(const char * s, size_t len){
+	struct Keyword{ const char * text; int kind; };
+	static const Keyword keywords[] = {
+		{"int", TokenKind::INT}, {"bool", TokenKind::BOOL},
+		{"string", TokenKind::STRING}, {"record", TokenKind::RECORD},
+		{"void", TokenKind::VOID}, {"if", TokenKind::IF},
+		{"else", TokenKind::ELSE}, {"while", TokenKind::WHILE},
+		{"return", TokenKind::RETURN}, {"false", TokenKind::FALSE},
+		{"nay", TokenKind::FALSE}, {"true", TokenKind::TRUE},
+		{"aye", TokenKind::TRUE}, {"report", TokenKind::REPORT},
+		{"receive", TokenKind::RECEIVE}, {"ahoy", TokenKind::OPEN},
+		{"plus", TokenKind::PLUS}, {"minus", TokenKind::MINUS},
+		{"times", TokenKind::TIMES}, {"divide", TokenKind::DIVIDE},
+		{"and", TokenKind::AND}, {"or", TokenKind::OR},
+		{"equals", TokenKind::EQUALS}, {"gets", TokenKind::ASSIGN},
+	};
+	if (len < 2 || len > 7){ return 0; }
+	for (const Keyword& k : keywords){
+		if (k.text[0] == s[0] && strlen(k.text) == len
+		  && memcmp(k.text, s, len) == 0){
+			return k.kind;
+		}
+	}
+	return 0;
+}
+
+/*
+Each phrase is longer than the identifier its first word would
+make, so where one matches in full it is the longest match.
+*/
+static int phrase(const char * s, const char * end, size_t * len){
+	struct Phrase{ const char * text; int kind; };
+	static const Phrase phrases[] = {
+		{"we'll take our leave and go", TokenKind::RETURN},
+		{"shove off", TokenKind::CLOSE},
+		{"heave and go", TokenKind::SEMICOL},
+		{"roll and go", TokenKind::SEMICOL},
+	};
+	for (const Phrase& p : phrases){
+		if (p.text[0] != s[0]){ continue; }
+		size_t n = strlen(p.text);
+		if (static_cast<size_t>(end - s) >= n && memcmp(p.text, s, n) == 0){
+			*len = n;
+			return p.kind;
+		}
+	}
+	return 0;
+}
+
+FastScanner::FastScanner(CompilationContext& ctx)
+: TokenSource(ctx), myText(nullptr), mySize(0), myOffset(0){
+	load();
+}
+
+FastScanner::FastScanner(CompilationContext& ctx, uint32_t start)
+: TokenSource(ctx), myText(nullptr), mySize(0), myOffset(start){
+	load();
+}
+
+/*
+The whole text has to be in memory. A source that isn't mapped is
+read into the arena, where its lexemes then live.
+*/
+void FastScanner::load(){
+	const SourceFile& src = myCtx.source();
+	if (src.mapped()){
+		myText = src.data();
+		mySize = static_cast<uint32_t>(src.size());
+		return;
+	}
+	std::istream& in = *src.stream();
+	std::string text((std::istreambuf_iterator<char>(in)),
+		std::istreambuf_iterator<char>());
+	if (text.size() > SourceFile::MAX_SIZE){ errTooLarge(); }
+	char * copy = static_cast<char *>(arena().alloc(text.size(), 1));
+	memcpy(copy, text.data(), text.size());
+	myText = copy;
+	mySize = static_cast<uint32_t>(text.size());
+}
+
+Position FastScanner::consume(size_t len){
+	uint32_t start = myOffset;
+	myOffset += static_cast<uint32_t>(len);
+	return Position(start, myOffset);
+}
+
+int FastScanner::makeBareToken(Parser::semantic_type * lval, int kind,
+	size_t len){
+	Position pos = consume(len);
+	lval->lexeme = new (arena()) Token(pos, kind);
+	return kind;
+}
+
+int FastScanner::lex(cshanty::Parser::semantic_type * const lval){
+	const char * end = myText + mySize;
+	while (true){
+		const char * p = myText + myOffset;
+		if (p == end){
+			lval->lexeme = new (arena()) Token(
+			  Position(myOffset, myOffset), TokenKind::END);
+			return TokenKind::END;
+		}
+		bool two = end - p >= 2;
+		switch (*p){
+		case ' ': case '\t':
+			consume(static_cast<size_t>(span<Blank>(p, end) - p));
+			continue;
+		case '\n':
+			consume(1);
+			myCtx.lines().addLine(myOffset);
+			continue;
+		case '\r':
+			if (two && p[1] == '\n'){
+				consume(2);
+				myCtx.lines().addLine(myOffset);
+				continue;
+			}
+			break;
+		case '/':
+			if (two && p[1] == '/'){
+				consume(static_cast<size_t>(span<NotNewline>(p + 2, end) - p));
+				continue;
+			}
+			return makeBareToken(lval, TokenKind::DIVIDE, 1);
+		case '"': {
+			int kind = strLit(lval);
+			if (kind != 0){ return kind; }
+			continue;
+		}
+		case '[': return makeBareToken(lval, TokenKind::LBRACE, 1);
+		case ']': return makeBareToken(lval, TokenKind::RBRACE, 1);
+		case '{': return makeBareToken(lval, TokenKind::OPEN, 1);
+		case '}': return makeBareToken(lval, TokenKind::CLOSE, 1);
+		case '(': return makeBareToken(lval, TokenKind::LPAREN, 1);
+		case ')': return makeBareToken(lval, TokenKind::RPAREN, 1);
+		case ';': return makeBareToken(lval, TokenKind::SEMICOL, 1);
+		case ',': return makeBareToken(lval, TokenKind::COMMA, 1);
+		case '*': return makeBareToken(lval, TokenKind::TIMES, 1);
+		case '+':
+			if (two && p[1] == '+'){
+				return makeBareToken(lval, TokenKind::INC, 2);
+			}
+			return makeBareToken(lval, TokenKind::PLUS, 1);
+		case '-':
+			if (two && p[1] == '-'){
+				return makeBareToken(lval, TokenKind::DEC, 2);
+			}
+			return makeBareToken(lval, TokenKind::MINUS, 1);
+		case '!':
+			if (two && p[1] == '='){
+				return makeBareToken(lval, TokenKind::NOTEQUALS, 2);
+			}
+			return makeBareToken(lval, TokenKind::NOT, 1);
+		case '=':
+			if (two && p[1] == '='){
+				return makeBareToken(lval, TokenKind::EQUALS, 2);
+			}
+			return makeBareToken(lval, TokenKind::ASSIGN, 1);
+		case '<':
+			if (two && p[1] == '='){
+				return makeBareToken(lval, TokenKind::LESSEQ, 2);
+			}
+			return makeBareToken(lval, TokenKind::LESS, 1);
+		case '>':
+			if (two && p[1] == '='){
+				return makeBareToken(lval, TokenKind::GREATEREQ, 2);
+			}
+			return makeBareToken(lval, TokenKind::GREATER, 1);
+		case '&':
+			if (two && p[1] == '&'){
+				return makeBareToken(lval, TokenKind::AND, 2);
+			}
+			break;
+		case '|':
+			if (two && p[1] == '|'){
+				return makeBareToken(lval, TokenKind::OR, 2);
+			}
+			break;
+		default:
+			if (Digit::byte(*p)){ return number(lval); }
+			if (WordChar::byte(*p)){ return word(lval); }
+			break;
+		}
+		//flex's catch-all rule. Its yytext is a C string, so a
+		// NUL byte is reported as nothing at all
+		errIllegal(curLine(), curCol(), std::string(p, *p == '\0' ? 0 : 1));
+		throw new AbortError(1);
+	}
+}
+
+int FastScanner::word(Parser::semantic_type * lval){
+	const char * p = myText + myOffset;
+	const char * end = myText + mySize;
+	size_t len = static_cast<size_t>(span<WordChar>(p, end) - p);
+
+	size_t phraseLen;
+	int kind = phrase(p, end, &phraseLen);
+	if (kind != 0){ return makeBareToken(lval, kind, phraseLen); }
+	kind = keyword(p, len);
+	if (kind != 0){ return makeBareToken(lval, kind, len); }
+
+	Position pos = consume(len);
+	lval->transToken = new (arena()) IDToken(pos,
+	  Interner::global().intern(p, len));
+	return TokenKind::ID;
+}
+
+int FastScanner::number(Parser::semantic_type * lval){
+	const char * p = myText + myOffset;
+	size_t len = static_cast<size_t>(span<Digit>(p, myText + mySize) - p);
+	int value;
+	if (!intLitValue(p, len, &value)){
+		errIntOverflow(curLine(), curCol());
+	}
+	Position pos = consume(len);
+	lval->transToken = new (arena()) IntLitToken(pos, value);
+	return TokenKind::INTLITERAL;
+}
+
+/*
+cshanty.l has four string rules, and flex takes the longest of
+their matches, the earliest rule on a tie:
+
+  GOOD        "{STRELT}*"
+  UNTERM      "{STRELT}*                  (fatal)
+  BAD_UNTERM  "({STRELT}*{BADESC}{STRELT}*)+
+  BAD         "({STRELT}*{BADESC}{STRELT}*)+"
+
+They overlap (a lone backslash is a BADESC, so \n also reads as a
+bad escape followed by an n), so rather than untangle them this runs
+all four at once as a small NFA and notes where each last accepted.
+IN and IN_BAD are between elements, before and after a bad escape;
+ESC and ESC_BAD have just read a backslash. Between elements the
+NFA only changes state at a quote, backslash or newline, so plain
+text is skipped in blocks. Returns 0 for a literal that is reported
+and skipped.
+*/
+int FastScanner::strLit(Parser::semantic_type * lval){
+	enum Rule { GOOD, UNTERM, BAD_UNTERM, BAD };
+	enum State { IN = 1, IN_BAD = 2, ESC = 4, ESC_BAD = 8 };
+	const char * open = myText + myOffset;
+	const char * end = myText + mySize;
+	size_t longest[4] = {0, 0, 0, 0};
+
+	unsigned states = IN;
+	const char * q = open + 1;
+	while (states != 0){
+		if ((states & (ESC | ESC_BAD)) == 0){ q = span<StrPlain>(q, end); }
+		size_t len = static_cast<size_t>(q - open);
+		if (states & IN){ longest[UNTERM] = len; }
+		if (states & IN_BAD){ longest[BAD_UNTERM] = len; }
+		if (q == end){ break; }
+
+		char c = *q++;
+		unsigned next = 0;
+		if (c == '\n'){
+			//Ends every rule
+		} else if (c == '"'){
+			if (states & IN){ longest[GOOD] = len + 1; }
+			if (states & IN_BAD){ longest[BAD] = len + 1; }
+			if (states & ESC){ next |= IN; }
+			if (states & ESC_BAD){ next |= IN_BAD; }
+		} else if (c == '\\'){
+			//Either the start of an escape or a BADESC on its own
+			if (states & IN){ next |= ESC | IN_BAD; }
+			if (states & IN_BAD){ next |= ESC_BAD | IN_BAD; }
+			if (states & ESC){ next |= IN; }
+			if (states & ESC_BAD){ next |= IN_BAD; }
+		} else {
+			bool escapee = c == 'n' || c == 't';
+			if (states & IN){ next |= IN; }
+			if (states & (IN_BAD | ESC_BAD)){ next |= IN_BAD; }
+			if (states & ESC){ next |= escapee ? IN : IN_BAD; }
+		}
+		states = next;
+	}
+
+	int rule = GOOD;
+	for (int r = UNTERM; r <= BAD; r++){
+		if (longest[r] > longest[rule]){ rule = r; }
+	}
+	size_t len = longest[rule];
+	switch (rule){
+	case GOOD: {
+		Position pos = consume(len);
+		lval->transToken = new (arena()) StrToken(pos, StringRef(open, len));
+		return TokenKind::STRLITERAL;
+	}
+	case UNTERM:
+		errStrUnterm(curLine(), curCol());
+		consume(len);
+		throw new AbortError(1);
+	case BAD_UNTERM:
+		errStrEscAndUnterm(curLine(), curCol());
+		consume(len);
+		return 0;
+	default:
+		errStrEsc(curLine(), curCol());
+		consume(len);
+		return 0;
+	}
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef CSHANTY_FASTSCANNER_H
+#define CSHANTY_FASTSCANNER_H
+
+#include "grammar.hh"
+#include "errors.hpp"
+#include "context.hpp"
+#include "tokensource.hpp"
+
+namespace cshanty{
+
+/**
+* \class FastScanner
+* A hand-written alternative to the flex Scanner, producing exactly
+* the tokens, positions, lines and diagnostics that cshanty.l does.
+* It works straight on the source text rather than through flex's
+* byte-at-a-time DFA: runs of blanks, comment bodies, identifier and
+* digit runs, and the plain stretches of string literals are each
+* found 16 bytes at a time with SSE2 (scalar where unavailable).
+* Identifiers are then checked against the keywords, and the words
+* that open a multi-word keyword ("shove off" and friends) against
+* the rest of the phrase, longest match winning as it does in flex.
+**/
+class FastScanner : public TokenSource{
+public:
+	// Scans the file currently open in ctx.source()
+	FastScanner(CompilationContext& ctx);
+	// Scans ctx.source() from byte offset start, which must lie
+	// between tokens (not inside a comment or string)
+	FastScanner(CompilationContext& ctx, uint32_t start);
+protected:
+	int lex(cshanty::Parser::semantic_type * const lval) override;
+private:
+	void load();
+	int makeBareToken(Parser::semantic_type * lval, int kind, size_t len);
+	Position consume(size_t len);
+	int word(Parser::semantic_type * lval);
+	int number(Parser::semantic_type * lval);
+	int strLit(Parser::semantic_type * lval);
+
+	size_t curLine() const { return myCtx.lines().line(myOffset); }
+	size_t curCol() const { return myCtx.lines().col(myOffset); }
+
+	const char * myText;
+	uint32_t mySize;
+	uint32_t myOffset;
+};
+
+}
+
+#endif
@@ -0,0 +1,460 @@
+#include "flatast.hpp"
+#include "visitor.hpp"
+
+namespace cshanty{
+
+/**
+* \class FlatBuilder
+* Lays a pointer tree out as a FlatAST. Each handler appends the
+* node's children (via child() and list()) and then the node itself,
+* so every record refers only to records before it. Children are
+* appended into locals first so the layout doesn't depend on
+* argument evaluation order. Slots are filled in the order the
+* node's constructor takes them.
+**/
+class FlatBuilder : public AstVisitor<FlatBuilder, uint32_t>{
+public:
+	FlatBuilder(FlatAST& flat) : myFlat(flat){ }
+
+	uint32_t visitProgram(const ProgramNode * node){
+		return add(node, list(node->globals()));
+	}
+
+	uint32_t visitVarDecl(const VarDeclNode * node){
+		uint32_t type = child(node->type());
+		uint32_t id = child(node->id());
+		return add(node, type, id);
+	}
+
+	uint32_t visitFormalDecl(const FormalDeclNode * node){
+		return visitVarDecl(node);
+	}
+
+	uint32_t visitFnDecl(const FnDeclNode * node){
+		uint32_t type = child(node->type());
+		uint32_t id = child(node->id());
+		uint32_t formals = list(node->formals());
+		uint32_t body = list(node->body());
+		return add(node, type, id, formals, body);
+	}
+
+	uint32_t visitRecordTypeDecl(const RecordTypeDeclNode * node){
+		uint32_t id = child(node->id());
+		uint32_t fields = list(node->fields());
+		return add(node, id, fields);
+	}
+
+	uint32_t visitRecordType(const RecordTypeNode * node){
+		return add(node, child(node->id()));
+	}
+
+	uint32_t visitAssignStmt(const AssignStmtNode * node){
+		return add(node, child(node->assign()));
+	}
+
+	uint32_t visitCallStmt(const CallStmtNode * node){
+		return add(node, child(node->call()));
+	}
+
+	uint32_t visitIfElseStmt(const IfElseStmtNode * node){
+		uint32_t cond = child(node->cond());
+		uint32_t tBranch = list(node->thenBranch());
+		uint32_t fBranch = list(node->elseBranch());
+		return add(node, cond, tBranch, fBranch);
+	}
+
+	uint32_t visitIfStmt(const IfStmtNode * node){
+		uint32_t cond = child(node->cond());
+		uint32_t body = list(node->body());
+		return add(node, cond, body);
+	}
+
+	uint32_t visitPostDecStmt(const PostDecStmtNode * node){
+		return add(node, child(node->lval()));
+	}
+
+	uint32_t visitPostIncStmt(const PostIncStmtNode * node){
+		return add(node, child(node->lval()));
+	}
+
+	uint32_t visitReceiveStmt(const ReceiveStmtNode * node){
+		return add(node, child(node->lval()));
+	}
+
+	uint32_t visitReportStmt(const ReportStmtNode * node){
+		return add(node, child(node->exp()));
+	}
+
+	uint32_t visitWhileStmt(const WhileStmtNode * node){
+		uint32_t cond = child(node->cond());
+		uint32_t body = list(node->body());
+		return add(node, cond, body);
+	}
+
+	uint32_t visitReturnStmt(const ReturnStmtNode * node){
+		return add(node, child(node->exp()));
+	}
+
+	uint32_t visitAssignExp(const AssignExpNode * node){
+		uint32_t lval = child(node->lval());
+		uint32_t exp = child(node->exp());
+		return add(node, lval, exp);
+	}
+
+	uint32_t visitCallExp(const CallExpNode * node){
+		uint32_t id = child(node->callee());
+		uint32_t args = list(node->args());
+		return add(node, id, args);
+	}
+
+	uint32_t visitIntLit(const IntLitNode * node){
+		return add(node, static_cast<uint32_t>(node->value()));
+	}
+
+	uint32_t visitStrLit(const StrLitNode * node){
+		myFlat.myStrings.push_back(node->str());
+		return add(node, static_cast<uint32_t>(myFlat.myStrings.size() - 1));
+	}
+
+	uint32_t visitID(const IDNode * node){
+		return add(node, node->getName().id());
+	}
+
+	uint32_t visitIndex(const IndexNode * node){
+		uint32_t id1 = child(node->recordId());
+		uint32_t id2 = child(node->fieldId());
+		return add(node, id1, id2);
+	}
+
+	uint32_t visitBinaryExp(const BinaryExpNode * node){
+		uint32_t lhs = child(node->lhs());
+		uint32_t rhs = child(node->rhs());
+		return add(node, lhs, rhs);
+	}
+
+	uint32_t visitUnaryExp(const UnaryExpNode * node){
+		return add(node, child(node->exp()));
+	}
+
+	//Types and literals without operands
+	uint32_t visitNode(const ASTNode * node){
+		return add(node);
+	}
+private:
+	/** Append a record; returns its node number **/
+	uint32_t add(const ASTNode * node, uint32_t a = 0, uint32_t b = 0,
+		uint32_t c = 0, uint32_t d = 0){
+		AstRecord rec;
+		rec.kind = node->kind();
+		rec.reserved = 0;
+		rec.start = node->pos().start();
+		rec.end = node->pos().end();
+		rec.slot[0] = a;
+		rec.slot[1] = b;
+		rec.slot[2] = c;
+		rec.slot[3] = d;
+		myFlat.myNodes.push_back(rec);
+		return static_cast<uint32_t>(myFlat.myNodes.size());
+	}
+
+	/** Append n if there is one; 0 otherwise **/
+	uint32_t child(const ASTNode * n){
+		return n == nullptr ? 0 : visit(n);
+	}
+
+	/** Append each element, then the list; returns its number **/
+	template <typename T>
+	uint32_t list(const NodeList<T *> * elts){
+		if (elts == nullptr){ return 0; }
+		size_t mark = myPending.size();
+		for (auto elt : *elts){ myPending.push_back(child(elt)); }
+		auto first = myPending.begin() + static_cast<long>(mark);
+		myFlat.myLists.push_back(static_cast<uint32_t>(myFlat.myItems.size()));
+		myFlat.myLists.push_back(static_cast<uint32_t>(myPending.end() - first));
+		myFlat.myItems.insert(myFlat.myItems.end(), first, myPending.end());
+		myPending.erase(first, myPending.end());
+		return static_cast<uint32_t>(myFlat.myLists.size() / 2);
+	}
+
+	FlatAST& myFlat;
+	//Items of the lists being appended, innermost last
+	std::vector<uint32_t> myPending;
+};
+
+static const SlotKind SLOTS[KIND_LIMIT][4] = {
+	{ SLOT_NONE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //(unused)
+	{ SLOT_LIST, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //PROGRAM
+	{ SLOT_NONE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //BOOL_TYPE
+	{ SLOT_NONE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //INT_TYPE
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //RECORD_TYPE
+	{ SLOT_NONE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //STRING_TYPE
+	{ SLOT_NONE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //VOID_TYPE
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //VAR_DECL
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //FORMAL_DECL
+	{ SLOT_NODE, SLOT_NODE, SLOT_LIST, SLOT_LIST }, //FN_DECL
+	{ SLOT_NODE, SLOT_LIST, SLOT_NONE, SLOT_NONE }, //RECORD_TYPE_DECL
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //ASSIGN_STMT
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //CALL_STMT
+	{ SLOT_NODE, SLOT_LIST, SLOT_LIST, SLOT_NONE }, //IF_ELSE_STMT
+	{ SLOT_NODE, SLOT_LIST, SLOT_NONE, SLOT_NONE }, //IF_STMT
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //POST_DEC_STMT
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //POST_INC_STMT
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //RECEIVE_STMT
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //REPORT_STMT
+	{ SLOT_NODE, SLOT_LIST, SLOT_NONE, SLOT_NONE }, //WHILE_STMT
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //RETURN_STMT
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //ASSIGN_EXP
+	{ SLOT_NODE, SLOT_LIST, SLOT_NONE, SLOT_NONE }, //CALL_EXP
+	{ SLOT_VALUE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //INT_LIT
+	{ SLOT_VALUE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //STR_LIT
+	{ SLOT_NONE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //TRUE
+	{ SLOT_NONE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //FALSE
+	{ SLOT_VALUE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //ID
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //INDEX
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //AND
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //DIVIDE
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //EQUALS
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //GREATER_EQ
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //GREATER
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //LESS_EQ
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //LESS
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //MINUS
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //NOT_EQUALS
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //OR
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //PLUS
+	{ SLOT_NODE, SLOT_NODE, SLOT_NONE, SLOT_NONE }, //TIMES
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //NEG
+	{ SLOT_NODE, SLOT_NONE, SLOT_NONE, SLOT_NONE }, //NOT
+};
+
+const SlotKind * slotKinds(uint16_t kind){
+	return SLOTS[kind < KIND_LIMIT ? kind : 0];
+}
+
+void FlatAST::build(const ProgramNode * root){
+	clear();
+	myRoot = FlatBuilder(*this).visit(root);
+}
+
+void FlatAST::clear(){
+	myNodes.clear();
+	myLists.clear();
+	myItems.clear();
+	myStrings.clear();
+	myRoot = 0;
+}
+
+/*
+Pointer comparisons across unrelated objects aren't defined,
+so the range checks are done on addresses
+*/
+bool FlatAST::rebase(const char * from, size_t size, const char * to){
+	uintptr_t begin = reinterpret_cast<uintptr_t>(from);
+	for (const StringRef& str : myStrings){
+		uintptr_t at = reinterpret_cast<uintptr_t>(str.data());
+		if (at < begin || at - begin + str.size() > size){ return false; }
+	}
+	for (StringRef& str : myStrings){
+		size_t offset = reinterpret_cast<uintptr_t>(str.data()) - begin;
+		str = StringRef(to + offset, str.size());
+	}
+	return true;
+}
+
+size_t FlatAST::bytes() const{
+	return myNodes.capacity() * sizeof(AstRecord)
+	  + (myLists.capacity() + myItems.capacity()) * sizeof(uint32_t)
+	  + myStrings.capacity() * sizeof(StringRef);
+}
+
+bool FlatAST::valid() const{
+	uint32_t count = static_cast<uint32_t>(myNodes.size());
+	uint32_t lists = static_cast<uint32_t>(myLists.size() / 2);
+	for (uint32_t n = 1; n <= count; n++){
+		const AstRecord& rec = node(n);
+		if (rec.kind == 0 || rec.kind >= KIND_LIMIT){ return false; }
+		const SlotKind * kinds = slotKinds(rec.kind);
+		for (int i = 0; i < 4; i++){
+			uint32_t ref = rec.slot[i];
+			if (kinds[i] == SLOT_NODE && ref >= n){ return false; }
+			if (kinds[i] != SLOT_LIST || ref == 0){ continue; }
+			if (ref > lists){ return false; }
+			uint64_t first = myLists[2 * (ref - 1)];
+			uint64_t size = myLists[2 * (ref - 1) + 1];
+			if (first + size > myItems.size()){ return false; }
+			for (auto item = listBegin(ref); item != listEnd(ref); item++){
+				if (*item == 0 || *item >= n){ return false; }
+			}
+		}
+		if (rec.kind == KIND_STR_LIT && rec.slot[0] >= myStrings.size()){
+			return false;
+		}
+		if (rec.kind == KIND_ID && rec.slot[0] >= Interner::global().size()){
+			return false;
+		}
+	}
+	return myRoot != 0 && myRoot <= count && node(myRoot).kind == KIND_PROGRAM;
+}
+
+/**
+* \class TreeBuilder
+* Rebuilds pointer nodes from a FlatAST in record order. Since
+* children precede their parents, fixing up a record's operands
+* is just a lookup of nodes that have already been built. A child
+* of the wrong class makes the whole rebuild fail.
+**/
+class TreeBuilder{
+public:
+	TreeBuilder(const FlatAST& flat, Arena& arena)
+	: myFlat(flat), myArena(arena), myBuilt(flat.nodes() + 1, nullptr),
+	  myOk(true){
+	}
+
+	ProgramNode * build(){
+		for (uint32_t n = 1; n <= myFlat.nodes(); n++){
+			myBuilt[n] = buildNode(myFlat.node(n));
+			if (!myOk || myBuilt[n] == nullptr){ return nullptr; }
+		}
+		return nodeCast<ProgramNode>(myBuilt[myFlat.root()]);
+	}
+private:
+	//0 means no child; anything else must be of the right class
+	template <typename T>
+	T * get(uint32_t ref){
+		if (ref == 0){ return nullptr; }
+		T * node = nodeCast<T>(myBuilt[ref]);
+		if (node == nullptr){ myOk = false; }
+		return node;
+	}
+
+	template <typename T>
+	NodeList<T *> * list(uint32_t ref){
+		if (ref == 0){ return nullptr; }
+		NodeList<T *> * elts = newList<T *>(myArena);
+		for (auto item = myFlat.listBegin(ref); item != myFlat.listEnd(ref);
+		  item++){
+			T * elt = get<T>(*item);
+			if (elt == nullptr){
+				myOk = false;
+				return nullptr;
+			}
+			elts->push_back(elt);
+		}
+		return elts;
+	}
+
+	ASTNode * buildNode(const AstRecord& rec);
+
+	const FlatAST& myFlat;
+	Arena& myArena;
+	std::vector<ASTNode *> myBuilt;
+	bool myOk;
+};
+
+ASTNode * TreeBuilder::buildNode(const AstRecord& rec){
+	Arena& arena = myArena;
+	Position p(rec.start, rec.end);
+	const uint32_t * s = rec.slot;
+	switch (rec.kind){
+	case KIND_PROGRAM: {
+		NodeList<DeclNode *> * globals = list<DeclNode>(s[0]);
+		if (globals == nullptr){ return nullptr; }
+		return new (arena) ProgramNode(globals);
+	}
+	case KIND_VAR_DECL:
+		return new (arena) VarDeclNode(p, get<TypeNode>(s[0]), get<IDNode>(s[1]));
+	case KIND_FORMAL_DECL:
+		return new (arena) FormalDeclNode(p, get<TypeNode>(s[0]),
+			get<IDNode>(s[1]));
+	case KIND_FN_DECL:
+		return new (arena) FnDeclNode(p, get<TypeNode>(s[0]),
+			get<IDNode>(s[1]), list<FormalDeclNode>(s[2]),
+			list<StmtNode>(s[3]));
+	case KIND_RECORD_TYPE_DECL:
+		return new (arena) RecordTypeDeclNode(p, get<IDNode>(s[0]),
+			list<VarDeclNode>(s[1]));
+	case KIND_BOOL_TYPE: return new (arena) BoolTypeNode(p);
+	case KIND_INT_TYPE: return new (arena) IntTypeNode(p);
+	case KIND_RECORD_TYPE:
+		return new (arena) RecordTypeNode(p, get<IDNode>(s[0]));
+	case KIND_STRING_TYPE: return new (arena) StringTypeNode(p);
+	case KIND_VOID_TYPE: return new (arena) VoidTypeNode(p);
+	case KIND_ASSIGN_STMT:
+		return new (arena) AssignStmtNode(p, get<AssignExpNode>(s[0]));
+	case KIND_CALL_STMT:
+		return new (arena) CallStmtNode(p, get<CallExpNode>(s[0]));
+	case KIND_IF_ELSE_STMT:
+		return new (arena) IfElseStmtNode(p, get<ExpNode>(s[0]),
+			list<StmtNode>(s[1]), list<StmtNode>(s[2]));
+	case KIND_IF_STMT:
+		return new (arena) IfStmtNode(p, get<ExpNode>(s[0]),
+			list<StmtNode>(s[1]));
+	case KIND_POST_DEC_STMT:
+		return new (arena) PostDecStmtNode(p, get<LValNode>(s[0]));
+	case KIND_POST_INC_STMT:
+		return new (arena) PostIncStmtNode(p, get<LValNode>(s[0]));
+	case KIND_RECEIVE_STMT:
+		return new (arena) ReceiveStmtNode(p, get<LValNode>(s[0]));
+	case KIND_REPORT_STMT:
+		return new (arena) ReportStmtNode(p, get<ExpNode>(s[0]));
+	case KIND_WHILE_STMT:
+		return new (arena) WhileStmtNode(p, get<ExpNode>(s[0]),
+			list<StmtNode>(s[1]));
+	case KIND_RETURN_STMT:
+		return new (arena) ReturnStmtNode(p, get<ExpNode>(s[0]));
+	case KIND_ASSIGN_EXP:
+		return new (arena) AssignExpNode(p, get<LValNode>(s[0]),
+			get<ExpNode>(s[1]));
+	case KIND_CALL_EXP:
+		return new (arena) CallExpNode(p, get<IDNode>(s[0]),
+			list<ExpNode>(s[1]));
+	case KIND_INT_LIT:
+		return new (arena) IntLitNode(p, static_cast<int>(s[0]));
+	case KIND_STR_LIT:
+		return new (arena) StrLitNode(p, myFlat.string(s[0]));
+	case KIND_TRUE: return new (arena) TrueNode(p);
+	case KIND_FALSE: return new (arena) FalseNode(p);
+	case KIND_ID: return new (arena) IDNode(p, Symbol(s[0]));
+	case KIND_INDEX:
+		return new (arena) IndexNode(p, get<IDNode>(s[0]), get<IDNode>(s[1]));
+	case KIND_AND:
+		return new (arena) AndNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_DIVIDE:
+		return new (arena) DivideNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_EQUALS:
+		return new (arena) EqualsNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_GREATER_EQ:
+		return new (arena) GreaterEqNode(p, get<ExpNode>(s[0]),
+			get<ExpNode>(s[1]));
+	case KIND_GREATER:
+		return new (arena) GreaterNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_LESS_EQ:
+		return new (arena) LessEqNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_LESS:
+		return new (arena) LessNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_MINUS:
+		return new (arena) MinusNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_NOT_EQUALS:
+		return new (arena) NotEqualsNode(p, get<ExpNode>(s[0]),
+			get<ExpNode>(s[1]));
+	case KIND_OR:
+		return new (arena) OrNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_PLUS:
+		return new (arena) PlusNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_TIMES:
+		return new (arena) TimesNode(p, get<ExpNode>(s[0]), get<ExpNode>(s[1]));
+	case KIND_NEG: return new (arena) NegNode(p, get<ExpNode>(s[0]));
+	case KIND_NOT: return new (arena) NotNode(p, get<ExpNode>(s[0]));
+	default:
+		myOk = false;
+		return nullptr;
+	}
+}
+
+ProgramNode * FlatAST::toTree(Arena& arena) const{
+	if (empty()){ return nullptr; }
+	TreeBuilder builder(*this, arena);
+	return builder.build();
+}
+
+}
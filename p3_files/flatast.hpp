@@ -0,0 +1,94 @@
+#ifndef CSHANTY_FLATAST_H
+#define CSHANTY_FLATAST_H
+
+#include <vector>
+#include "ast.hpp"
+
+namespace cshanty{
+
+/**
+* One node of a FlatAST: its kind, its span, and four operand slots.
+* Depending on the kind a slot holds a node number, a list number
+* (both 1-based, 0 for none), a symbol id (KIND_ID), an index into
+* the string table (KIND_STR_LIT) or an integer literal's value.
+* Slots are filled in the order the node's constructor takes them.
+**/
+struct AstRecord{
+	uint16_t kind;
+	uint16_t reserved;
+	uint32_t start;
+	uint32_t end;
+	uint32_t slot[4];
+};
+
+/** What each slot of a record holds, by node kind **/
+enum SlotKind : uint8_t{ SLOT_NONE, SLOT_NODE, SLOT_LIST, SLOT_VALUE };
+const SlotKind * slotKinds(uint16_t kind);
+
+/**
+* \class FlatAST
+* The AST laid out as data: every node is a fixed-size record in
+* one contiguous array, children are 32-bit node numbers, and each
+* list is a contiguous range of node numbers in a shared item array.
+* Nodes are stored children first, so a subtree occupies a
+* contiguous run of records ending in its root and a walk over it
+* touches memory in order, with no list cells or per-node heap
+* blocks to chase.
+*
+* The parser builds the pointer tree, which every pass works on;
+* build() lays it out in one walk (a FlatBuilder visitor). This is
+* the form the AST caches (astcache.hpp, treecache.hpp) keep, and a
+* cache hit gets its pointer tree back with toTree().
+**/
+class FlatAST{
+public:
+	FlatAST() : myRoot(0){ }
+
+	/** Replace the contents with the tree under root **/
+	void build(const ProgramNode * root);
+	void clear();
+	bool empty() const { return myRoot == 0; }
+
+	/** Node number of the ProgramNode **/
+	uint32_t root() const { return myRoot; }
+	const AstRecord& node(uint32_t n) const { return myNodes[n - 1]; }
+	size_t nodes() const { return myNodes.size(); }
+	/** Elements of list n, which may be 0 (no list) **/
+	const uint32_t * listBegin(uint32_t n) const {
+		return n == 0 ? nullptr : myItems.data() + myLists[2 * (n - 1)];
+	}
+	const uint32_t * listEnd(uint32_t n) const {
+		return n == 0 ? nullptr : listBegin(n) + myLists[2 * (n - 1) + 1];
+	}
+	StringRef string(uint32_t n) const { return myStrings[n]; }
+	/** Heap bytes used by the arrays **/
+	size_t bytes() const;
+	/**
+	* Point the string literals, which lie in the size bytes at from,
+	* at the same offsets in a copy of those bytes at to. Returns
+	* false, changing nothing, if any literal lies outside them.
+	**/
+	bool rebase(const char * from, size_t size, const char * to);
+
+	/** Rebuild the pointer tree in arena; null if inconsistent **/
+	ProgramNode * toTree(Arena& arena) const;
+	/**
+	* Check that every operand refers backwards to a node, list or
+	* string that exists, so walks terminate and stay in bounds
+	**/
+	bool valid() const;
+private:
+	friend class FlatBuilder;
+	friend class AstCache;
+
+	std::vector<AstRecord> myNodes;
+	//First item and item count of each list
+	std::vector<uint32_t> myLists;
+	std::vector<uint32_t> myItems;
+	std::vector<StringRef> myStrings;
+	uint32_t myRoot;
+};
+
+}
+
+#endif
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include "incremental.hpp"
+#include "errors.hpp"
+#include "fastscanner.hpp"
+#include "scanner.hpp"
+#include "visitor.hpp"
+
+namespace cshanty{
+
+/*
+Moving a reused subtree moves every node in it.
+*/
+void ASTNode::shift(int32_t delta){
+	myPos.shift(delta);
+	forEachChild(this, [delta](ASTNode * child){ child->shift(delta); });
+}
+
+IncrementalParser::IncrementalParser(CompilationContext& ctx, bool fastScan)
+: myCtx(ctx), myFastScan(fastScan), myText(nullptr), mySize(0),
+  myRetired(0), myRoot(nullptr), myReparsed(0){
+}
+
+std::unique_ptr<TokenSource> IncrementalParser::scanner(uint32_t start){
+	if (myFastScan){
+		return std::unique_ptr<TokenSource>(new FastScanner(myCtx, start));
+	}
+	return std::unique_ptr<TokenSource>(new Scanner(myCtx, start));
+}
+
+bool IncrementalParser::parse(const char * text, size_t size){
+	myCtx.reset();
+	char * copy = static_cast<char *>(myCtx.arena().alloc(size, 1));
+	memcpy(copy, text, size);
+	myText = copy;
+	mySize = size;
+	myRetired = 0;
+	myCtx.source().view(myText, mySize);
+	return parseAll();
+}
+
+bool IncrementalParser::parseAll(){
+	myRoot = nullptr;
+	myTokens.clear();
+	myCtx.lines().clear();
+	std::unique_ptr<TokenSource> source = scanner(0);
+	source->record(&myTokens);
+	try {
+		Parser parser(*source, &myRoot);
+		if (parser.parse() != 0){ myRoot = nullptr; }
+		source->drain();
+	} catch (AbortError * e){
+		myRoot = nullptr;
+	} catch (ToDoError * e){
+		Report::err() << "ToDo: " << e->msg() << std::endl;
+		myRoot = nullptr;
+	}
+	myReparsed = myRoot == nullptr ? 0 : myRoot->globals()->size();
+	return myRoot != nullptr;
+}
+
+bool IncrementalParser::edit(uint32_t start, uint32_t oldLen,
+	const char * text, size_t len){
+	if (start > mySize || oldLen > mySize - start){
+		throw new InternalError("Edit range outside of the text");
+	}
+	size_t size = mySize - oldLen + len;
+	char * next = static_cast<char *>(myCtx.arena().alloc(size, 1));
+	memcpy(next, myText, start);
+	memcpy(next + start, text, len);
+	memcpy(next + start + len, myText + start + oldLen,
+		mySize - start - oldLen);
+
+	myRetired += mySize;
+	if (myRetired > 4 * size){
+		std::string copy(next, size);
+		return parse(copy.data(), copy.size());
+	}
+	myText = next;
+	mySize = size;
+	myCtx.source().view(myText, mySize);
+
+	int32_t delta = static_cast<int32_t>(len) - static_cast<int32_t>(oldLen);
+	if (myRoot != nullptr && reparse(start, start + oldLen, delta)){
+		return true;
+	}
+	return parseAll();
+}
+
+/*
+The region that is relexed runs from the end of the last global
+wholly before the edit to the start of the first global wholly
+after it (edits that merely touch a declaration count as inside
+it). Both ends lie between tokens, so the scanner can start cold
+at the first, and the token scanned at the second must be the old
+one moved by delta; if it isn't, the edit changed how later text
+lexes (e.g. by opening a comment) and the caller starts over.
+
+Since every global ends in a SEMICOL or a CLOSE, a run of globals
+parses the same on its own as it does in place, so the region's
+tokens are parsed as a program of their own and its globals
+replace the affected ones. Diagnostics are held back until the
+region is known to be good; on failure the full reparse reports
+them instead.
+*/
+bool IncrementalParser::reparse(uint32_t editStart, uint32_t editEnd,
+	int32_t delta){
+	NodeList<DeclNode *> * globals = myRoot->globals();
+	std::vector<DeclNode *> decls(globals->begin(), globals->end());
+	size_t first = static_cast<size_t>(std::partition_point(
+		decls.begin(), decls.end(),
+		[editStart](DeclNode * d){ return d->pos().end() < editStart; })
+	  - decls.begin());
+	size_t after = static_cast<size_t>(std::partition_point(
+		decls.begin(), decls.end(),
+		[editEnd](DeclNode * d){ return d->pos().start() <= editEnd; })
+	  - decls.begin());
+
+	uint32_t regionStart = first > 0 ? decls[first - 1]->pos().end() : 0;
+	uint32_t regionEnd = after < decls.size()
+	  ? decls[after]->pos().start() : myTokens.back()->pos().start();
+	uint32_t newRegionEnd = regionEnd + static_cast<uint32_t>(delta);
+
+	auto byStart = [](Token * t, uint32_t offset){
+		return t->pos().start() < offset;
+	};
+	size_t oldFirst = static_cast<size_t>(std::lower_bound(myTokens.begin(),
+		myTokens.end(), regionStart, byStart) - myTokens.begin());
+	size_t oldSync = static_cast<size_t>(std::lower_bound(myTokens.begin(),
+		myTokens.end(), regionEnd, byStart) - myTokens.begin());
+	if (oldSync == myTokens.size()){ return false; }
+	Token * sync = myTokens[oldSync];
+
+	//Lines in the region are rescanned; those after it just move
+	LineTable& lines = myCtx.lines();
+	std::vector<uint32_t> tail;
+	for (size_t line = lines.line(regionEnd) + 1; line <= lines.lines(); line++){
+		tail.push_back(lines.start(line) + static_cast<uint32_t>(delta));
+	}
+	lines.truncate(regionStart);
+
+	std::ostream& err = Report::err();
+	std::ostream& out = Report::out();
+	std::ostringstream heldErr;
+	std::ostringstream heldOut;
+	Report::redirect(&heldErr, &heldOut);
+	std::vector<Token *> fresh;
+	ProgramNode * region = nullptr;
+	bool ok = false;
+	try {
+		std::unique_ptr<TokenSource> source = scanner(regionStart);
+		while (true){
+			cshanty::Parser::semantic_type lval;
+			source->yylex(&lval);
+			Token * token = lval.lexeme;
+			if (token->pos().start() >= newRegionEnd){
+				ok = token->kind() == sync->kind()
+				  && token->pos().start() == newRegionEnd;
+				break;
+			}
+			if (token->kind() == Parser::token::END){ break; }
+			fresh.push_back(token);
+		}
+		if (ok){
+			TokenRun run(myCtx, fresh, newRegionEnd);
+			Parser parser(run, &region);
+			ok = parser.parse() == 0 && region != nullptr;
+		}
+	} catch (AbortError * e){
+		ok = false;
+	} catch (ToDoError * e){
+		ok = false;
+	}
+	Report::redirect(&err, &out);
+	if (!ok){ return false; }
+	err << heldErr.str();
+	out << heldOut.str();
+
+	for (auto start : tail){ lines.addLine(start); }
+
+	//Splice the tokens, then the globals
+	std::vector<Token *> tokens;
+	tokens.reserve(oldFirst + fresh.size() + myTokens.size() - oldSync);
+	tokens.insert(tokens.end(), myTokens.begin(),
+		myTokens.begin() + static_cast<long>(oldFirst));
+	tokens.insert(tokens.end(), fresh.begin(), fresh.end());
+	for (size_t i = oldSync; i < myTokens.size(); i++){
+		if (delta != 0){ myTokens[i]->shift(delta); }
+		tokens.push_back(myTokens[i]);
+	}
+	myTokens.swap(tokens);
+
+	if (delta != 0){
+		for (size_t i = after; i < decls.size(); i++){ decls[i]->shift(delta); }
+	}
+	auto firstIt = std::next(globals->begin(), static_cast<long>(first));
+	auto afterIt = std::next(firstIt, static_cast<long>(after - first));
+	globals->erase(firstIt, afterIt);
+	NodeList<DeclNode *> * replacement = region->globals();
+	globals->insert(afterIt, replacement->begin(), replacement->end());
+	myRoot = new (myCtx.arena()) ProgramNode(globals);
+	myReparsed = replacement->size();
+	return true;
+}
+
+}
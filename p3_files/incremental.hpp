@@ -0,0 +1,68 @@
+#ifndef CSHANTY_INCREMENTAL_H
+#define CSHANTY_INCREMENTAL_H
+
+#include <memory>
+#include <vector>
+#include "ast.hpp"
+#include "context.hpp"
+#include "tokensource.hpp"
+
+namespace cshanty{
+
+/**
+* \class IncrementalParser
+* Keeps the text, tokens and AST of one file between edits, as an
+* editor makes them, and brings them up to date after each edit by
+* relexing and reparsing only the top-level declarations the edit
+* touches. The new declarations are spliced into the globals list;
+* those before the edit are reused untouched, and those after it
+* are reused once moved by the change in length. Whenever that isn't
+* safe (an error in the affected region, or a relex that doesn't
+* line back up with the old tokens) the whole file is reparsed.
+*
+* Every version of the text is kept in the context's arena, since
+* reused tokens and string literals point into the version they
+* were scanned from. They are released by a fresh parse(), which
+* edit() forces once the old versions outweigh the current one.
+**/
+class IncrementalParser{
+public:
+	/** fastScan: scan with FastScanner rather than the flex Scanner **/
+	IncrementalParser(CompilationContext& ctx, bool fastScan = false);
+
+	/** Parse text (copied) from scratch. False if it has errors **/
+	bool parse(const char * text, size_t size);
+	/**
+	* Replace oldLen bytes at offset start with len bytes of text.
+	* Returns false if the edited program has errors, which are
+	* reported just as a full parse would report them.
+	**/
+	bool edit(uint32_t start, uint32_t oldLen, const char * text, size_t len);
+
+	/** The current tree; null if the text doesn't parse **/
+	ProgramNode * root() const { return myRoot; }
+	/** The current tokens, ending with END **/
+	const std::vector<Token *>& tokens() const { return myTokens; }
+	const char * text() const { return myText; }
+	size_t size() const { return mySize; }
+	/** Declarations parsed by the last parse or edit **/
+	size_t reparsed() const { return myReparsed; }
+private:
+	std::unique_ptr<TokenSource> scanner(uint32_t start);
+	bool parseAll();
+	bool reparse(uint32_t editStart, uint32_t editEnd, int32_t delta);
+
+	CompilationContext& myCtx;
+	bool myFastScan;
+	const char * myText;
+	size_t mySize;
+	//Bytes of old versions still held in the arena
+	size_t myRetired;
+	std::vector<Token *> myTokens;
+	ProgramNode * myRoot;
+	size_t myReparsed;
+};
+
+}
+
+#endif
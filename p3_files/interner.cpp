@@ -0,0 +1,98 @@
+#include "interner.hpp"
+
+namespace cshanty{
+
+Interner& Interner::global(){
+	static Interner instance;
+	return instance;
+}
+
+Interner::Interner()
+: myConcurrent(false), myCount(0), myDirectory(nullptr),
+  myDirectorySize(0), myPoolCur(nullptr), myPoolLeft(0), myPoolBytes(0),
+  mySlots(1024, 0){
+	intern("", 0);
+}
+
+//FNV-1a
+uint32_t Interner::hash(const char * str, size_t len){
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++){
+		h ^= static_cast<unsigned char>(str[i]);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+Symbol Interner::insert(const char * str, size_t len){
+	uint32_t h = hash(str, len);
+	size_t mask = mySlots.size() - 1;
+	for (size_t i = h & mask; ; i = (i + 1) & mask){
+		uint32_t slot = mySlots[i];
+		if (slot == 0){
+			uint32_t id = myCount;
+			if ((id & (SEGMENT_SIZE - 1)) == 0){
+				if ((id >> SEGMENT_BITS) == myDirectorySize){ growDirectory(); }
+				mySegments.emplace_back(new Entry[SEGMENT_SIZE]);
+				myDirectory.load()[id >> SEGMENT_BITS] = mySegments.back().get();
+			}
+			Entry& e = mySegments.back()[id & (SEGMENT_SIZE - 1)];
+			e.str = store(str, len);
+			e.len = static_cast<uint32_t>(len);
+			e.hash = h;
+			myCount++;
+			mySlots[i] = id + 1;
+			if (size_t(myCount) * 2 > mySlots.size()){ grow(); }
+			return Symbol(id);
+		}
+		const Entry& e = entry(slot - 1);
+		if (e.hash == h && e.len == len && memcmp(e.str, str, len) == 0){
+			return Symbol(slot - 1);
+		}
+	}
+}
+
+const char * Interner::store(const char * str, size_t len){
+	size_t need = len + 1;
+	if (need > myPoolLeft){
+		size_t size = need > POOL_CHUNK ? need : POOL_CHUNK;
+		myPool.emplace_back(new char[size]);
+		myPoolCur = myPool.back().get();
+		myPoolLeft = size;
+	}
+	char * dst = myPoolCur;
+	memcpy(dst, str, len);
+	dst[len] = '\0';
+	myPoolCur += need;
+	myPoolLeft -= need;
+	myPoolBytes += need;
+	return dst;
+}
+
+/*
+Readers find entries without the lock, so the old directory is
+left in place (and alive) and the new one published whole.
+*/
+void Interner::growDirectory(){
+	size_t size = myDirectorySize == 0 ? FIRST_SEGMENTS : 2 * myDirectorySize;
+	if (size > MAX_SEGMENTS){ size = MAX_SEGMENTS; }
+	Entry ** directory = new Entry *[size]();
+	for (size_t i = 0; i < myDirectorySize; i++){
+		directory[i] = myDirectory.load()[i];
+	}
+	myDirectories.emplace_back(directory);
+	myDirectorySize = size;
+	myDirectory.store(directory, std::memory_order_release);
+}
+
+void Interner::grow(){
+	mySlots.assign(mySlots.size() * 2, 0);
+	size_t mask = mySlots.size() - 1;
+	for (uint32_t id = 0; id < myCount; id++){
+		size_t i = entry(id).hash & mask;
+		while (mySlots[i] != 0){ i = (i + 1) & mask; }
+		mySlots[i] = id + 1;
+	}
+}
+
+} //End namespace cshanty
@@ -0,0 +1,123 @@
+#ifndef CSHANTY_INTERNER_H
+#define CSHANTY_INTERNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cshanty{
+
+/**
+* \class Symbol
+* Handle to an interned identifier. Two Symbols are equal exactly
+* when they name the same string, so comparing identifiers is an
+* integer compare.
+**/
+class Symbol{
+public:
+	Symbol() : myId(0){ }
+	explicit Symbol(uint32_t id) : myId(id){ }
+	uint32_t id() const { return myId; }
+	bool operator==(Symbol other) const { return myId == other.myId; }
+	bool operator!=(Symbol other) const { return myId != other.myId; }
+	bool operator<(Symbol other) const { return myId < other.myId; }
+	/** The interned text (see Interner::str) **/
+	const char * str() const;
+	size_t length() const;
+private:
+	uint32_t myId;
+};
+
+/**
+* \class Interner
+* Maps each distinct identifier to a dense 32-bit id. The text of
+* every symbol is stored NUL-terminated in one shared character pool
+* and found through an open-addressing (linear probing) hash table.
+* Id 0 is reserved for the empty string.
+*
+* Neither the pool nor the per-symbol entries ever move once written,
+* so str() and length() need no locking. The directory of entry
+* segments starts small and is replaced by one twice the size when
+* it fills; a replaced directory is kept, since a reader may still be
+* looking through it. intern() takes a lock only once
+* setConcurrent(true) has been called (batch mode runs several
+* scanners at once).
+**/
+class Interner{
+public:
+	static Interner& global();
+
+	Interner();
+	Symbol intern(const char * str, size_t len){
+		if (!myConcurrent){ return insert(str, len); }
+		std::lock_guard<std::mutex> guard(myLock);
+		return insert(str, len);
+	}
+	Symbol intern(const char * str){ return intern(str, strlen(str)); }
+	Symbol intern(const std::string& str){
+		return intern(str.data(), str.size());
+	}
+
+	const char * str(Symbol sym) const { return entry(sym.id()).str; }
+	size_t length(Symbol sym) const { return entry(sym.id()).len; }
+	/** Number of distinct symbols, including the empty string **/
+	size_t size() const { return myCount; }
+	size_t poolBytes() const { return myPoolBytes; }
+
+	void setConcurrent(bool concurrent){ myConcurrent = concurrent; }
+private:
+	struct Entry{
+		const char * str;
+		uint32_t len;
+		uint32_t hash;
+	};
+	static const size_t SEGMENT_BITS = 12;
+	static const size_t SEGMENT_SIZE = size_t(1) << SEGMENT_BITS;
+	static const size_t MAX_SEGMENTS = size_t(1) << (32 - SEGMENT_BITS);
+	static const size_t FIRST_SEGMENTS = 16;
+	static const size_t POOL_CHUNK = 64 * 1024;
+
+	const Entry& entry(uint32_t id) const {
+		Entry * const * directory = myDirectory.load(std::memory_order_acquire);
+		return directory[id >> SEGMENT_BITS][id & (SEGMENT_SIZE - 1)];
+	}
+	Symbol insert(const char * str, size_t len);
+	const char * store(const char * str, size_t len);
+	static uint32_t hash(const char * str, size_t len);
+	void grow();
+	void growDirectory();
+
+	bool myConcurrent;
+	std::mutex myLock;
+	uint32_t myCount;
+	//Entries live in fixed-size segments so they never move
+	std::vector<std::unique_ptr<Entry[]>> mySegments;
+	//Segment pointers by id >> SEGMENT_BITS, and every directory
+	// there has been (the last is the current one)
+	std::atomic<Entry **> myDirectory;
+	size_t myDirectorySize;
+	std::vector<std::unique_ptr<Entry *[]>> myDirectories;
+	//The character pool, handed out a chunk at a time
+	std::vector<std::unique_ptr<char[]>> myPool;
+	char * myPoolCur;
+	size_t myPoolLeft;
+	size_t myPoolBytes;
+	//Symbol id + 1 per slot, 0 for empty. Size is a power of 2
+	std::vector<uint32_t> mySlots;
+};
+
+inline const char * Symbol::str() const {
+	return Interner::global().str(*this);
+}
+
+inline size_t Symbol::length() const {
+	return Interner::global().length(*this);
+}
+
+} //End namespace cshanty
+
+#endif
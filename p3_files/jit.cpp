@@ -0,0 +1,862 @@
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "jit.hpp"
+#include "errors.hpp"
+#include "layout.hpp"
+#include "vm.hpp"
+
+namespace cshanty{
+
+//Most of the stack the generated code may use
+static const size_t MAX_STACK = size_t(64) << 20;
+
+/*
+Register numbers as the instruction encoding has them;
+RIP stands for a global, addressed relative to the
+instruction
+*/
+enum Reg : uint8_t {
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, RIP = 0xFF
+};
+
+static const Reg ARG_REGS[] = { RDI, RSI, RDX, RCX, R8, R9 };
+static const size_t REG_ARGS = 6;
+
+//Condition codes, as jcc and setcc encode them. Each
+// one's negation differs from it in the low bit alone
+enum Cond : uint8_t {
+	CC_B = 0x2, CC_E = 0x4, CC_NE = 0x5,
+	CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+};
+
+static Cond condition(NodeKind kind, bool negate){
+	Cond cond;
+	switch (kind){
+	case KIND_EQUALS: cond = CC_E; break;
+	case KIND_NOT_EQUALS: cond = CC_NE; break;
+	case KIND_LESS: cond = CC_L; break;
+	case KIND_LESS_EQ: cond = CC_LE; break;
+	case KIND_GREATER: cond = CC_G; break;
+	default: cond = CC_GE; break;
+	}
+	return negate ? static_cast<Cond>(cond ^ 1) : cond;
+}
+
+static bool isCompare(NodeKind kind){
+	return kind == KIND_EQUALS || kind == KIND_NOT_EQUALS
+	  || kind == KIND_LESS || kind == KIND_LESS_EQ
+	  || kind == KIND_GREATER || kind == KIND_GREATER_EQ;
+}
+
+template <typename F>
+static uint64_t address(F * fn){
+	return reinterpret_cast<uintptr_t>(fn);
+}
+
+/** A memory operand: disp bytes off a base register, or into the globals **/
+struct Mem{
+	Reg base;
+	int32_t disp;
+};
+
+/**
+* \class JitGen
+* Compiles a program into one buffer of machine code, in the same
+* single walk as AsmGen (asmgen.cpp) makes, but encoding each
+* instruction itself. Jumps within a function are patched when it
+* ends, and calls once every function's address is known.
+**/
+class JitGen{
+public:
+	JitGen(Jit& jit, Stats * stats) : myJit(jit), myStats(stats),
+	  myLayout(jit.myTypes), myCodeStart(0), myMain(0),
+	  myFrame(0), myFrameMax(0), myDepth(0), myReturn(0){ }
+
+	const std::vector<uint8_t>& code() const { return myCode; }
+	/** Offset of the code from the start of the globals **/
+	size_t codeStart() const { return myCodeStart; }
+	size_t mainOffset() const { return myMain; }
+
+	void program(const ProgramNode * root){
+		TypeTable& types = myJit.myTypes;
+		//The stack limit, then every global
+		int32_t globals = 8;
+		for (const DeclNode * decl : *root->globals()){
+			if (decl->kind() != KIND_VAR_DECL){ continue; }
+			myGlobals[decl] = globals;
+			globals += 8 * static_cast<int32_t>(myLayout.slots(types.of(decl)));
+		}
+		size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		myCodeStart = (static_cast<size_t>(globals) + page - 1) / page * page;
+
+		Symbol mainName = Interner::global().intern("main");
+		const FnDeclNode * main = nullptr;
+		for (const DeclNode * decl : *root->globals()){
+			if (decl->kind() != KIND_FN_DECL){ continue; }
+			const FnDeclNode * fn = static_cast<const FnDeclNode *>(decl);
+			if (fn->id()->getName() == mainName){ main = fn; }
+			compile(fn);
+		}
+		if (main == nullptr){ error(root, "No main function"); }
+		if (main->formals() != nullptr){
+			error(main->id(), "main takes no arguments");
+		}
+		myMain = myFunctions[main];
+		for (const auto& call : myCalls){
+			patch(call.first, myFunctions[call.second]);
+		}
+	}
+private:
+	struct SlowPath{
+		uint32_t label;
+		const char * msg;
+		uint32_t offset;
+	};
+
+	[[noreturn]] void error(const ASTNode * node, const char * msg){
+		size_t start = node->pos().start();
+		Report::fatal(myJit.myLines.line(start), myJit.myLines.col(start), msg);
+		throw new AbortError(1);
+	}
+
+	void compile(const FnDeclNode * fn){
+		std::chrono::steady_clock::time_point start;
+		if (myStats != nullptr){ start = std::chrono::steady_clock::now(); }
+		size_t from = here();
+		function(fn);
+		if (myStats == nullptr){ return; }
+		std::chrono::duration<double, std::milli> took =
+			std::chrono::steady_clock::now() - start;
+		Symbol name = fn->id()->getName();
+		myStats->addJitFunction(std::string(name.str(), name.length()),
+			took.count(), here() - from);
+	}
+
+	//Encoding
+
+	size_t here() const { return myCode.size(); }
+
+	void byte(uint8_t b){ myCode.push_back(b); }
+
+	void bytes(std::initializer_list<uint8_t> list){
+		myCode.insert(myCode.end(), list);
+	}
+
+	void dword(uint32_t value){
+		for (int i = 0; i < 32; i += 8){ byte(static_cast<uint8_t>(value >> i)); }
+	}
+
+	void qword(uint64_t value){
+		for (int i = 0; i < 64; i += 8){ byte(static_cast<uint8_t>(value >> i)); }
+	}
+
+	/* Point the rel32 at at to target */
+	void patch(size_t at, size_t target){
+		uint32_t rel = static_cast<uint32_t>(static_cast<int64_t>(target)
+			- static_cast<int64_t>(at + 4));
+		for (size_t i = 0; i < 4; i++){
+			myCode[at + i] = static_cast<uint8_t>(rel >> (8 * i));
+		}
+	}
+
+	void rex(bool wide, unsigned reg, unsigned base){
+		uint8_t bits = static_cast<uint8_t>((wide ? 8 : 0)
+		  | (reg >= 8 ? 4 : 0) | (base >= 8 && base != RIP ? 1 : 0));
+		if (bits != 0){ byte(0x40 | bits); }
+	}
+
+	/*
+	The ModRM byte, SIB byte and displacement for reg and m;
+	a rip-relative displacement counts from the end of the
+	instruction, after its imm bytes of immediate
+	*/
+	void modrm(unsigned reg, const Mem& m, size_t imm){
+		uint8_t r = static_cast<uint8_t>((reg & 7) << 3);
+		if (m.base == RIP){
+			byte(0x05 | r);
+			int64_t next = static_cast<int64_t>(myCodeStart + here() + 4 + imm);
+			dword(static_cast<uint32_t>(m.disp - next));
+			return;
+		}
+		bool small = m.disp >= -128 && m.disp <= 127;
+		byte(static_cast<uint8_t>((small ? 0x40 : 0x80) | r | (m.base & 7)));
+		if ((m.base & 7) == RSP){ byte(0x24); }
+		if (small){
+			byte(static_cast<uint8_t>(m.disp));
+		} else {
+			dword(static_cast<uint32_t>(m.disp));
+		}
+	}
+
+	void op(uint8_t opcode, unsigned reg, const Mem& m, bool wide,
+		size_t imm = 0){
+		rex(wide, reg, m.base);
+		byte(opcode);
+		modrm(reg, m, imm);
+	}
+
+	/* A register to register instruction, 64 bits wide */
+	void opRR(uint8_t opcode, unsigned reg, unsigned rm){
+		rex(true, reg, rm);
+		byte(opcode);
+		byte(static_cast<uint8_t>(0xC0 | (reg & 7) << 3 | (rm & 7)));
+	}
+
+	void load(Reg reg, const Mem& m){ op(0x8B, reg, m, true); }
+	void store(const Mem& m, Reg reg){ op(0x89, reg, m, true); }
+	void lea(Reg reg, const Mem& m){ op(0x8D, reg, m, true); }
+	void move(Reg dst, Reg src){ opRR(0x89, src, dst); }
+
+	void storeImm(const Mem& m, int32_t value){
+		op(0xC7, 0, m, true, 4);
+		dword(static_cast<uint32_t>(value));
+	}
+
+	/* A 32-bit immediate, zero-extended */
+	void moveImm(Reg reg, int32_t value){
+		rex(false, 0, reg);
+		byte(static_cast<uint8_t>(0xB8 + (reg & 7)));
+		dword(static_cast<uint32_t>(value));
+	}
+
+	void moveAbs(Reg reg, uint64_t value){
+		rex(true, 0, reg);
+		byte(static_cast<uint8_t>(0xB8 + (reg & 7)));
+		qword(value);
+	}
+
+	/* add or sub (ext 0 or 5) of a byte to the int in m */
+	void addMem(uint8_t ext, const Mem& m){
+		op(0x83, ext, m, false, 1);
+		byte(1);
+	}
+
+	/* add or sub rsp, imm32 */
+	void adjustStack(int32_t amount){
+		if (amount == 0){ return; }
+		bytes({0x48, 0x81, static_cast<uint8_t>(amount < 0 ? 0xEC : 0xC4)});
+		dword(static_cast<uint32_t>(amount < 0 ? -amount : amount));
+	}
+
+	//Labels
+
+	uint32_t label(){
+		myLabels.push_back(SIZE_MAX);
+		return static_cast<uint32_t>(myLabels.size() - 1);
+	}
+
+	void place(uint32_t label){ myLabels[label] = here(); }
+
+	void jump(uint32_t label){
+		byte(0xE9);
+		myJumps.emplace_back(here(), label);
+		dword(0);
+	}
+
+	void jump(Cond cond, uint32_t label){
+		bytes({0x0F, static_cast<uint8_t>(0x80 | cond)});
+		myJumps.emplace_back(here(), label);
+		dword(0);
+	}
+
+	/* Jump to a runtime error for the source at node */
+	void jumpSlow(Cond cond, const char * msg, const ASTNode * node){
+		uint32_t slow = label();
+		mySlow.push_back(SlowPath{slow, msg,
+			static_cast<uint32_t>(node->pos().start())});
+		jump(cond, slow);
+	}
+
+	void push(){
+		byte(0x50);
+		myDepth++;
+	}
+
+	void pop(Reg reg){
+		rex(false, 0, reg);
+		byte(static_cast<uint8_t>(0x58 + (reg & 7)));
+		myDepth--;
+	}
+
+	/* Call a Jit entry point, with the stack aligned */
+	template <typename F>
+	void runtime(F * helper){
+		bool pad = myDepth % 2 != 0;
+		if (pad){ adjustStack(-8); }
+		moveAbs(RAX, address(helper));
+		bytes({0xFF, 0xD0});
+		if (pad){ adjustStack(8); }
+	}
+
+	void self(){ moveAbs(RDI, address(&myJit)); }
+
+	//Layout
+
+	int32_t alloc(uint32_t count){
+		myFrame += 8 * static_cast<int32_t>(count);
+		if (myFrame > myFrameMax){ myFrameMax = myFrame; }
+		return -myFrame;
+	}
+
+	Mem location(const DeclNode * decl){
+		auto local = myLocals.find(decl);
+		if (local != myLocals.end()){ return Mem{RBP, local->second}; }
+		return Mem{RIP, myGlobals[decl]};
+	}
+
+	Mem lval(const ExpNode * node){
+		if (node->kind() == KIND_ID){
+			return location(static_cast<const IDNode *>(node)->decl());
+		}
+		const IndexNode * index = static_cast<const IndexNode *>(node);
+		Mem m = location(index->recordId()->decl());
+		m.disp += 8 * static_cast<int32_t>(myLayout.field(index));
+		return m;
+	}
+
+	/* Copy count slots of record from the address in rax to m */
+	void copy(const Mem& m, uint32_t count){
+		move(RSI, RAX);
+		lea(RDI, m);
+		moveImm(RCX, static_cast<int32_t>(count));
+		//rep movsq
+		bytes({0xF3, 0x48, 0xA5});
+	}
+
+	//Functions and statements
+
+	void function(const FnDeclNode * fn){
+		TypeTable& types = myJit.myTypes;
+		const DataType * type = types.of(fn);
+		if (type->ret()->kind() == DataType::RECORD){
+			error(fn->type(), "Records can't be returned");
+		}
+		myFunctions[fn] = here();
+		myLocals.clear();
+		myLabels.clear();
+		myJumps.clear();
+		mySlow.clear();
+		myFrame = 0;
+		myFrameMax = 0;
+		myDepth = 0;
+		myReturn = label();
+		//push rbp; mov rbp, rsp; sub rsp, frame
+		bytes({0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC});
+		size_t frameSize = here();
+		dword(0);
+
+		std::vector<std::pair<const FormalDeclNode *, int32_t>> records;
+		if (fn->formals() != nullptr){
+			size_t i = 0;
+			for (const FormalDeclNode * formal : *fn->formals()){
+				int32_t offset;
+				if (i < REG_ARGS){
+					offset = alloc(1);
+					store(Mem{RBP, offset}, ARG_REGS[i]);
+				} else {
+					offset = 16 + 8 * static_cast<int32_t>(i - REG_ARGS);
+				}
+				if (types.of(formal)->kind() == DataType::RECORD){
+					records.emplace_back(formal, offset);
+				} else {
+					myLocals[formal] = offset;
+				}
+				i++;
+			}
+		}
+		for (const auto& record : records){
+			uint32_t count = myLayout.slots(types.of(record.first));
+			int32_t base = alloc(count);
+			load(RAX, Mem{RBP, record.second});
+			myLocals[record.first] = base;
+			copy(Mem{RBP, base}, count);
+		}
+
+		stmts(fn->body());
+		if (type->ret() != types.voidType()){
+			//Falling off the end returns 0: xor eax, eax
+			bytes({0x31, 0xC0});
+		}
+		place(myReturn);
+		//leave; ret
+		bytes({0xC9, 0xC3});
+
+		//Runtime errors, out of the way of the code that raises them
+		for (const SlowPath& slow : mySlow){
+			place(slow.label);
+			self();
+			moveAbs(RSI, address(slow.msg));
+			moveImm(RDX, static_cast<int32_t>(slow.offset));
+			//and rsp, -16
+			bytes({0x48, 0x83, 0xE4, 0xF0});
+			moveAbs(RAX, address(&Jit::fail));
+			bytes({0xFF, 0xD0});
+		}
+		for (const auto& jump : myJumps){ patch(jump.first, myLabels[jump.second]); }
+		uint32_t frame = static_cast<uint32_t>((myFrameMax + 15) / 16 * 16);
+		for (size_t i = 0; i < 4; i++){
+			myCode[frameSize + i] = static_cast<uint8_t>(frame >> (8 * i));
+		}
+	}
+
+	void stmts(const NodeList<StmtNode *> * list){
+		for (const StmtNode * stmt : *list){ this->stmt(stmt); }
+	}
+
+	void block(const NodeList<StmtNode *> * list){
+		int32_t mark = myFrame;
+		stmts(list);
+		myFrame = mark;
+	}
+
+	void stmt(const StmtNode * stmt){
+		TypeTable& types = myJit.myTypes;
+		switch (stmt->kind()){
+		case KIND_VAR_DECL: {
+			const VarDeclNode * decl = static_cast<const VarDeclNode *>(stmt);
+			uint32_t count = myLayout.slots(types.of(decl));
+			int32_t base = alloc(count);
+			myLocals[decl] = base;
+			for (uint32_t i = 0; i < count; i++){
+				storeImm(Mem{RBP, base + 8 * static_cast<int32_t>(i)}, 0);
+			}
+			break;
+		}
+		case KIND_ASSIGN_STMT:
+			assign(static_cast<const AssignStmtNode *>(stmt)->assign());
+			break;
+		case KIND_CALL_STMT:
+			call(static_cast<const CallStmtNode *>(stmt)->call());
+			break;
+		case KIND_POST_INC_STMT:
+			addMem(0, lval(static_cast<const PostIncStmtNode *>(stmt)->lval()));
+			break;
+		case KIND_POST_DEC_STMT:
+			addMem(5, lval(static_cast<const PostDecStmtNode *>(stmt)->lval()));
+			break;
+		case KIND_RECEIVE_STMT: {
+			const LValNode * target =
+				static_cast<const ReceiveStmtNode *>(stmt)->lval();
+			const DataType * type = myLayout.typeOf(target);
+			self();
+			moveImm(RSI, static_cast<int32_t>(target->pos().start()));
+			if (type == types.intType()){
+				runtime(&Jit::receiveInt);
+			} else if (type == types.boolType()){
+				runtime(&Jit::receiveBool);
+			} else {
+				runtime(&Jit::receiveString);
+			}
+			store(lval(target), RAX);
+			break;
+		}
+		case KIND_REPORT_STMT: {
+			const ExpNode * exp = static_cast<const ReportStmtNode *>(stmt)->exp();
+			const DataType * type = myLayout.typeOf(exp);
+			gen(exp);
+			move(RSI, RAX);
+			self();
+			if (type == types.intType()){
+				runtime(&Jit::reportInt);
+			} else if (type == types.boolType()){
+				runtime(&Jit::reportBool);
+			} else {
+				runtime(&Jit::reportString);
+			}
+			break;
+		}
+		case KIND_IF_STMT: {
+			const IfStmtNode * node = static_cast<const IfStmtNode *>(stmt);
+			uint32_t skip = label();
+			branch(node->cond(), false, skip);
+			block(node->body());
+			place(skip);
+			break;
+		}
+		case KIND_IF_ELSE_STMT: {
+			const IfElseStmtNode * node =
+				static_cast<const IfElseStmtNode *>(stmt);
+			uint32_t otherwise = label();
+			uint32_t end = label();
+			branch(node->cond(), false, otherwise);
+			block(node->thenBranch());
+			jump(end);
+			place(otherwise);
+			block(node->elseBranch());
+			place(end);
+			break;
+		}
+		case KIND_WHILE_STMT: {
+			const WhileStmtNode * node = static_cast<const WhileStmtNode *>(stmt);
+			uint32_t body = label();
+			uint32_t test = label();
+			jump(test);
+			place(body);
+			block(node->body());
+			place(test);
+			branch(node->cond(), true, body);
+			break;
+		}
+		case KIND_RETURN_STMT: {
+			const ExpNode * exp = static_cast<const ReturnStmtNode *>(stmt)->exp();
+			if (exp != nullptr){ gen(exp); }
+			jump(myReturn);
+			break;
+		}
+		default:
+			error(stmt, "Unexpected declaration");
+		}
+	}
+
+	//Expressions
+
+	void gen(const ExpNode * exp){
+		switch (exp->kind()){
+		case KIND_INT_LIT:
+			moveImm(RAX, static_cast<const IntLitNode *>(exp)->value());
+			break;
+		case KIND_STR_LIT:
+			myJit.myStrings.push_back(
+				static_cast<const StrLitNode *>(exp)->text());
+			moveAbs(RAX, address(myJit.myStrings.back().c_str()));
+			break;
+		case KIND_TRUE:
+			moveImm(RAX, 1);
+			break;
+		case KIND_FALSE:
+			moveImm(RAX, 0);
+			break;
+		case KIND_ID:
+		case KIND_INDEX:
+			if (myLayout.typeOf(exp)->kind() == DataType::RECORD){
+				lea(RAX, lval(exp));
+			} else {
+				load(RAX, lval(exp));
+			}
+			break;
+		case KIND_ASSIGN_EXP:
+			assign(static_cast<const AssignExpNode *>(exp));
+			break;
+		case KIND_CALL_EXP:
+			call(static_cast<const CallExpNode *>(exp));
+			break;
+		case KIND_NEG:
+			gen(static_cast<const NegNode *>(exp)->exp());
+			//neg eax
+			bytes({0xF7, 0xD8});
+			break;
+		case KIND_NOT:
+			gen(static_cast<const NotNode *>(exp)->exp());
+			//xor eax, 1
+			bytes({0x83, 0xF0, 0x01});
+			break;
+		case KIND_AND:
+		case KIND_OR: {
+			uint32_t isFalse = label();
+			uint32_t end = label();
+			branch(exp, false, isFalse);
+			moveImm(RAX, 1);
+			jump(end);
+			place(isFalse);
+			moveImm(RAX, 0);
+			place(end);
+			break;
+		}
+		default:
+			binary(static_cast<const BinaryExpNode *>(exp));
+			break;
+		}
+	}
+
+	void assign(const AssignExpNode * node){
+		Mem m = lval(node->lval());
+		const DataType * type = myLayout.typeOf(node->lval());
+		gen(node->exp());
+		if (type->kind() == DataType::RECORD){
+			copy(m, myLayout.slots(type));
+			lea(RAX, m);
+			return;
+		}
+		store(m, RAX);
+	}
+
+	void operands(const BinaryExpNode * exp){
+		const ExpNode * rhs = exp->rhs();
+		gen(exp->lhs());
+		if (rhs->kind() == KIND_INT_LIT){
+			moveImm(RCX, static_cast<const IntLitNode *>(rhs)->value());
+			return;
+		}
+		push();
+		gen(rhs);
+		move(RCX, RAX);
+		pop(RAX);
+	}
+
+	void binary(const BinaryExpNode * exp){
+		NodeKind kind = exp->kind();
+		bool strings = myLayout.typeOf(exp->lhs()) == myJit.myTypes.stringType();
+		operands(exp);
+		switch (kind){
+		//add, sub or imul eax, ecx
+		case KIND_PLUS: bytes({0x01, 0xC8}); return;
+		case KIND_MINUS: bytes({0x29, 0xC8}); return;
+		case KIND_TIMES: bytes({0x0F, 0xAF, 0xC1}); return;
+		case KIND_DIVIDE: divide(exp); return;
+		default: break;
+		}
+		if (strings){
+			move(RDI, RAX);
+			move(RSI, RCX);
+			runtime(&Jit::stringsEqual);
+			if (kind == KIND_NOT_EQUALS){ bytes({0x83, 0xF0, 0x01}); }
+			return;
+		}
+		//cmp eax, ecx; setcc al; movzx eax, al
+		bytes({0x39, 0xC8, 0x0F,
+			static_cast<uint8_t>(0x90 | condition(kind, false)), 0xC0,
+			0x0F, 0xB6, 0xC0});
+	}
+
+	/* As in AsmGen::divide, INT_MIN / -1 is a negation */
+	void divide(const BinaryExpNode * exp){
+		uint32_t divide = label();
+		uint32_t end = label();
+		//test ecx, ecx
+		bytes({0x85, 0xC9});
+		jumpSlow(CC_E, "Division by zero", exp);
+		//cmp ecx, -1
+		bytes({0x83, 0xF9, 0xFF});
+		jump(CC_NE, divide);
+		bytes({0xF7, 0xD8});
+		jump(end);
+		place(divide);
+		//cdq; idiv ecx
+		bytes({0x99, 0xF7, 0xF9});
+		place(end);
+	}
+
+	void call(const CallExpNode * node){
+		size_t argc = 0;
+		if (node->args() != nullptr){
+			for (const ExpNode * arg : *node->args()){
+				gen(arg);
+				push();
+				argc++;
+			}
+		}
+		size_t onStack = argc > REG_ARGS ? argc - REG_ARGS : 0;
+		size_t pad = (myDepth + onStack) % 2;
+		if (pad != 0){
+			adjustStack(-8);
+			myDepth++;
+		}
+		for (size_t i = argc, pushed = 0; i > REG_ARGS; i--, pushed++){
+			//push qword [rsp + disp]
+			op(0xFF, 6, Mem{RSP,
+				static_cast<int32_t>(8 * (argc - i + pad + pushed))}, false);
+			myDepth++;
+		}
+		for (size_t i = 0; i < argc && i < REG_ARGS; i++){
+			load(ARG_REGS[i], Mem{RSP,
+				static_cast<int32_t>(8 * (argc - 1 - i + pad + onStack))});
+		}
+		//cmp rsp, [stack limit]
+		op(0x3B, RSP, Mem{RIP, 0}, true);
+		jumpSlow(CC_B, "Stack overflow", node);
+		byte(0xE8);
+		myCalls.emplace_back(here(), node->callee()->decl());
+		dword(0);
+		size_t drop = argc + pad + onStack;
+		adjustStack(8 * static_cast<int32_t>(drop));
+		myDepth -= static_cast<uint32_t>(drop);
+	}
+
+	/* As in AsmGen::branch */
+	void branch(const ExpNode * cond, bool when, uint32_t target){
+		NodeKind kind = cond->kind();
+		if (kind == KIND_TRUE || kind == KIND_FALSE){
+			if ((kind == KIND_TRUE) == when){ jump(target); }
+			return;
+		}
+		if (kind == KIND_NOT){
+			branch(static_cast<const NotNode *>(cond)->exp(), !when, target);
+			return;
+		}
+		if (kind == KIND_AND || kind == KIND_OR){
+			const BinaryExpNode * exp = static_cast<const BinaryExpNode *>(cond);
+			if ((kind == KIND_AND) != when){
+				branch(exp->lhs(), when, target);
+				branch(exp->rhs(), when, target);
+			} else {
+				uint32_t skip = label();
+				branch(exp->lhs(), !when, skip);
+				branch(exp->rhs(), when, target);
+				place(skip);
+			}
+			return;
+		}
+		if (isCompare(kind)){
+			const BinaryExpNode * exp = static_cast<const BinaryExpNode *>(cond);
+			if (myLayout.typeOf(exp->lhs()) != myJit.myTypes.stringType()){
+				operands(exp);
+				bytes({0x39, 0xC8});
+				jump(condition(kind, !when), target);
+				return;
+			}
+		}
+		gen(cond);
+		//test eax, eax
+		bytes({0x85, 0xC0});
+		jump(when ? CC_NE : CC_E, target);
+	}
+
+	Jit& myJit;
+	Stats * myStats;
+	Layout myLayout;
+	std::vector<uint8_t> myCode;
+	size_t myCodeStart;
+	size_t myMain;
+	//Offsets of globals from the start of the region
+	std::unordered_map<const DeclNode *, int32_t> myGlobals;
+	std::unordered_map<const DeclNode *, int32_t> myLocals;
+	std::unordered_map<const DeclNode *, size_t> myFunctions;
+	//rel32s to patch with a function's address
+	std::vector<std::pair<size_t, const DeclNode *>> myCalls;
+	//The current function's labels, jumps and runtime errors
+	std::vector<size_t> myLabels;
+	std::vector<std::pair<size_t, uint32_t>> myJumps;
+	std::vector<SlowPath> mySlow;
+	int32_t myFrame;
+	int32_t myFrameMax;
+	uint32_t myDepth;
+	uint32_t myReturn;
+};
+
+Jit::Jit(const LineTable& lines, TypeTable& types, Writer& out,
+	std::istream& in)
+: myLines(lines), myTypes(types), myOut(out), myIn(in),
+  myRegion(nullptr), myRegionSize(0), myCodeStart(0), myCodeSize(0),
+  myMain(0){ }
+
+Jit::~Jit(){
+	if (myRegion != nullptr){ munmap(myRegion, myRegionSize); }
+}
+
+/*
+Nothing is ever writable and executable at once: the code
+is copied in, then its pages are switched to read and
+execute
+*/
+void Jit::compile(const ProgramNode * root, Stats * stats){
+	JitGen gen(*this, stats);
+	gen.program(root);
+	const std::vector<uint8_t>& code = gen.code();
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	myCodeStart = gen.codeStart();
+	myCodeSize = code.size();
+	myMain = gen.mainOffset();
+	myRegionSize = myCodeStart + (myCodeSize + page - 1) / page * page;
+	void * region = mmap(nullptr, myRegionSize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED){
+		myRegionSize = 0;
+		throw new InternalError("Can't map memory for compiled code");
+	}
+	myRegion = static_cast<uint8_t *>(region);
+	memcpy(myRegion + myCodeStart, code.data(), myCodeSize);
+	if (mprotect(myRegion + myCodeStart, myRegionSize - myCodeStart,
+	  PROT_READ | PROT_EXEC) != 0){
+		throw new InternalError("Can't make compiled code executable");
+	}
+}
+
+/*
+The generated code checks the stack before each call, against
+a limit well short of the most the process may use; runtime
+errors come back here by longjmp, past only generated frames
+*/
+void Jit::run(){
+	size_t budget = MAX_STACK;
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+	  && limit.rlim_cur < budget){
+		budget = limit.rlim_cur;
+	}
+	uint8_t mark = 0;
+	uint64_t floor = reinterpret_cast<uintptr_t>(&mark) - budget / 4 * 3;
+	memcpy(myRegion, &floor, sizeof(floor));
+
+	void (*entry)() = reinterpret_cast<void (*)()>(
+		reinterpret_cast<uintptr_t>(myRegion + myCodeStart + myMain));
+	if (setjmp(myEscape) != 0){ throw new AbortError(1); }
+	entry();
+	myOut.flush();
+}
+
+void Jit::fail(Jit * jit, const char * msg, uint32_t offset){
+	jit->myOut.flush();
+	Report::fatal(jit->myLines.line(offset), jit->myLines.col(offset),
+		std::string("Runtime error: ") + msg);
+	std::longjmp(jit->myEscape, 1);
+}
+
+void Jit::reportInt(Jit * jit, int32_t value){
+	jit->myOut << value;
+}
+
+void Jit::reportBool(Jit * jit, int32_t value){
+	jit->myOut << (value ? "true" : "false");
+}
+
+void Jit::reportString(Jit * jit, const char * value){
+	jit->myOut << value;
+}
+
+/*
+As in the VM; every local whose destructor matters is
+gone before fail() is called
+*/
+int32_t Jit::receiveInt(Jit * jit, uint32_t offset){
+	jit->myOut.flush();
+	std::string& word = jit->myWord;
+	int32_t value = 0;
+	word.clear();
+	jit->myIn >> word;
+	if (!parseInputInt(word, value)){
+		fail(jit, "Expected an int on input", offset);
+	}
+	return value;
+}
+
+int32_t Jit::receiveBool(Jit * jit, uint32_t offset){
+	jit->myOut.flush();
+	std::string& word = jit->myWord;
+	word.clear();
+	jit->myIn >> word;
+	if (word == "true" || word == "1"){ return 1; }
+	if (word == "false" || word == "0"){ return 0; }
+	fail(jit, "Expected true or false on input", offset);
+}
+
+const char * Jit::receiveString(Jit * jit, uint32_t offset){
+	jit->myOut.flush();
+	std::string& word = jit->myWord;
+	if (!(jit->myIn >> word)){
+		fail(jit, "Expected a string on input", offset);
+	}
+	jit->myStrings.push_back(word);
+	return jit->myStrings.back().c_str();
+}
+
+int32_t Jit::stringsEqual(const char * lhs, const char * rhs){
+	return lhs == rhs || strcmp(lhs, rhs) == 0;
+}
+
+}
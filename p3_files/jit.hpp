@@ -0,0 +1,87 @@
+#ifndef CSHANTY_JIT_H
+#define CSHANTY_JIT_H
+
+#include <csetjmp>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <string>
+#include "ast.hpp"
+#include "position.hpp"
+#include "stats.hpp"
+#include "types.hpp"
+#include "writer.hpp"
+
+namespace cshanty{
+
+/**
+* \class Jit
+* Runs a checked program as x86-64 machine code (-jit), compiled in
+* process with no assembler or linker. Each function is translated
+* straight from its tree by a baseline generator much like the one
+* behind -o (asmgen.hpp): values in 8-byte slots, expressions through
+* rax and the stack, the System V calling convention. The code goes
+* in an mmap'd buffer that is made executable, but never writable,
+* once every function is compiled; globals sit on writable pages just
+* below it, within reach of rip-relative addressing.
+*
+* report and receive call back into the Jit, so output and input are
+* exactly those of -run (vm.hpp): report writes to out, and receive
+* reads whitespace-separated words from in. A division by zero, a
+* stack overflow or bad input is a runtime error, reported at the
+* position of its source in lines before the run is abandoned with
+* an AbortError. A program without a main() taking no arguments, or
+* with a function returning a record, is a fatal error at compile().
+**/
+class Jit{
+public:
+	Jit(const LineTable& lines, TypeTable& types, Writer& out,
+		std::istream& in);
+	~Jit();
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+
+	/**
+	* Compile every function under root; with stats, the time each
+	* function took to compile and its size in bytes are recorded
+	**/
+	void compile(const ProgramNode * root, Stats * stats);
+	/** Run the compiled main function **/
+	void run();
+
+	/** Bytes of machine code compiled **/
+	size_t codeSize() const { return myCodeSize; }
+private:
+	friend class JitGen;
+
+	//Entry points for the generated code
+	[[noreturn]] static void fail(Jit * jit, const char * msg,
+		uint32_t offset);
+	static void reportInt(Jit * jit, int32_t value);
+	static void reportBool(Jit * jit, int32_t value);
+	static void reportString(Jit * jit, const char * value);
+	static int32_t receiveInt(Jit * jit, uint32_t offset);
+	static int32_t receiveBool(Jit * jit, uint32_t offset);
+	static const char * receiveString(Jit * jit, uint32_t offset);
+	static int32_t stringsEqual(const char * lhs, const char * rhs);
+
+	const LineTable& myLines;
+	TypeTable& myTypes;
+	Writer& myOut;
+	std::istream& myIn;
+	//The globals' pages, then the code's
+	uint8_t * myRegion;
+	size_t myRegionSize;
+	size_t myCodeStart;
+	size_t myCodeSize;
+	//Offset of main() in the code
+	size_t myMain;
+	//The literals, then every string received, at stable addresses
+	std::deque<std::string> myStrings;
+	std::string myWord;
+	std::jmp_buf myEscape;
+};
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+#include "layout.hpp"
+
+namespace cshanty{
+
+uint32_t Layout::slots(const DataType * type){
+	if (type->kind() != DataType::RECORD){ return 1; }
+	const RecordTypeDeclNode * record = type->record();
+	auto found = myRecordSlots.find(record);
+	if (found != myRecordSlots.end()){ return found->second; }
+	uint32_t size = 0;
+	for (const VarDeclNode * field : *record->fields()){
+		myFields[field] = size;
+		size += slots(myTypes.of(field));
+	}
+	myRecordSlots.emplace(record, size);
+	return size;
+}
+
+uint32_t Layout::field(const IndexNode * index){
+	//Lays the record out, if this is its first use
+	slots(myTypes.of(index->recordId()->decl()));
+	return myFields[index->fieldId()->decl()];
+}
+
+const DataType * Layout::typeOf(const ExpNode * exp){
+	switch (exp->kind()){
+	case KIND_INT_LIT: return myTypes.intType();
+	case KIND_STR_LIT: return myTypes.stringType();
+	case KIND_ID:
+		return myTypes.of(static_cast<const IDNode *>(exp)->decl());
+	case KIND_INDEX:
+		return myTypes.of(
+			static_cast<const IndexNode *>(exp)->fieldId()->decl());
+	case KIND_ASSIGN_EXP:
+		return typeOf(static_cast<const AssignExpNode *>(exp)->lval());
+	case KIND_CALL_EXP:
+		return myTypes.of(
+			static_cast<const CallExpNode *>(exp)->callee()->decl())->ret();
+	case KIND_PLUS: case KIND_MINUS: case KIND_TIMES: case KIND_DIVIDE:
+	case KIND_NEG:
+		return myTypes.intType();
+	default:
+		return myTypes.boolType();
+	}
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef CSHANTY_LAYOUT_H
+#define CSHANTY_LAYOUT_H
+
+#include <cstdint>
+#include <unordered_map>
+#include "ast.hpp"
+#include "types.hpp"
+
+namespace cshanty{
+
+/**
+* \class Layout
+* How the native backends (asmgen.hpp, jit.hpp) keep values of a
+* checked program: every int, bool or string takes one 8-byte slot
+* and a record one slot per field, nested records inline. Records are
+* laid out on first use and remembered. The type of each expression,
+* which decides the code for it, comes from the declarations that
+* names analysis attached and the types in types.
+**/
+class Layout{
+public:
+	Layout(TypeTable& types) : myTypes(types){ }
+
+	TypeTable& types(){ return myTypes; }
+	/** Slots taken by a value of type **/
+	uint32_t slots(const DataType * type);
+	/** Slot of index's field within its record **/
+	uint32_t field(const IndexNode * index);
+	/** The type of an expression that passed checkTypes **/
+	const DataType * typeOf(const ExpNode * exp);
+private:
+	TypeTable& myTypes;
+	std::unordered_map<const RecordTypeDeclNode *, uint32_t> myRecordSlots;
+	std::unordered_map<const DeclNode *, uint32_t> myFields;
+};
+
+}
+
+#endif
@@ -2,166 +2,226 @@
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <thread>
 #include "errors.hpp"
-#include "scanner.hpp"
+#include "driver.hpp"
+#include "batch.hpp"
+#include "server.hpp"
 
 using namespace cshanty;
 
 static void usageAndDie(){
-	std::cerr << "Usage: cshantyc <infile>"
+	std::cerr << "Usage: cshantyc <infile> (- for stdin)"
 	<< " [-u <unparseFile>]: Output canonical program form\n"
 	<< " [-p]: Parse the input to check syntax\n"
+	<< " [-n]: Check that every name is declared once and in scope\n"
+	<< " [-types]: Check names and types\n"
+	<< " [-O]: Fold constants and simplify before output\n"
 	<< " [-t <tokensFile>]: Output tokens to <tokensFile>\n"
+	<< " [-T <streamFile>]: Output binary tokens to <streamFile>,\n"
+	<< "   which can be given as <infile> to skip scanning\n"
+	<< " [-m]: Report arena and AST memory usage\n"
+	<< " [-s]: Scan with the hand-written scanner instead of flex\n"
+	<< " [-c <cacheDir>]: Reuse ASTs of unchanged inputs from <cacheDir>\n"
+	<< " [-j <jobs>]: Use <jobs> threads (0: one per core)\n"
+	<< " [-run]: Compile the program to bytecode and run it\n"
+	<< " [-jit]: Compile the program to machine code and run it\n"
+	<< " [-o <asmFile>]: Output x86-64 assembly to <asmFile>,\n"
+	<< "   to be linked with runtime/cshantyrt.c\n"
+	<< " [-e <editsFile>]: Apply the edits in <editsFile> to the input,\n"
+	<< "   reparsing only what each touches, before -t, -p and -u\n"
+	<< " [-stats]: Report time, counts and memory per phase\n"
+	<< " [-stats-json <statsFile>]: The same report as JSON\n"
+	<< "   or: cshantyc <infile>... [@<listFile>] ...\n"
+	<< "   compiles many inputs, one per thread; -t, -u, -o and\n"
+	<< "   -stats-json then name output directories\n"
+	<< "   or: cshantyc --server [--socket <path>] [--cache-mb <n>]\n"
+	<< "   stays resident, answering requests on stdin/stdout or a\n"
+	<< "   socket and keeping up to <n> MB (default 256) of ASTs\n"
+	<< "   or: cshantyc --client <path> <infile> [-t ...] [-p] [-u ...]\n"
+	<< "   has the server on socket <path> do the work\n"
 	;
 	exit(1);
 }
 
-static void writeTokenStream(const char * inPath, const char * outPath){
-	std::ifstream inStream(inPath);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream";
-		msg += inPath;
-		throw new InternalError(msg.c_str());
-	}
-	if (outPath == nullptr){
-		std::string msg = "No tokens output file given";
-		throw new InternalError(msg.c_str());
-	}
-
-	Scanner scanner(&inStream);
-	if (strcmp(outPath, "--") == 0){
-		scanner.outputTokens(std::cout);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new InternalError(msg.c_str());
-		}
-		scanner.outputTokens(outStream);
-		outStream.close();
-	}
-}
-
-static cshanty::ProgramNode * parse(const char * inFile){
-	std::ifstream inStream(inFile);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream ";
-		msg += inFile;
-		throw new InternalError(msg.c_str());
-	}
-
-	//This pointer will be set to the root of the
-	// AST after parsing
-	cshanty::ProgramNode * root = nullptr;
-
-	cshanty::Scanner scanner(&inStream);
-	cshanty::Parser parser(scanner, &root);
-
-	int errCode = parser.parse();
-	if (errCode != 0){ return nullptr; }
-
-	return root;
-}
-
-static void outputAST(ASTNode * ast, const char * outPath){
-	if (strcmp(outPath, "--") == 0){
-		ast->unparse(std::cout, 0);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new cshanty::InternalError(msg.c_str());
-		}
-		ast->unparse(outStream, 0);
-	}
-}
-
-static bool doUnparsing(const char * inputPath, const char * outPath){
-	cshanty::ProgramNode * ast = parse(inputPath);
-	if (ast == nullptr){ 
-		std::cerr << "No AST built\n";
-		return false;
-	}
-
-	outputAST(ast, outPath);
-	return true;
-}
-
 int 
 main( const int argc, const char **argv )
 {
 	if (argc == 0){
 		usageAndDie();
 	}
-	const char * inFile = NULL;
-	const char * tokensFile = NULL;
-	bool checkParse = false;
-	const char * unparseFile = NULL;
+	std::vector<std::string> inFiles;
+	bool batch = false;
+	unsigned jobs = 1;
+	DriverOptions opts;
 
 	bool useful = false;
-	int i = 1;
+	bool server = false;
+	const char * socketPath = nullptr;
+	const char * clientPath = nullptr;
+	size_t cacheMB = 256;
 	for (int i = 1 ; i < argc ; i++){
-		if (argv[i][0] == '-'){
-			if (argv[i][1] == 't'){
+		//Options are matched whole: -s and -stats are different
+		std::string arg = argv[i];
+		if (arg.size() > 1 && arg[0] == '-'){
+			if (arg == "-t"){
 				i++;
-				tokensFile = argv[i];
+				if (i >= argc){ usageAndDie(); }
+				opts.tokensFile = argv[i];
 				useful = true;
-			} else if (argv[i][1] == 'p'){
+			} else if (arg == "-T"){
 				i++;
-				checkParse = true;
+				if (i >= argc){ usageAndDie(); }
+				opts.tokenStreamFile = argv[i];
+				useful = true;
+			} else if (arg == "-p"){
+				opts.checkParse = true;
+				useful = true;
+			} else if (arg == "-n"){
+				opts.checkNames = true;
 				useful = true;
-			} else if (argv[i][1] == 'u'){
+			} else if (arg == "-types"){
+				opts.checkTypes = true;
+				useful = true;
+			} else if (arg == "-O"){
+				opts.optimize = true;
+			} else if (arg == "-j"){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				jobs = static_cast<unsigned>(atoi(argv[i]));
+			} else if (arg == "-c"){
 				i++;
 				if (i >= argc){ usageAndDie(); }
-				unparseFile = argv[i];
+				opts.cacheDir = argv[i];
+			} else if (arg == "-m"){
+				opts.arenaStats = true;
+			} else if (arg == "-s"){
+				opts.fastScan = true;
+			} else if (arg == "-run"){
+				opts.run = true;
+				useful = true;
+			} else if (arg == "-jit"){
+				opts.jit = true;
+				useful = true;
+			} else if (arg == "-o"){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				opts.asmFile = argv[i];
+				useful = true;
+			} else if (arg == "-e"){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				opts.editsFile = argv[i];
+			} else if (arg == "--server"){
+				server = true;
+			} else if (arg == "--socket"){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				socketPath = argv[i];
+			} else if (arg == "--client"){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				clientPath = argv[i];
+			} else if (arg == "--cache-mb"){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				cacheMB = static_cast<size_t>(atol(argv[i]));
+			} else if (arg == "-stats"){
+				opts.stats = true;
+			} else if (arg == "-stats-json"){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				opts.statsFile = argv[i];
+			} else if (arg == "-u"){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				opts.unparseFile = argv[i];
 				useful = true;
 			} else {
 				std::cerr << "Unrecognized argument: ";
 				std::cerr << argv[i] << std::endl;
 				usageAndDie();
 			}
-		} else {
-			if (inFile == NULL){
-				inFile = argv[i];
-			} else {
-				std::cerr << "Only 1 input file allowed";
-				std::cerr << argv[i] << std::endl;
+		} else if (argv[i][0] == '@'){
+			if (!readResponseFile(argv[i] + 1, inFiles)){
+				std::cerr << "Bad response file " << argv[i] + 1
+				<< std::endl;
 				usageAndDie();
 			}
+			batch = true;
+		} else {
+			inFiles.push_back(argv[i]);
 		}
 	}
-	if (inFile == NULL){
+	if (jobs == 0){ jobs = std::thread::hardware_concurrency(); }
+	if (server){
+		opts.unparseJobs = jobs;
+		return runServer(opts, socketPath, cacheMB << 20);
+	}
+	if (inFiles.empty()){
 		usageAndDie();
 	}
+	if ((opts.stats || opts.statsFile != nullptr || opts.arenaStats)
+	  && !Stats::available()){
+		std::cerr << "This cshantyc was built without -stats or -m support\n";
+		exit(1);
+	}
 	if (!useful){
 		std::cerr << "Hey, you didn't tell cshantyc to do anything!\n";
 		usageAndDie();
 	}
 
-	if (tokensFile != NULL){
-		try {
-			writeTokenStream(inFile, tokensFile);
-		} catch (InternalError * e){
-			std::cerr << "Error: " << e->msg() << std::endl;
+	if (opts.editsFile != nullptr){
+		//The edits apply to one text, and end with its parse
+		if (batch || inFiles.size() > 1 || clientPath != nullptr
+		  || opts.tokenStreamFile != nullptr || opts.checkNames
+		  || opts.checkTypes || opts.optimize || opts.run || opts.jit
+		  || opts.asmFile != nullptr || opts.cacheDir != nullptr
+		  || opts.arenaStats || opts.stats || opts.statsFile != nullptr){
+			std::cerr << "-e takes one input and only -t, -p and -u\n";
+			usageAndDie();
 		}
 	}
-
-	if (checkParse){
-		try {
-			if (!parse(inFile)){
-				std::cerr << "Parse failed" << std::endl;
-			}
-		} catch (ToDoError * e){
-			std::cerr << "ToDo: " << e->msg() << std::endl;
-			exit(1);
+	if (clientPath != nullptr){
+		//The server only scans, parses and unparses
+		if (batch || inFiles.size() > 1 || opts.tokenStreamFile != nullptr
+		  || opts.checkNames || opts.checkTypes || opts.run || opts.jit
+		  || opts.asmFile != nullptr || opts.arenaStats || opts.stats
+		  || opts.statsFile != nullptr){
+			std::cerr << "--client takes one input and only -t, -p and -u\n";
+			usageAndDie();
+		}
+		return runClient(opts, clientPath, inFiles.front().c_str());
+	}
+	if (batch || inFiles.size() > 1){
+		if ((opts.tokensFile != nullptr && strcmp(opts.tokensFile, "--") == 0)
+		  || (opts.unparseFile != nullptr && strcmp(opts.unparseFile, "--") == 0)
+		  || (opts.statsFile != nullptr && strcmp(opts.statsFile, "--") == 0)
+		  || (opts.asmFile != nullptr && strcmp(opts.asmFile, "--") == 0)){
+			std::cerr << "Output directories are required with"
+			<< " multiple inputs\n";
+			usageAndDie();
+		}
+		if (opts.run || opts.jit){
+			std::cerr << "-run and -jit take a single input\n";
+			usageAndDie();
 		}
+		return runBatch(opts, inFiles, jobs);
 	}
 
-	if (unparseFile != nullptr){
-		doUnparsing(inFile, unparseFile);
+	//The file is scanned and parsed once, no matter
+	// how many of -t, -p and -u were asked for. Extra
+	// threads go to unparsing the globals
+	opts.unparseJobs = jobs;
+	Driver driver(opts);
+	bool ok = false;
+	try {
+		ok = driver.run(inFiles.front().c_str());
+	} catch (InternalError * e){
+		std::cerr << "Error: " << e->msg() << std::endl;
+	} catch (AbortError * e){
+		exit(e->code());
 	}
 	
-	return 0;
+	return ok ? 0 : 1;
 }
@@ -0,0 +1,174 @@
+#include "names.hpp"
+#include "errors.hpp"
+#include "symboltable.hpp"
+#include "visitor.hpp"
+
+namespace cshanty{
+
+/*
+Fields are found in one map for all records, keyed by the
+record's name and the field's (records are global, so their
+names are unique)
+*/
+static uint64_t fieldKey(Symbol record, Symbol field){
+	return uint64_t(record.id()) << 32 | field.id();
+}
+
+/** Resolves names, as described in names.hpp **/
+class NameAnalysis : public AstVisitor<NameAnalysis>{
+public:
+	NameAnalysis(const LineTable& lines) : myLines(lines), myOk(true){ }
+
+	bool ok() const { return myOk; }
+
+	void visitProgram(ProgramNode * node){
+		myTable.enter();
+		visitChildren(node);
+		myTable.leave();
+	}
+
+	void visitVarDecl(VarDeclNode * node){
+		varType(node);
+		declare(node->id(), node);
+	}
+
+	void visitFormalDecl(FormalDeclNode * node){
+		visitVarDecl(node);
+	}
+
+	//Declared before its body is analyzed, so it can call itself
+	void visitFnDecl(FnDeclNode * node){
+		visit(node->type());
+		declare(node->id(), node);
+		myTable.enter();
+		if (node->formals() != nullptr){
+			for (FormalDeclNode * formal : *node->formals()){ visit(formal); }
+		}
+		stmts(node->body());
+		myTable.leave();
+	}
+
+	//Declared after its fields, so it can't contain itself
+	void visitRecordTypeDecl(RecordTypeDeclNode * node){
+		Symbol record = node->id()->getName();
+		for (VarDeclNode * field : *node->fields()){
+			varType(field);
+			IDNode * id = field->id();
+			id->setDecl(field);
+			if (myFields.insert(fieldKey(record, id->getName()), field) != field){
+				error(id, "Multiply declared identifier");
+			}
+		}
+		declare(node->id(), node);
+	}
+
+	void visitRecordType(RecordTypeNode * node){
+		IDNode * id = node->id();
+		DeclNode * decl = myTable.lookup(id->getName());
+		if (decl == nullptr){
+			error(id, "Undeclared identifier");
+		} else if (decl->kind() != KIND_RECORD_TYPE_DECL){
+			error(id, "Invalid type in declaration");
+		} else {
+			id->setDecl(decl);
+		}
+	}
+
+	void visitIfStmt(IfStmtNode * node){
+		visit(node->cond());
+		block(node->body());
+	}
+
+	void visitIfElseStmt(IfElseStmtNode * node){
+		visit(node->cond());
+		block(node->thenBranch());
+		block(node->elseBranch());
+	}
+
+	void visitWhileStmt(WhileStmtNode * node){
+		visit(node->cond());
+		block(node->body());
+	}
+
+	void visitID(IDNode * node){
+		DeclNode * decl = myTable.lookup(node->getName());
+		if (decl == nullptr){
+			error(node, "Undeclared identifier");
+		}
+		node->setDecl(decl);
+	}
+
+	void visitIndex(IndexNode * node){
+		IDNode * base = node->recordId();
+		visitID(base);
+		if (base->decl() == nullptr){ return; }
+		const TypeNode * type = nullptr;
+		if (VarDeclNode::classof(base->decl()->kind())){
+			type = static_cast<const VarDeclNode *>(base->decl())->type();
+		}
+		if (type == nullptr || type->kind() != KIND_RECORD_TYPE){
+			error(base, "Index of a non-record");
+			return;
+		}
+		//An unknown record type was reported at the declaration
+		const DeclNode * record =
+			static_cast<const RecordTypeNode *>(type)->id()->decl();
+		if (record == nullptr){ return; }
+		IDNode * field = node->fieldId();
+		DeclNode * decl = myFields.find(fieldKey(
+			static_cast<const RecordTypeDeclNode *>(record)->id()->getName(),
+			field->getName()));
+		if (decl == nullptr){
+			error(field, "Invalid record field name");
+		}
+		field->setDecl(decl);
+	}
+private:
+	void error(const IDNode * id, const char * msg){
+		size_t start = id->pos().start();
+		Report::fatal(myLines.line(start), myLines.col(start), msg);
+		myOk = false;
+	}
+
+	/*
+	A duplicate is reported, and its uses see the
+	first declaration
+	*/
+	void declare(IDNode * id, DeclNode * decl){
+		id->setDecl(decl);
+		if (myTable.declare(id->getName(), decl) != decl){
+			error(id, "Multiply declared identifier");
+		}
+	}
+
+	void varType(VarDeclNode * node){
+		TypeNode * type = node->type();
+		visit(type);
+		if (type->kind() == KIND_VOID_TYPE){
+			error(node->id(), "Invalid type in declaration");
+		}
+	}
+
+	void stmts(NodeList<StmtNode *> * list){
+		for (StmtNode * stmt : *list){ visit(stmt); }
+	}
+
+	void block(NodeList<StmtNode *> * list){
+		myTable.enter();
+		stmts(list);
+		myTable.leave();
+	}
+
+	const LineTable& myLines;
+	SymbolTable myTable;
+	SymbolMap myFields;
+	bool myOk;
+};
+
+bool analyzeNames(ProgramNode * root, const LineTable& lines){
+	NameAnalysis analysis(lines);
+	analysis.visit(root);
+	return analysis.ok();
+}
+
+}
@@ -0,0 +1,26 @@
+#ifndef CSHANTY_NAMES_H
+#define CSHANTY_NAMES_H
+
+#include "ast.hpp"
+
+namespace cshanty{
+
+/**
+* Resolve every name in the tree under root (-n): each IDNode that
+* declares something is linked to its declaration, each use to the
+* declaration in the nearest enclosing scope, and the field of each
+* IndexNode to the field's declaration in its record. Globals share
+* one scope, a function's formals and body another, and each if,
+* else and while body opens one more; record fields are looked up
+* per record. Undeclared and multiply declared names, variables of
+* type void or of a type that isn't a record, and indexing with
+* something other than a record variable or a field it doesn't have
+* are reported as fatal errors at their positions in lines, and make
+* the result false. Analysis carries on past errors, so that every
+* one is reported.
+**/
+bool analyzeNames(ProgramNode * root, const LineTable& lines);
+
+}
+
+#endif
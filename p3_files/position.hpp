@@ -1,48 +1,122 @@
 #ifndef CSHANTY_POSITION_H
 #define CSHANTY_POSITION_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 namespace cshanty{
 
+/**
+* \class LineTable
+* Byte offset of the start of every line in a source file, recorded
+* by the scanner as it passes each newline. Line and column numbers
+* (both 1-based) are recovered from an offset on demand, so nothing
+* but the offset has to be tracked per token.
+**/
+class LineTable{
+public:
+	LineTable() : myStarts(1, 0){ }
+	void addLine(uint32_t startOffset){ myStarts.push_back(startOffset); }
+	void clear(){ myStarts.assign(1, 0); }
+	/** Forget every line that starts after offset **/
+	void truncate(uint32_t offset){
+		myStarts.resize(line(offset));
+	}
+
+	size_t line(uint32_t offset) const{
+		//Common case: asking about the line being scanned
+		if (offset >= myStarts.back()){ return myStarts.size(); }
+		auto it = std::upper_bound(myStarts.begin(), myStarts.end(), offset);
+		return static_cast<size_t>(it - myStarts.begin());
+	}
+	size_t col(uint32_t offset) const{
+		return offset - myStarts[line(offset) - 1] + 1;
+	}
+	size_t lines() const { return myStarts.size(); }
+	/** Offset at which (1-based) line begins **/
+	uint32_t start(size_t line) const { return myStarts[line - 1]; }
+private:
+	std::vector<uint32_t> myStarts;
+};
+
+/**
+* \class LineCursor
+* Resolves offsets to lines by stepping forward through a LineTable,
+* which beats a binary search when offsets arrive in order (as they
+* do when listing tokens). Seeking backwards falls back to a search.
+**/
+class LineCursor{
+public:
+	LineCursor(const LineTable& lines) : myLines(lines), myLine(1){ }
+	void seek(uint32_t offset){
+		if (offset < myLines.start(myLine)){
+			myLine = myLines.line(offset);
+			return;
+		}
+		while (myLine < myLines.lines() && myLines.start(myLine + 1) <= offset){
+			myLine++;
+		}
+	}
+	/** Line of the last offset seeked to **/
+	size_t line() const { return myLine; }
+	/** Column of offset, which must be on line() **/
+	size_t col(uint32_t offset) const {
+		return offset - myLines.start(myLine) + 1;
+	}
+private:
+	const LineTable& myLines;
+	size_t myLine;
+};
+
+/**
+* \class Position
+* A half-open span of byte offsets into the source file. Positions
+* are small enough to be stored by value in tokens and nodes; line
+* and column numbers are only computed when a position is printed.
+* Sources are limited to 4GB.
+**/
 class Position{
-public: 
-	Position(size_t lineI, size_t colI, size_t lineE, size_t colE)
-	: myLineI(lineI), myColI(colI), myLineE(lineE), myColE(colE){
-	}
-	Position(Position * start, Position * end)
-	: myLineI(start->myLineI), myColI(start->myColI),
-	  myLineE(end->myLineE),myColE(end->myColE){
-	}
-	virtual void expand(Position * start, Position * end){
-	  myLineI = start->myLineI;
-	  myColI = start->myColI;
-	  myLineE = end->myLineE;
-	  myColE = end->myColE;
-	}
-	virtual std::string begin() const{
-		std::string result = "[" 
-		+ std::to_string(myLineI)
-		+ "," 
-		+ std::to_string(myColI)
+public:
+	Position() : myStart(0), myEnd(0){ }
+	Position(uint32_t start, uint32_t end)
+	: myStart(start), myEnd(end){
+	}
+	Position(const Position& start, const Position& end)
+	: myStart(start.myStart), myEnd(end.myEnd){
+	}
+	void expand(const Position& start, const Position& end){
+	  myStart = start.myStart;
+	  myEnd = end.myEnd;
+	}
+	uint32_t start() const { return myStart; }
+	uint32_t end() const { return myEnd; }
+	/** Move the span by delta bytes (for text inserted before it) **/
+	void shift(int32_t delta){
+		myStart += static_cast<uint32_t>(delta);
+		myEnd += static_cast<uint32_t>(delta);
+	}
+	std::string begin(const LineTable& lines) const{
+		std::string result = "["
+		+ std::to_string(lines.line(myStart))
+		+ ","
+		+ std::to_string(lines.col(myStart))
 		+ "]";
 		return result;
 	}
-	virtual std::string span() const{
-		std::string result = begin()
-		+ "-[" 
-		+ std::to_string(myLineE)
-		+ "," 
-		+ std::to_string(myColE)
+	std::string span(const LineTable& lines) const{
+		std::string result = begin(lines)
+		+ "-["
+		+ std::to_string(lines.line(myEnd))
+		+ ","
+		+ std::to_string(lines.col(myEnd))
 		+ "]";
 		return result;
 	}
 private:
-	size_t myLineI;
-	size_t myColI;
-	size_t myLineE;
-	size_t myColE;
-
+	uint32_t myStart;
+	uint32_t myEnd;
 };
 
 }
@@ -0,0 +1,106 @@
+/*
+Runtime for programs compiled by cshantyc -o (asmgen.hpp). Link
+it with the generated assembly:
+
+  cshantyc prog.cshanty -o prog.s && cc prog.s cshantyrt.c -o prog
+
+It supplies main(), which runs the program's main function, and
+the helpers the generated code calls for report, receive, string
+comparison and runtime errors. Output is the same as under -run:
+report adds no separators, bools print as true or false, and
+receive reads whitespace-separated words.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void cs_f_main(void);
+
+void cshanty_fail(const char * msg, int32_t line, int32_t col){
+	fflush(stdout);
+	fprintf(stderr, "FATAL [%d,%d]: Runtime error: %s\n", line, col, msg);
+	exit(1);
+}
+
+void cshanty_report_int(int32_t value){
+	printf("%d", value);
+}
+
+void cshanty_report_bool(int32_t value){
+	fputs(value ? "true" : "false", stdout);
+}
+
+void cshanty_report_str(const char * value){
+	fputs(value, stdout);
+}
+
+int32_t cshanty_streq(const char * lhs, const char * rhs){
+	return lhs == rhs || strcmp(lhs, rhs) == 0;
+}
+
+/* The next whitespace-separated word of input, or NULL at the end */
+static char * readWord(void){
+	size_t len = 0;
+	size_t cap = 16;
+	char * word;
+	int c;
+	fflush(stdout);
+	do {
+		c = getchar();
+	} while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+	if (c == EOF){ return NULL; }
+	word = malloc(cap);
+	while (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r'){
+		if (len + 1 == cap){
+			cap *= 2;
+			word = realloc(word, cap);
+		}
+		word[len++] = (char)c;
+		c = getchar();
+	}
+	word[len] = '\0';
+	return word;
+}
+
+int32_t cshanty_receive_int(int32_t line, int32_t col){
+	char * word = readWord();
+	char * end;
+	long long value = 0;
+	if (word != NULL){ value = strtoll(word, &end, 10); }
+	if (word == NULL || *end != '\0' || end == word
+	  || value < INT32_MIN || value > INT32_MAX){
+		cshanty_fail("Expected an int on input", line, col);
+	}
+	free(word);
+	return (int32_t)value;
+}
+
+int32_t cshanty_receive_bool(int32_t line, int32_t col){
+	char * word = readWord();
+	int32_t value = -1;
+	if (word != NULL){
+		if (strcmp(word, "true") == 0 || strcmp(word, "1") == 0){ value = 1; }
+		if (strcmp(word, "false") == 0 || strcmp(word, "0") == 0){ value = 0; }
+	}
+	if (value < 0){
+		cshanty_fail("Expected true or false on input", line, col);
+	}
+	free(word);
+	return value;
+}
+
+/* Received strings live for the rest of the run */
+const char * cshanty_receive_str(int32_t line, int32_t col){
+	char * word = readWord();
+	if (word == NULL){
+		cshanty_fail("Expected a string on input", line, col);
+	}
+	return word;
+}
+
+int main(void){
+	cs_f_main();
+	fflush(stdout);
+	return 0;
+}
@@ -7,81 +7,113 @@
 
 #include "grammar.hh"
 #include "errors.hpp"
+#include "context.hpp"
+#include "tokensource.hpp"
 
 using TokenKind = cshanty::Parser::token;
 
 namespace cshanty{
 
-class Scanner : public yyFlexLexer{
+class Scanner : public yyFlexLexer, public TokenSource{
 public:
    
-   Scanner(std::istream *in) : yyFlexLexer(in)
+   // Scans the file currently open in ctx.source()
+   Scanner(CompilationContext& ctx)
+   : yyFlexLexer(ctx.source().stream()), TokenSource(ctx)
    {
-	lineNum = 1;
-	colNum = 1;
+	myOffset = 0;
+	myReadPos = 0;
+   };
+
+   // Scans the mapped ctx.source() from byte offset start, which
+   // must lie between tokens (not inside a comment or string)
+   Scanner(CompilationContext& ctx, uint32_t start)
+   : yyFlexLexer(ctx.source().stream()), TokenSource(ctx)
+   {
+	myOffset = start;
+	myReadPos = start;
    };
    virtual ~Scanner() {
    };
 
-   //get rid of override virtual function warning
+   //get rid of override virtual function warning, and pick
+   // the parser's yylex out of the two bases
    using FlexLexer::yylex;
+   using TokenSource::yylex;
 
    // YY_DECL defined in the flex cshanty.l
-   virtual int yylex( cshanty::Parser::semantic_type * const lval);
+   int scan( cshanty::Parser::semantic_type * const lval);
 
    int makeBareToken(int tagIn){
-	size_t len = static_cast<size_t>(yyleng);
-	Position * pos = new Position(
-	  this->lineNum, this->colNum,
-	  this->lineNum, this->colNum+len);
-        this->yylval->lexeme = new Token(pos, tagIn);
-        colNum += len;
+	Position pos = consume();
+        this->yylval->lexeme = new (arena()) Token(pos, tagIn);
         return tagIn;
    }
 
-   void errIllegal(size_t l, size_t c, std::string match){
-	cshanty::Report::fatal(l, c, "Illegal character "
-		+ match);
-   }
-
-   void errStrEsc(size_t l, size_t c){
-	cshanty::Report::fatal(l, c, "String literal with bad"
-	" escape sequence ignored");
+   // Span of the current match; advances past it
+   Position consume(){
+	uint32_t start = myOffset;
+	myOffset += static_cast<uint32_t>(yyleng);
+	return Position(start, myOffset);
    }
 
-   void errStrUnterm(size_t l, size_t c){
-	cshanty::Report::fatal(l, c, "Unterminated string"
-	" literal ignored");
+   // Text of a match that has just been consumed. Points straight
+   // into the mapped source when there is one; on the stream path
+   // the text is copied into the arena
+   StringRef lexeme(const Position& pos){
+	size_t len = pos.end() - pos.start();
+	const SourceFile& src = myCtx.source();
+	if (src.mapped()){
+		return StringRef(src.data() + pos.start(), len);
+	}
+	char * copy = static_cast<char *>(arena().alloc(len, 1));
+	memcpy(copy, yytext, len);
+	return StringRef(copy, len);
    }
 
-   void errStrEscAndUnterm(size_t l, size_t c){
-	cshanty::Report::fatal(l, c, "Unterminated string literal"
-	" with bad escape sequence ignored");
+   // Called on each newline, once it has been consumed
+   void newLine(){
+	myCtx.lines().addLine(myOffset);
    }
 
-   void errIntOverflow(size_t l, size_t c){
-	cshanty::Report::fatal(l, c, "Integer literal too large;"
-	" using max value");
+   // Line and column of the current match, for diagnostics
+   size_t curLine() const { return myCtx.lines().line(myOffset); }
+   size_t curCol() const { return myCtx.lines().col(myOffset); }
+
+   using TokenSource::arena;
+   using TokenSource::lines;
+
+protected:
+   int lex(cshanty::Parser::semantic_type * const lval) override {
+	int kind = scan(lval);
+	if (kind == TokenKind::END){
+		lval->lexeme = new (arena()) Token(
+		  Position(myOffset, myOffset), kind);
+	}
+	return kind;
    }
 
-   void warn(int lineNumIn, int colNumIn, std::string msg){
-	std::cerr << lineNumIn << ":" << colNumIn 
-		<< " ***WARNING*** " << msg << std::endl;
+   // flex has no in-place scanning in C++ mode, so mapped sources
+   // are handed to it in large blocks straight from the mapping
+   int LexerInput(char * buf, int maxSize) override {
+	const SourceFile& src = myCtx.source();
+	if (!src.mapped()){
+		int n = yyFlexLexer::LexerInput(buf, maxSize);
+		if (n > 0){ myReadPos += static_cast<size_t>(n); }
+		if (myReadPos > SourceFile::MAX_SIZE){ errTooLarge(); }
+		return n;
+	}
+	size_t n = src.size() - myReadPos;
+	if (n > static_cast<size_t>(maxSize)){ n = static_cast<size_t>(maxSize); }
+	memcpy(buf, src.data() + myReadPos, n);
+	myReadPos += n;
+	return static_cast<int>(n);
    }
 
-   void error(int lineNumIn, int colNumIn, std::string msg){
-	std::cerr << lineNumIn << ":" << colNumIn 
-		<< " ***ERROR*** " << msg << std::endl;
-   }
-
-   static std::string tokenKindString(int tokenKind);
-
-   void outputTokens(std::ostream& outstream);
-
 private:
    cshanty::Parser::semantic_type *yylval = nullptr;
-   size_t lineNum;
-   size_t colNum;
+   uint32_t myOffset;
+   size_t myReadPos;
 };
 
 } /* end namespace */
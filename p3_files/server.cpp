@@ -0,0 +1,402 @@
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+#include "errors.hpp"
+#include "interner.hpp"
+#include "treecache.hpp"
+
+namespace cshanty{
+
+/**
+* \class Channel
+* One end of a conversation: lines and counted runs of bytes read
+* through a buffer, and writes that don't return until done.
+**/
+class Channel{
+public:
+	Channel(int in, int out) : myIn(in), myOut(out), myStart(0), myEnd(0){ }
+
+	/** The next line, without its newline. False at the end **/
+	bool readLine(std::string& line){
+		line.clear();
+		while (true){
+			for (size_t i = myStart; i < myEnd; i++){
+				if (myBuf[i] != '\n'){ continue; }
+				line.append(myBuf + myStart, i - myStart);
+				myStart = i + 1;
+				return true;
+			}
+			line.append(myBuf + myStart, myEnd - myStart);
+			myStart = myEnd;
+			if (!fill()){ return false; }
+		}
+	}
+
+	/** The next size bytes. False if they don't all come **/
+	bool read(std::string& bytes, size_t size){
+		bytes.clear();
+		while (bytes.size() < size){
+			if (myStart == myEnd && !fill()){ return false; }
+			size_t take = std::min(size - bytes.size(), myEnd - myStart);
+			bytes.append(myBuf + myStart, take);
+			myStart += take;
+		}
+		return true;
+	}
+
+	bool write(const std::string& bytes){
+		const char * data = bytes.data();
+		size_t left = bytes.size();
+		while (left > 0){
+			ssize_t done = ::write(myOut, data, left);
+			if (done < 0 && errno == EINTR){ continue; }
+			if (done <= 0){ return false; }
+			data += done;
+			left -= static_cast<size_t>(done);
+		}
+		return true;
+	}
+private:
+	bool fill(){
+		ssize_t got;
+		do {
+			got = ::read(myIn, myBuf, sizeof(myBuf));
+		} while (got < 0 && errno == EINTR);
+		if (got <= 0){ return false; }
+		myStart = 0;
+		myEnd = static_cast<size_t>(got);
+		return true;
+	}
+
+	int myIn;
+	int myOut;
+	char myBuf[1 << 16];
+	size_t myStart;
+	size_t myEnd;
+};
+
+/* -1 if path doesn't fit in a socket address */
+static int unixAddress(const char * path, struct sockaddr_un& addr){
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)){ return -1; }
+	strcpy(addr.sun_path, path);
+	return 0;
+}
+
+static struct sockaddr * generic(struct sockaddr_un& addr){
+	return reinterpret_cast<struct sockaddr *>(&addr);
+}
+
+/**
+* \class Server
+* Answers requests, each with a fresh Driver whose output and
+* diagnostics are captured as batch mode captures them; only the
+* TreeCache lives from one request to the next. Several connections
+* may be served at once, each on its own thread.
+**/
+class Server{
+public:
+	Server(const DriverOptions& opts, size_t cacheBytes)
+	: myBase(opts), myCache(cacheBytes){ }
+
+	/** Serve channel until it ends. False once asked to shut down **/
+	bool serve(Channel& channel){
+		std::string line;
+		while (channel.readLine(line)){
+			std::string fields[3];
+			size_t start = 0;
+			for (size_t i = 0; i < 3 && start <= line.size(); i++){
+				size_t tab = i == 2 ? std::string::npos
+				  : line.find('\t', start);
+				fields[i] = line.substr(start, tab - start);
+				start = tab == std::string::npos ? line.size() + 1 : tab + 1;
+			}
+			if (fields[0] == "shutdown"){
+				respond(channel, 0, "", "");
+				return false;
+			}
+			if (!handle(channel, fields[0], fields[1], fields[2])){
+				return true;
+			}
+		}
+		return true;
+	}
+private:
+	bool handle(Channel& channel, const std::string& command,
+		const std::string& path, const std::string& output){
+		if (command == "stats"){
+			std::ostringstream out;
+			out << "entries: " << myCache.entries()
+			<< ", bytes: " << myCache.bytes()
+			<< ", hits: " << myCache.hits()
+			<< ", misses: " << myCache.misses() << "\n";
+			return respond(channel, 0, out.str(), "");
+		}
+		DriverOptions opts;
+		opts.fastScan = myBase.fastScan;
+		opts.optimize = myBase.optimize;
+		opts.cacheDir = myBase.cacheDir;
+		opts.unparseJobs = myBase.unparseJobs;
+		opts.treeCache = &myCache;
+		const char * target = output.empty() ? "--" : output.c_str();
+		if (command == "tokens"){
+			opts.tokensFile = target;
+		} else if (command == "parse"){
+			opts.checkParse = true;
+		} else if (command == "unparse"){
+			opts.unparseFile = target;
+		} else {
+			return respond(channel, 1, "",
+				"Error: Unknown request " + command + "\n");
+		}
+		if (path.empty()){
+			return respond(channel, 1, "", "Error: No path given\n");
+		}
+
+		std::ostringstream out;
+		std::ostringstream err;
+		int status = 0;
+		Report::redirect(&err, &out);
+		try {
+			Driver driver(opts);
+			if (!driver.run(path.c_str())){ status = 1; }
+		} catch (InternalError * e){
+			err << "Error: " << e->msg() << std::endl;
+			status = 1;
+			delete e;
+		} catch (AbortError * e){
+			status = e->code();
+			delete e;
+		}
+		Report::redirect(nullptr, nullptr);
+		return respond(channel, status, out.str(), err.str());
+	}
+
+	bool respond(Channel& channel, int status, const std::string& out,
+		const std::string& err){
+		std::string header = std::to_string(status) + " "
+		  + std::to_string(out.size()) + " " + std::to_string(err.size()) + "\n";
+		return channel.write(header) && channel.write(out)
+		  && channel.write(err);
+	}
+
+	DriverOptions myBase;
+	TreeCache myCache;
+};
+
+/**
+* \class Connections
+* The connections being served, each on a thread of its own so that
+* a slow or idle client holds up no one else. Once one of them asks
+* for a shutdown, the accept loop is woken through a pipe, and the
+* rest are shut down (ending their reads) and waited for.
+**/
+class Connections{
+public:
+	Connections(Server& server) : myServer(server), myStopping(false){
+		myWake[0] = myWake[1] = -1;
+	}
+	~Connections(){
+		if (myWake[0] >= 0){ close(myWake[0]); }
+		if (myWake[1] >= 0){ close(myWake[1]); }
+	}
+
+	bool open(){ return pipe(myWake) == 0; }
+	/** Readable once a connection has asked for a shutdown **/
+	int wakeFd() const { return myWake[0]; }
+
+	/** Serve fd on a new thread, which closes it when done **/
+	void start(int fd){
+		std::lock_guard<std::mutex> hold(myLock);
+		myOpen.insert(fd);
+		std::thread(&Connections::run, this, fd).detach();
+	}
+
+	/** End every connection still open and wait for their threads **/
+	void finish(){
+		std::unique_lock<std::mutex> hold(myLock);
+		for (int fd : myOpen){ shutdown(fd, SHUT_RDWR); }
+		myDone.wait(hold, [this]{ return myOpen.empty(); });
+	}
+private:
+	void run(int fd){
+		Channel channel(fd, fd);
+		bool stop = !myServer.serve(channel);
+		std::lock_guard<std::mutex> hold(myLock);
+		if (stop && !myStopping){
+			myStopping = true;
+			(void)!write(myWake[1], "", 1);
+		}
+		//Closed under the lock, so finish() never shuts down a
+		// descriptor that has since been reused
+		myOpen.erase(fd);
+		close(fd);
+		myDone.notify_all();
+	}
+
+	Server& myServer;
+	int myWake[2];
+	bool myStopping;
+	std::mutex myLock;
+	std::condition_variable myDone;
+	std::set<int> myOpen;
+};
+
+int runServer(const DriverOptions& opts, const char * socketPath,
+	size_t cacheBytes){
+	//A client that goes away mid-response is only a failed write
+	signal(SIGPIPE, SIG_IGN);
+	Server server(opts, cacheBytes);
+	if (socketPath == nullptr){
+		Channel channel(STDIN_FILENO, STDOUT_FILENO);
+		server.serve(channel);
+		return 0;
+	}
+
+	struct sockaddr_un addr;
+	if (unixAddress(socketPath, addr) != 0){
+		std::cerr << "Socket path too long: " << socketPath << std::endl;
+		return 1;
+	}
+	//A socket left behind by an earlier server is replaced, but
+	// anything else there is left alone
+	struct stat info;
+	if (lstat(socketPath, &info) == 0){
+		if (!S_ISSOCK(info.st_mode)){
+			std::cerr << "Not a socket, so not replacing it: " << socketPath
+			<< std::endl;
+			return 1;
+		}
+		unlink(socketPath);
+	}
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0 || bind(listener, generic(addr), sizeof(addr)) != 0
+	  || listen(listener, 16) != 0){
+		std::cerr << "Can't listen on " << socketPath << ": "
+		<< strerror(errno) << std::endl;
+		return 1;
+	}
+	Connections connections(server);
+	if (!connections.open()){
+		std::cerr << "Can't serve: " << strerror(errno) << std::endl;
+		close(listener);
+		return 1;
+	}
+	Interner::global().setConcurrent(true);
+	bool running = true;
+	while (running){
+		struct pollfd ready[2] = {
+			{ listener, POLLIN, 0 },
+			{ connections.wakeFd(), POLLIN, 0 },
+		};
+		if (poll(ready, 2, -1) < 0){
+			if (errno == EINTR){ continue; }
+			std::cerr << "Can't wait on " << socketPath << ": "
+			<< strerror(errno) << std::endl;
+			break;
+		}
+		if (ready[1].revents != 0){
+			running = false;
+			break;
+		}
+		int fd = accept(listener, nullptr, nullptr);
+		if (fd < 0){
+			if (errno == EINTR){ continue; }
+			std::cerr << "Can't accept on " << socketPath << ": "
+			<< strerror(errno) << std::endl;
+			break;
+		}
+		connections.start(fd);
+	}
+	close(listener);
+	connections.finish();
+	Interner::global().setConcurrent(false);
+	unlink(socketPath);
+	return running ? 1 : 0;
+}
+
+/*
+Sends one request and relays its response. The server writes any
+output file itself, so a relative one is made absolute here
+*/
+static int request(Channel& channel, const char * command,
+	const std::string& path, const char * outPath){
+	std::string line = std::string(command) + "\t" + path;
+	if (outPath != nullptr && strcmp(outPath, "--") != 0){
+		std::string target = outPath;
+		char cwd[PATH_MAX];
+		if (target[0] != '/' && getcwd(cwd, sizeof(cwd)) != nullptr){
+			target = std::string(cwd) + "/" + target;
+		}
+		line += "\t" + target;
+	}
+	std::string header;
+	if (!channel.write(line + "\n")
+	  || !channel.readLine(header)){
+		std::cerr << "Error: Lost the server" << std::endl;
+		return 1;
+	}
+	int status = 0;
+	unsigned long outSize = 0;
+	unsigned long errSize = 0;
+	std::istringstream fields(header);
+	std::string out;
+	std::string err;
+	if (!(fields >> status >> outSize >> errSize)
+	  || !channel.read(out, outSize) || !channel.read(err, errSize)){
+		std::cerr << "Error: Bad response from the server" << std::endl;
+		return 1;
+	}
+	std::cout << out << std::flush;
+	std::cerr << err;
+	return status;
+}
+
+int runClient(const DriverOptions& opts, const char * socketPath,
+	const char * inPath){
+	struct sockaddr_un addr;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (unixAddress(socketPath, addr) != 0 || fd < 0
+	  || connect(fd, generic(addr), sizeof(addr)) != 0){
+		std::cerr << "Can't connect to " << socketPath << std::endl;
+		return 1;
+	}
+	//The server has its own working directory
+	char resolved[PATH_MAX];
+	std::string path = realpath(inPath, resolved) != nullptr ? resolved
+	  : inPath;
+
+	//In the order a single run produces them, stopping
+	// where it would stop
+	Channel channel(fd, fd);
+	int status = 0;
+	if (opts.tokensFile != nullptr){
+		status = request(channel, "tokens", path, opts.tokensFile);
+	}
+	if (status == 0 && opts.checkParse){
+		status = request(channel, "parse", path, nullptr);
+	}
+	if (status == 0 && opts.unparseFile != nullptr){
+		status = request(channel, "unparse", path, opts.unparseFile);
+	}
+	close(fd);
+	return status;
+}
+
+}
@@ -0,0 +1,49 @@
+#ifndef CSHANTY_SERVER_H
+#define CSHANTY_SERVER_H
+
+#include <cstddef>
+#include "driver.hpp"
+
+namespace cshanty{
+
+/*
+Compile server protocol. A request is one line of tab-separated
+fields:
+
+  <command>\t<path>[\t<output>]\n
+
+where command is tokens, parse or unparse (what -t, -p and -u would
+do for the file at path, which should be absolute), or stats (the AST
+cache's counters) or shutdown, which take no path. The tokens or
+unparse go to output, an absolute path the server writes itself, or
+with no output field, into the response. Each request gets one:
+
+  <status> <outBytes> <errBytes>\n
+
+followed by that many bytes of standard output and then of
+diagnostics, exactly as cshantyc run on the file would have written
+them, and the exit status it would have had.
+*/
+/**
+* Serve requests (--server) until shutdown: from standard input to
+* standard output, or with a socketPath, from connections to a Unix
+* domain socket there, each served on its own thread. Only the scanner, -O, -c and -j
+* settings of opts are used. Parsed trees are kept in a TreeCache of
+* at most cacheBytes between requests, so a request for an unchanged
+* file skips the scan and parse. Returns the exit status.
+**/
+int runServer(const DriverOptions& opts, const char * socketPath,
+	size_t cacheBytes);
+
+/**
+* Ask the server at socketPath for the tokens, parse check and/or
+* unparse of inPath that opts asks for (--client), writing them
+* where a plain run would. Returns the status a plain run would have
+* exited with.
+**/
+int runClient(const DriverOptions& opts, const char * socketPath,
+	const char * inPath);
+
+}
+
+#endif
@@ -0,0 +1,346 @@
+#include <climits>
+#include <vector>
+#include "simplify.hpp"
+#include "visitor.hpp"
+
+namespace cshanty{
+
+/*
+Whether evaluating exp can do anything besides produce its
+value: only calls and assignments can. An operand that can
+is never dropped, even when the result doesn't depend on it.
+*/
+static bool pure(const ASTNode * exp){
+	if (exp->kind() == KIND_CALL_EXP || exp->kind() == KIND_ASSIGN_EXP){
+		return false;
+	}
+	bool result = true;
+	forEachChild(exp, [&result](const ASTNode * child){
+		if (result && !pure(child)){ result = false; }
+	});
+	return result;
+}
+
+static bool isInt(const ExpNode * exp, int value){
+	return exp->kind() == KIND_INT_LIT
+	  && static_cast<const IntLitNode *>(exp)->value() == value;
+}
+
+/* 1 for aye, 0 for nay, -1 for anything else */
+static int truth(const ExpNode * exp){
+	if (exp->kind() == KIND_TRUE){ return 1; }
+	if (exp->kind() == KIND_FALSE){ return 0; }
+	return -1;
+}
+
+/*
+Two's complement arithmetic on 32 bits, done
+unsigned so that wrapping is well defined
+*/
+static int wrap(uint32_t value){
+	return value <= INT_MAX ? static_cast<int>(value)
+	  : -static_cast<int>(~value) - 1;
+}
+
+/** Rewrites a tree bottom-up, as described in simplify.hpp **/
+class Simplifier : public AstVisitor<Simplifier, ASTNode *>{
+public:
+	Simplifier(Arena& arena) : myArena(arena){ }
+
+	//Anything without a handler has no expressions under it
+	template <typename N>
+	ASTNode * visitNode(N * node){ return node; }
+
+	ASTNode * visitProgram(ProgramNode * node){
+		std::vector<DeclNode *> globals;
+		bool changed = false;
+		for (DeclNode * global : *node->globals()){
+			DeclNode * result = static_cast<DeclNode *>(visit(global));
+			changed = changed || result != global;
+			globals.push_back(result);
+		}
+		if (!changed){ return node; }
+		NodeList<DeclNode *> * list = newList<DeclNode *>(myArena);
+		list->insert(list->end(), globals.begin(), globals.end());
+		return new (myArena) ProgramNode(list);
+	}
+
+	ASTNode * visitFnDecl(FnDeclNode * node){
+		NodeList<StmtNode *> * body = stmts(node->body());
+		if (body == node->body()){ return node; }
+		return new (myArena) FnDeclNode(node->pos(), node->type(), node->id(),
+			node->formals(), body);
+	}
+
+	ASTNode * visitAssignStmt(AssignStmtNode * node){
+		AssignExpNode * assign = static_cast<AssignExpNode *>(
+			visit(node->assign()));
+		if (assign == node->assign()){ return node; }
+		return new (myArena) AssignStmtNode(node->pos(), assign);
+	}
+
+	ASTNode * visitCallStmt(CallStmtNode * node){
+		CallExpNode * call = static_cast<CallExpNode *>(visit(node->call()));
+		if (call == node->call()){ return node; }
+		return new (myArena) CallStmtNode(node->pos(), call);
+	}
+
+	ASTNode * visitReportStmt(ReportStmtNode * node){
+		ExpNode * exp = this->exp(node->exp());
+		if (exp == node->exp()){ return node; }
+		return new (myArena) ReportStmtNode(node->pos(), exp);
+	}
+
+	ASTNode * visitReturnStmt(ReturnStmtNode * node){
+		if (node->exp() == nullptr){ return node; }
+		ExpNode * exp = this->exp(node->exp());
+		if (exp == node->exp()){ return node; }
+		return new (myArena) ReturnStmtNode(node->pos(), exp);
+	}
+
+	/*
+	The statement handlers below give null for a statement that
+	is dropped. An if whose condition is aye may have its body
+	spliced into the enclosing list (see stmts)
+	*/
+	ASTNode * visitIfStmt(IfStmtNode * node){
+		ExpNode * cond = exp(node->cond());
+		if (truth(cond) == 0){ return nullptr; }
+		NodeList<StmtNode *> * body = stmts(node->body());
+		if (cond == node->cond() && body == node->body()){ return node; }
+		return new (myArena) IfStmtNode(node->pos(), cond, body);
+	}
+
+	ASTNode * visitIfElseStmt(IfElseStmtNode * node){
+		ExpNode * cond = exp(node->cond());
+		int known = truth(cond);
+		if (known >= 0){
+			NodeList<StmtNode *> * taken = known == 1 ? node->thenBranch()
+			  : node->elseBranch();
+			if (taken == nullptr || taken->empty()){ return nullptr; }
+			return new (myArena) IfStmtNode(node->pos(),
+				new (myArena) TrueNode(cond->pos()), stmts(taken));
+		}
+		NodeList<StmtNode *> * thenBranch = stmts(node->thenBranch());
+		NodeList<StmtNode *> * elseBranch = stmts(node->elseBranch());
+		if (cond == node->cond() && thenBranch == node->thenBranch()
+		  && elseBranch == node->elseBranch()){
+			return node;
+		}
+		return new (myArena) IfElseStmtNode(node->pos(), cond, thenBranch,
+			elseBranch);
+	}
+
+	ASTNode * visitWhileStmt(WhileStmtNode * node){
+		ExpNode * cond = exp(node->cond());
+		if (truth(cond) == 0){ return nullptr; }
+		NodeList<StmtNode *> * body = stmts(node->body());
+		if (cond == node->cond() && body == node->body()){ return node; }
+		return new (myArena) WhileStmtNode(node->pos(), cond, body);
+	}
+
+	ASTNode * visitAssignExp(AssignExpNode * node){
+		ExpNode * exp = this->exp(node->exp());
+		if (exp == node->exp()){ return node; }
+		return new (myArena) AssignExpNode(node->pos(), node->lval(), exp);
+	}
+
+	ASTNode * visitCallExp(CallExpNode * node){
+		if (node->args() == nullptr){ return node; }
+		std::vector<ExpNode *> args;
+		bool changed = false;
+		for (ExpNode * arg : *node->args()){
+			ExpNode * result = exp(arg);
+			changed = changed || result != arg;
+			args.push_back(result);
+		}
+		if (!changed){ return node; }
+		NodeList<ExpNode *> * list = newList<ExpNode *>(myArena);
+		list->insert(list->end(), args.begin(), args.end());
+		return new (myArena) CallExpNode(node->pos(), node->callee(), list);
+	}
+
+	ASTNode * visitBinaryExp(BinaryExpNode * node){
+		ExpNode * lhs = exp(node->lhs());
+		ExpNode * rhs = exp(node->rhs());
+		ExpNode * folded = fold(node, lhs, rhs);
+		if (folded != nullptr){ return folded; }
+		if (lhs == node->lhs() && rhs == node->rhs()){ return node; }
+		return binary(node->kind(), node->pos(), lhs, rhs);
+	}
+
+	ASTNode * visitNeg(NegNode * node){
+		ExpNode * operand = exp(node->exp());
+		if (operand->kind() == KIND_INT_LIT){
+			uint32_t value = static_cast<uint32_t>(
+				static_cast<IntLitNode *>(operand)->value());
+			return intLit(node->pos(), wrap(0u - value));
+		}
+		if (operand->kind() == KIND_NEG){
+			return static_cast<NegNode *>(operand)->exp();
+		}
+		if (operand == node->exp()){ return node; }
+		return new (myArena) NegNode(node->pos(), operand);
+	}
+
+	ASTNode * visitNot(NotNode * node){
+		ExpNode * operand = exp(node->exp());
+		int known = truth(operand);
+		if (known >= 0){ return boolLit(node->pos(), known == 0); }
+		if (operand->kind() == KIND_NOT){
+			return static_cast<NotNode *>(operand)->exp();
+		}
+		if (operand == node->exp()){ return node; }
+		return new (myArena) NotNode(node->pos(), operand);
+	}
+private:
+	ExpNode * exp(ExpNode * exp){
+		return static_cast<ExpNode *>(visit(exp));
+	}
+
+	/*
+	A statement list with each statement simplified, pruned ones
+	left out and the bodies of if (aye) spliced in. A body that
+	declares variables keeps its if, so its scope stays its own.
+	The original list is kept if nothing changed
+	*/
+	NodeList<StmtNode *> * stmts(NodeList<StmtNode *> * list){
+		if (list == nullptr){ return list; }
+		std::vector<StmtNode *> out;
+		bool changed = false;
+		for (StmtNode * stmt : *list){
+			StmtNode * result = static_cast<StmtNode *>(visit(stmt));
+			if (result != stmt){ changed = true; }
+			if (result == nullptr){ continue; }
+			IfStmtNode * ifStmt = nodeCast<IfStmtNode>(result);
+			if (ifStmt != nullptr && truth(ifStmt->cond()) == 1
+			  && !declares(ifStmt->body())){
+				out.insert(out.end(), ifStmt->body()->begin(),
+					ifStmt->body()->end());
+				changed = true;
+				continue;
+			}
+			out.push_back(result);
+		}
+		if (!changed){ return list; }
+		NodeList<StmtNode *> * result = newList<StmtNode *>(myArena);
+		result->insert(result->end(), out.begin(), out.end());
+		return result;
+	}
+
+	static bool declares(const NodeList<StmtNode *> * list){
+		for (const StmtNode * stmt : *list){
+			if (DeclNode::classof(stmt->kind())){ return true; }
+		}
+		return false;
+	}
+
+	/*
+	The value of lhs op rhs, or of an identity, if one is known;
+	null if not. Short-circuit operators may drop their right
+	operand when the left decides the result, but an operand that
+	isn't pure is otherwise always kept
+	*/
+	ExpNode * fold(BinaryExpNode * node, ExpNode * lhs, ExpNode * rhs){
+		NodeKind kind = node->kind();
+		Position pos = node->pos();
+		if (lhs->kind() == KIND_INT_LIT && rhs->kind() == KIND_INT_LIT){
+			int l = static_cast<IntLitNode *>(lhs)->value();
+			int r = static_cast<IntLitNode *>(rhs)->value();
+			uint32_t ul = static_cast<uint32_t>(l);
+			uint32_t ur = static_cast<uint32_t>(r);
+			switch (kind){
+			case KIND_PLUS: return intLit(pos, wrap(ul + ur));
+			case KIND_MINUS: return intLit(pos, wrap(ul - ur));
+			case KIND_TIMES: return intLit(pos, wrap(ul * ur));
+			case KIND_DIVIDE:
+				if (r == 0 || (l == INT_MIN && r == -1)){ return nullptr; }
+				return intLit(pos, l / r);
+			case KIND_EQUALS: return boolLit(pos, l == r);
+			case KIND_NOT_EQUALS: return boolLit(pos, l != r);
+			case KIND_LESS: return boolLit(pos, l < r);
+			case KIND_LESS_EQ: return boolLit(pos, l <= r);
+			case KIND_GREATER: return boolLit(pos, l > r);
+			case KIND_GREATER_EQ: return boolLit(pos, l >= r);
+			default: return nullptr;
+			}
+		}
+
+		int lt = truth(lhs);
+		int rt = truth(rhs);
+		switch (kind){
+		case KIND_PLUS:
+			if (isInt(lhs, 0)){ return rhs; }
+			if (isInt(rhs, 0)){ return lhs; }
+			return nullptr;
+		case KIND_MINUS:
+			if (isInt(rhs, 0)){ return lhs; }
+			return nullptr;
+		case KIND_TIMES:
+			if (isInt(lhs, 1)){ return rhs; }
+			if (isInt(rhs, 1)){ return lhs; }
+			if (isInt(lhs, 0) && pure(rhs)){ return lhs; }
+			if (isInt(rhs, 0) && pure(lhs)){ return rhs; }
+			return nullptr;
+		case KIND_DIVIDE:
+			if (isInt(rhs, 1)){ return lhs; }
+			return nullptr;
+		case KIND_AND:
+			if (lt == 1){ return rhs; }
+			if (lt == 0){ return lhs; }
+			if (rt == 1){ return lhs; }
+			if (rt == 0 && pure(lhs)){ return rhs; }
+			return nullptr;
+		case KIND_OR:
+			if (lt == 0){ return rhs; }
+			if (lt == 1){ return lhs; }
+			if (rt == 0){ return lhs; }
+			if (rt == 1 && pure(lhs)){ return rhs; }
+			return nullptr;
+		case KIND_EQUALS:
+			if (lt >= 0 && rt >= 0){ return boolLit(pos, lt == rt); }
+			return nullptr;
+		case KIND_NOT_EQUALS:
+			if (lt >= 0 && rt >= 0){ return boolLit(pos, lt != rt); }
+			return nullptr;
+		default:
+			return nullptr;
+		}
+	}
+
+	ExpNode * binary(NodeKind kind, Position pos, ExpNode * lhs,
+		ExpNode * rhs){
+		switch (kind){
+		case KIND_AND: return new (myArena) AndNode(pos, lhs, rhs);
+		case KIND_DIVIDE: return new (myArena) DivideNode(pos, lhs, rhs);
+		case KIND_EQUALS: return new (myArena) EqualsNode(pos, lhs, rhs);
+		case KIND_GREATER_EQ: return new (myArena) GreaterEqNode(pos, lhs, rhs);
+		case KIND_GREATER: return new (myArena) GreaterNode(pos, lhs, rhs);
+		case KIND_LESS_EQ: return new (myArena) LessEqNode(pos, lhs, rhs);
+		case KIND_LESS: return new (myArena) LessNode(pos, lhs, rhs);
+		case KIND_MINUS: return new (myArena) MinusNode(pos, lhs, rhs);
+		case KIND_NOT_EQUALS: return new (myArena) NotEqualsNode(pos, lhs, rhs);
+		case KIND_OR: return new (myArena) OrNode(pos, lhs, rhs);
+		case KIND_PLUS: return new (myArena) PlusNode(pos, lhs, rhs);
+		default: return new (myArena) TimesNode(pos, lhs, rhs);
+		}
+	}
+
+	ExpNode * intLit(Position pos, int value){
+		return new (myArena) IntLitNode(pos, value);
+	}
+
+	ExpNode * boolLit(Position pos, bool value){
+		if (value){ return new (myArena) TrueNode(pos); }
+		return new (myArena) FalseNode(pos);
+	}
+
+	Arena& myArena;
+};
+
+ProgramNode * simplify(ProgramNode * root, Arena& arena){
+	Simplifier simplifier(arena);
+	return static_cast<ProgramNode *>(simplifier.visit(root));
+}
+
+}
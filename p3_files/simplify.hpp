@@ -0,0 +1,21 @@
+#ifndef CSHANTY_SIMPLIFY_H
+#define CSHANTY_SIMPLIFY_H
+
+#include "ast.hpp"
+
+namespace cshanty{
+
+/**
+* The tree under root with constant expressions folded, algebraic
+* identities (x + 0, x * 1, !!b, aye and b, ...) applied, and if and
+* while statements with a constant condition pruned (-O). Ints are
+* 32-bit two's complement and wrap on overflow; a division by zero,
+* or of INT_MIN by -1, is left for run time. Subtrees that don't
+* change are shared with the original, new nodes come from arena,
+* and the program is assumed to be well typed.
+**/
+ProgramNode * simplify(ProgramNode * root, Arena& arena);
+
+}
+
+#endif
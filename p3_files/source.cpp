@@ -0,0 +1,86 @@
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.hpp"
+
+namespace cshanty{
+
+SourceFile::SourceFile()
+: myMapped(false), myBorrowed(false), myTooLarge(false), myData(nullptr),
+  mySize(0), myStream(nullptr){
+}
+
+SourceFile::~SourceFile(){
+	close();
+}
+
+bool SourceFile::open(const char * path){
+	close();
+	myPath = path;
+	if (strcmp(path, "-") == 0){
+		myStream = &std::cin;
+		return true;
+	}
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0){ return false; }
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)){
+		//Its positions would wrap around
+		if (static_cast<uint64_t>(info.st_size) > MAX_SIZE){
+			myTooLarge = true;
+			::close(fd);
+			return false;
+		}
+		mySize = static_cast<size_t>(info.st_size);
+		if (mySize == 0){
+			myMapped = true;
+			myData = "";
+			::close(fd);
+			return true;
+		}
+		void * map = mmap(nullptr, mySize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED){
+			madvise(map, mySize, MADV_SEQUENTIAL);
+			myMapped = true;
+			myData = static_cast<const char *>(map);
+			::close(fd);
+			return true;
+		}
+		mySize = 0;
+	}
+	::close(fd);
+
+	//Not something we can map; read it as a stream instead
+	myFileStream.open(path);
+	if (!myFileStream.good()){ return false; }
+	myStream = &myFileStream;
+	return true;
+}
+
+void SourceFile::view(const char * data, size_t size){
+	close();
+	myPath = "";
+	myMapped = true;
+	myBorrowed = true;
+	myData = data;
+	mySize = size;
+}
+
+void SourceFile::close(){
+	if (myMapped && !myBorrowed && mySize > 0){
+		munmap(const_cast<char *>(myData), mySize);
+	}
+	if (myFileStream.is_open()){ myFileStream.close(); }
+	myFileStream.clear();
+	myMapped = false;
+	myBorrowed = false;
+	myTooLarge = false;
+	myData = nullptr;
+	mySize = 0;
+	myStream = nullptr;
+}
+
+} //End namespace cshanty
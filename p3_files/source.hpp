@@ -0,0 +1,95 @@
+#ifndef CSHANTY_SOURCE_H
+#define CSHANTY_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+namespace cshanty{
+
+/**
+* \class StringRef
+* A non-owning view of characters, used for lexemes that point
+* straight into the (mapped) source text. Stands in for
+* std::string_view, which isn't available under C++14.
+**/
+class StringRef{
+public:
+	StringRef() : myData(""), mySize(0){ }
+	StringRef(const char * data, size_t size)
+	: myData(data), mySize(size){ }
+	const char * data() const { return myData; }
+	size_t size() const { return mySize; }
+	bool empty() const { return mySize == 0; }
+	char operator[](size_t i) const { return myData[i]; }
+	std::string str() const { return std::string(myData, mySize); }
+	bool operator==(const StringRef& o) const {
+		return mySize == o.mySize && memcmp(myData, o.myData, mySize) == 0;
+	}
+	bool operator!=(const StringRef& o) const { return !(*this == o); }
+private:
+	const char * myData;
+	size_t mySize;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const StringRef& ref){
+	return out.write(ref.data(), static_cast<std::streamsize>(ref.size()));
+}
+
+/**
+* \class SourceFile
+* The text of an input file. Regular files are mmap'd read-only and
+* scanned in place; anything that can't be mapped (pipes, terminals,
+* or "-" for stdin) falls back to being read as a stream, in which
+* case data() is null and lexemes are copied out by the scanner.
+**/
+class SourceFile{
+public:
+	SourceFile();
+	~SourceFile();
+	SourceFile(const SourceFile&) = delete;
+	SourceFile& operator=(const SourceFile&) = delete;
+
+	/**
+	* Positions are 32-bit byte offsets (position.hpp), so a source
+	* can be at most this long
+	**/
+	static const size_t MAX_SIZE = UINT32_MAX;
+
+	/**
+	* Returns false if the file can't be opened at all, or if it is
+	* a regular file longer than MAX_SIZE (tooLarge() then says so)
+	**/
+	bool open(const char * path);
+	bool tooLarge() const { return myTooLarge; }
+	/**
+	* Use size bytes at data, which the caller keeps alive, as the
+	* text. It is treated like a mapped file.
+	**/
+	void view(const char * data, size_t size);
+	void close();
+
+	bool mapped() const { return myMapped; }
+	const char * data() const { return myData; }
+	size_t size() const { return mySize; }
+	/** The stream to scan from when the file isn't mapped **/
+	std::istream * stream() const { return myStream; }
+	const std::string& path() const { return myPath; }
+private:
+	std::string myPath;
+	bool myMapped;
+	//Text supplied by view(), which isn't ours to unmap
+	bool myBorrowed;
+	bool myTooLarge;
+	const char * myData;
+	size_t mySize;
+	std::ifstream myFileStream;
+	std::istream * myStream;
+};
+
+} //End namespace cshanty
+
+#endif
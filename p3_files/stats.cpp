@@ -0,0 +1,318 @@
+#ifndef CSHANTY_NO_STATS
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <time.h>
+#include <sys/resource.h>
+#include "stats.hpp"
+#include "grammar.hh"
+#include "visitor.hpp"
+
+namespace cshanty{
+
+static double wallMs(){
+	std::chrono::duration<double, std::milli> now =
+		std::chrono::steady_clock::now().time_since_epoch();
+	return now.count();
+}
+
+/*
+CPU time of the whole process, so the threads
+of a parallel unparse are all counted
+*/
+static double cpuMs(){
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return static_cast<double>(now.tv_sec) * 1e3
+	  + static_cast<double>(now.tv_nsec) / 1e6;
+}
+
+static size_t peakRssKB(){
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0){ return 0; }
+	return static_cast<size_t>(usage.ru_maxrss);
+}
+
+Stats::Phase::Phase(Stats * stats, const char * name)
+: myStats(stats), myName(name), myWallStart(0), myCpuStart(0){
+	if (myStats == nullptr){ return; }
+	myWallStart = wallMs();
+	myCpuStart = cpuMs();
+}
+
+Stats::Phase::~Phase(){
+	if (myStats == nullptr){ return; }
+	myStats->addPhase(myName, wallMs() - myWallStart, cpuMs() - myCpuStart);
+}
+
+/*
+A phase run more than once (the AST cache is
+read and then written, say) is reported once
+*/
+void Stats::addPhase(const char * name, double wallMs, double cpuMs){
+	for (PhaseTime& phase : myPhases){
+		if (phase.name == std::string(name)){
+			phase.wallMs += wallMs;
+			phase.cpuMs += cpuMs;
+			return;
+		}
+	}
+	myPhases.push_back(PhaseTime{name, wallMs, cpuMs});
+}
+
+using TokenKind = cshanty::Parser::token;
+
+/*
+Names for the per-kind token counts, for every kind the grammar
+declares (AND through WHILE, in order). tokenKindName() is what -t
+prints, and has none for RECORD
+*/
+static const char * const TOKEN_NAMES[] = {
+	"AND", "ASSIGN", "BOOL", "CLOSE", "COMMA", "DEC", "DIVIDE", "ELSE",
+	"EQUALS", "FALSE", "GREATER", "GREATEREQ", "ID", "IF", "INC",
+	"INT", "INTLITERAL", "LBRACE", "LESS", "LESSEQ", "LPAREN", "MINUS",
+	"NOT", "NOTEQUALS", "OPEN", "OR", "PLUS", "RBRACE", "RECEIVE",
+	"RECORD", "REPORT", "RETURN", "RPAREN", "SEMICOL", "STRING",
+	"STRINGLITERAL", "TIMES", "TRUE", "VOID", "WHILE"
+};
+static_assert(sizeof(TOKEN_NAMES) / sizeof(TOKEN_NAMES[0])
+  == TokenKind::WHILE - TokenKind::AND + 1, "A token kind has no name");
+
+static const char * tokenName(int kind){
+	if (kind == TokenKind::END){ return "EOF"; }
+	if (kind < TokenKind::AND || kind > TokenKind::WHILE){ return "OTHER"; }
+	return TOKEN_NAMES[kind - TokenKind::AND];
+}
+
+void Stats::countTokens(const std::vector<Token *>& tokens){
+	myTokens = tokens.size();
+	myTokenKinds.clear();
+	for (const Token * token : tokens){
+		myTokenKinds[tokenName(token->kind())]++;
+	}
+}
+
+void Stats::countList(const char * role, size_t length){
+	ListLengths& lengths = myLists[role];
+	lengths.lists++;
+	lengths.elements += length;
+	if (length > lengths.longest){ lengths.longest = length; }
+}
+
+/** Counts the nodes of a tree by class and its lists by role **/
+class StatsCounter : public AstVisitor<StatsCounter>{
+public:
+	StatsCounter(Stats& stats) : myStats(stats){ }
+
+	template <typename N>
+	void visitNode(N * node){
+		myStats.myNodes++;
+		myStats.myNodeKinds[node->kind()]++;
+		visitChildren(node);
+	}
+	template <typename N>
+	void visitProgram(N * node){
+		list("globals", node->globals());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitFnDecl(N * node){
+		list("formals", node->formals());
+		list("function bodies", node->body());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitRecordTypeDecl(N * node){
+		list("record fields", node->fields());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitIfElseStmt(N * node){
+		list("if bodies", node->thenBranch());
+		list("else bodies", node->elseBranch());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitIfStmt(N * node){
+		list("if bodies", node->body());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitWhileStmt(N * node){
+		list("while bodies", node->body());
+		visitNode(node);
+	}
+	template <typename N>
+	void visitCallExp(N * node){
+		list("call arguments", node->args());
+		visitNode(node);
+	}
+private:
+	template <typename L>
+	void list(const char * role, const L * elts){
+		if (elts != nullptr){ myStats.countList(role, elts->size()); }
+	}
+
+	Stats& myStats;
+};
+
+void Stats::countTree(const ProgramNode * root){
+	myNodes = 0;
+	for (size_t& count : myNodeKinds){ count = 0; }
+	myLists.clear();
+	StatsCounter counter(*this);
+	counter.visit(root);
+}
+
+void Stats::countArena(const Arena& arena){
+	myArenaBytes = arena.bytesUsed();
+	myArenaAllocs = arena.allocations();
+	myArenaReserved = arena.bytesReserved();
+}
+
+double Stats::instructionsPerSecond() const {
+	for (const PhaseTime& phase : myPhases){
+		if (strcmp(phase.name, "run") == 0 && phase.wallMs > 0){
+			return static_cast<double>(myInstructions) * 1000 / phase.wallMs;
+		}
+	}
+	return 0;
+}
+
+void Stats::writeText(std::ostream& out) const {
+	std::ios::fmtflags flags = out.flags();
+	out << "stats for " << myPath << ": " << myBytes << " bytes\n";
+	out << std::fixed << std::setprecision(3);
+	out << "  " << std::left << std::setw(24) << "phase"
+	<< std::right << std::setw(12) << "wall ms"
+	<< std::setw(12) << "cpu ms" << "\n";
+	for (const PhaseTime& phase : myPhases){
+		out << "  " << std::left << std::setw(24) << phase.name
+		<< std::right << std::setw(12) << phase.wallMs
+		<< std::setw(12) << phase.cpuMs << "\n";
+	}
+	out << "  tokens: " << myTokens << "\n";
+	for (const auto& kind : myTokenKinds){
+		out << "    " << std::left << std::setw(22) << kind.first
+		<< std::right << std::setw(12) << kind.second << "\n";
+	}
+	out << "  nodes: " << myNodes << "\n";
+	for (size_t k = 0; k < KIND_LIMIT; k++){
+		if (myNodeKinds[k] == 0){ continue; }
+		out << "    " << std::left << std::setw(22)
+		<< nodeKindName(static_cast<NodeKind>(k))
+		<< std::right << std::setw(12) << myNodeKinds[k] << "\n";
+	}
+	out << "  " << std::left << std::setw(24) << "lists"
+	<< std::right << std::setw(12) << "count"
+	<< std::setw(12) << "elements" << std::setw(12) << "longest" << "\n";
+	for (const auto& role : myLists){
+		out << "    " << std::left << std::setw(22) << role.first
+		<< std::right << std::setw(12) << role.second.lists
+		<< std::setw(12) << role.second.elements
+		<< std::setw(12) << role.second.longest << "\n";
+	}
+	out << "  arena: " << myArenaBytes << " bytes in "
+	<< myArenaAllocs << " allocations, "
+	<< myArenaReserved << " bytes reserved\n";
+	if (myHaveTypes){ out << "  types: " << myTypes << "\n"; }
+	if (myHaveRun){
+		out << "  instructions: " << myInstructions << ", "
+		<< instructionsPerSecond() / 1e6 << " M/s\n";
+	}
+	if (!myJitFunctions.empty()){
+		out << "  " << std::left << std::setw(24) << "jit functions"
+		<< std::right << std::setw(12) << "compile ms"
+		<< std::setw(12) << "bytes" << "\n";
+		for (const JitFunction& fn : myJitFunctions){
+			out << "    " << std::left << std::setw(22) << fn.name
+			<< std::right << std::setw(12) << fn.compileMs
+			<< std::setw(12) << fn.bytes << "\n";
+		}
+	}
+	out << "  peak RSS: " << peakRssKB() << " KB\n";
+	out.flags(flags);
+	if (myHaveMemory){ myMemory.writeText(out); }
+}
+
+static void writeJSONString(std::ostream& out, const std::string& str){
+	out << '"';
+	for (char c : str){
+		if (c == '"' || c == '\\'){
+			out << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20){
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+			<< static_cast<int>(c) << std::dec << std::setfill(' ');
+		} else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+void Stats::writeJSON(std::ostream& out) const {
+	std::ios::fmtflags flags = out.flags();
+	out << std::fixed << std::setprecision(3);
+	out << "{\"file\": ";
+	writeJSONString(out, myPath);
+	out << ", \"bytes\": " << myBytes << ", \"phases\": [";
+	const char * sep = "";
+	for (const PhaseTime& phase : myPhases){
+		out << sep << "{\"name\": \"" << phase.name << "\", \"wall_ms\": "
+		<< phase.wallMs << ", \"cpu_ms\": " << phase.cpuMs << "}";
+		sep = ", ";
+	}
+	out << "], \"tokens\": {\"total\": " << myTokens << ", \"kinds\": {";
+	sep = "";
+	for (const auto& kind : myTokenKinds){
+		out << sep << "\"" << kind.first << "\": " << kind.second;
+		sep = ", ";
+	}
+	out << "}}, \"nodes\": {\"total\": " << myNodes << ", \"classes\": {";
+	sep = "";
+	for (size_t k = 0; k < KIND_LIMIT; k++){
+		if (myNodeKinds[k] == 0){ continue; }
+		out << sep << "\"" << nodeKindName(static_cast<NodeKind>(k))
+		<< "\": " << myNodeKinds[k];
+		sep = ", ";
+	}
+	out << "}}, \"lists\": {";
+	sep = "";
+	for (const auto& role : myLists){
+		out << sep << "\"" << role.first << "\": {\"count\": "
+		<< role.second.lists << ", \"elements\": " << role.second.elements
+		<< ", \"longest\": " << role.second.longest << "}";
+		sep = ", ";
+	}
+	out << "}, \"arena\": {\"bytes\": " << myArenaBytes
+	<< ", \"allocations\": " << myArenaAllocs
+	<< ", \"reserved\": " << myArenaReserved << "}";
+	if (myHaveMemory){
+		out << ", \"memory\": ";
+		myMemory.writeJSON(out);
+	}
+	if (myHaveTypes){ out << ", \"types\": " << myTypes; }
+	if (myHaveRun){
+		out << ", \"instructions\": " << myInstructions
+		<< ", \"instructions_per_sec\": " << instructionsPerSecond();
+	}
+	if (!myJitFunctions.empty()){
+		out << ", \"jit_functions\": [";
+		sep = "";
+		for (const JitFunction& fn : myJitFunctions){
+			out << sep << "{\"name\": ";
+			writeJSONString(out, fn.name);
+			out << ", \"compile_ms\": " << fn.compileMs
+			<< ", \"bytes\": " << fn.bytes << "}";
+			sep = ", ";
+		}
+		out << "]";
+	}
+	out << ", \"peak_rss_kb\": " << peakRssKB() << "}\n";
+	out.flags(flags);
+}
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef CSHANTY_STATS_H
+#define CSHANTY_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "arena.hpp"
+#include "ast.hpp"
+#include "astmemory.hpp"
+
+namespace cshanty{
+
+/**
+* \class Stats
+* What -stats reports about one compilation: the wall and CPU time
+* of each phase the driver runs, tokens by kind, AST nodes by class,
+* the lengths of each sort of list, arena allocations, the AST's
+* memory by class (see AstMemory), the instructions executed under
+* -run, the compile time and size of each function under -jit and
+* the process's peak RSS, as text or as JSON.
+*
+* The counts are taken after the fact, from the recorded tokens and
+* a walk over the finished tree, so Scanner::yylex and the parser
+* actions carry no counters at all. Built with CSHANTY_NO_STATS
+* (make STATS=0) the class is an empty shell whose members are
+* inline no-ops, and the timers compile to nothing.
+**/
+class Stats{
+public:
+#ifndef CSHANTY_NO_STATS
+	/** Times a phase of stats from construction to destruction **/
+	class Phase{
+	public:
+		// A null stats makes the timer a no-op
+		Phase(Stats * stats, const char * name);
+		~Phase();
+	private:
+		Stats * myStats;
+		const char * myName;
+		double myWallStart;
+		double myCpuStart;
+	};
+
+	Stats(const char * path) : myPath(path), myBytes(0), myTokens(0),
+	  myNodes(0), myArenaBytes(0), myArenaAllocs(0), myArenaReserved(0){ }
+
+	void setSourceBytes(size_t bytes){ myBytes = bytes; }
+	void countTokens(const std::vector<Token *>& tokens);
+	void countTree(const ProgramNode * root);
+	void countArena(const Arena& arena);
+	void setMemory(const AstMemory& memory){
+		myMemory = memory;
+		myHaveMemory = true;
+	}
+	/** Distinct types the type checker made (TypeTable::size()) **/
+	void setTypes(size_t count){
+		myTypes = count;
+		myHaveTypes = true;
+	}
+	/** Instructions the VM executed, over the "run" phase **/
+	void setInstructions(uint64_t count){
+		myInstructions = count;
+		myHaveRun = true;
+	}
+
+	/** A function -jit compiled, the time it took and its size **/
+	void addJitFunction(const std::string& name, double compileMs,
+		size_t bytes){
+		myJitFunctions.push_back(JitFunction{name, compileMs, bytes});
+	}
+
+	void writeText(std::ostream& out) const;
+	void writeJSON(std::ostream& out) const;
+
+	/** Whether this build can collect statistics at all **/
+	static bool available(){ return true; }
+private:
+	friend class StatsCounter;
+
+	struct PhaseTime{
+		const char * name;
+		double wallMs;
+		double cpuMs;
+	};
+	struct JitFunction{
+		std::string name;
+		double compileMs;
+		size_t bytes;
+	};
+	struct ListLengths{
+		size_t lists = 0;
+		size_t elements = 0;
+		size_t longest = 0;
+	};
+
+	void addPhase(const char * name, double wallMs, double cpuMs);
+	void countList(const char * role, size_t length);
+	double instructionsPerSecond() const;
+
+	std::string myPath;
+	size_t myBytes;
+	std::vector<PhaseTime> myPhases;
+	size_t myTokens;
+	std::map<std::string, size_t> myTokenKinds;
+	size_t myNodes;
+	size_t myNodeKinds[KIND_LIMIT] = {};
+	std::map<std::string, ListLengths> myLists;
+	size_t myArenaBytes;
+	size_t myArenaAllocs;
+	size_t myArenaReserved;
+	AstMemory myMemory;
+	bool myHaveMemory = false;
+	size_t myTypes = 0;
+	bool myHaveTypes = false;
+	uint64_t myInstructions = 0;
+	bool myHaveRun = false;
+	std::vector<JitFunction> myJitFunctions;
+#else
+	class Phase{
+	public:
+		Phase(Stats *, const char *){ }
+	};
+
+	Stats(const char *){ }
+	void setSourceBytes(size_t){ }
+	void countTokens(const std::vector<Token *>&){ }
+	void countTree(const ProgramNode *){ }
+	void countArena(const Arena&){ }
+	void setMemory(const AstMemory&){ }
+	void setTypes(size_t){ }
+	void setInstructions(uint64_t){ }
+	void addJitFunction(const std::string&, double, size_t){ }
+	void writeText(std::ostream&) const { }
+	void writeJSON(std::ostream&) const { }
+	static bool available(){ return false; }
+#endif
+};
+
+}
+
+#endif
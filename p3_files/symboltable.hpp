@@ -0,0 +1,135 @@
+#ifndef CSHANTY_SYMBOLTABLE_H
+#define CSHANTY_SYMBOLTABLE_H
+
+#include <cstdint>
+#include <vector>
+#include "ast.hpp"
+
+namespace cshanty{
+
+/**
+* \class SymbolMap
+* An open-addressing (linear probing) hash table from 64-bit keys,
+* symbol ids or pairs of them, to declarations. Slots carry the epoch
+* in which they were filled, so clear() empties the table in O(1) by
+* starting a new epoch, and a cleared table keeps its slots for reuse.
+**/
+class SymbolMap{
+public:
+	SymbolMap() : myEpoch(1), myCount(0), myShift(61), mySlots(8){ }
+
+	DeclNode * find(uint64_t key) const {
+		size_t mask = mySlots.size() - 1;
+		for (size_t i = slot(key); ; i = (i + 1) & mask){
+			const Slot& s = mySlots[i];
+			if (s.epoch != myEpoch){ return nullptr; }
+			if (s.key == key){ return s.decl; }
+		}
+	}
+
+	/** Add key, unless it is already there. Returns what is there **/
+	DeclNode * insert(uint64_t key, DeclNode * decl){
+		size_t mask = mySlots.size() - 1;
+		for (size_t i = slot(key); ; i = (i + 1) & mask){
+			Slot& s = mySlots[i];
+			if (s.epoch == myEpoch){
+				if (s.key == key){ return s.decl; }
+				continue;
+			}
+			s = Slot{key, myEpoch, decl};
+			if (++myCount * 2 > mySlots.size()){ grow(); }
+			return decl;
+		}
+	}
+
+	void clear(){
+		myCount = 0;
+		//On the (very) rare wrap, stale slots must really go
+		if (++myEpoch == 0){
+			for (Slot& s : mySlots){ s.epoch = 0; }
+			myEpoch = 1;
+		}
+	}
+
+	size_t size() const { return myCount; }
+private:
+	struct Slot{
+		uint64_t key;
+		uint32_t epoch;
+		DeclNode * decl;
+	};
+
+	//Fibonacci hashing: symbol ids are dense, so spread them
+	size_t slot(uint64_t key) const {
+		return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> myShift);
+	}
+
+	void grow(){
+		std::vector<Slot> old(mySlots.size() * 2);
+		old.swap(mySlots);
+		myShift--;
+		size_t mask = mySlots.size() - 1;
+		for (const Slot& s : old){
+			if (s.epoch != myEpoch){ continue; }
+			size_t i = slot(s.key);
+			while (mySlots[i].epoch == myEpoch){ i = (i + 1) & mask; }
+			mySlots[i] = s;
+		}
+	}
+
+	uint32_t myEpoch;
+	size_t myCount;
+	unsigned myShift;
+	//Size is a power of 2, and 64 - myShift is its log
+	std::vector<Slot> mySlots;
+};
+
+/**
+* \class SymbolTable
+* Nested scopes of declarations, innermost last. Each scope is its own
+* SymbolMap; the maps are kept when their scope closes and reused by
+* the next scope opened at that depth, so entering and leaving a scope
+* are O(1) and allocate nothing once the deepest nesting has been
+* seen. A lookup tries each open scope from the innermost out.
+**/
+class SymbolTable{
+public:
+	SymbolTable() : myDepth(0){ }
+
+	void enter(){
+		if (myDepth == myScopes.size()){
+			myScopes.emplace_back();
+		} else {
+			myScopes[myDepth].clear();
+		}
+		myDepth++;
+	}
+
+	void leave(){ myDepth--; }
+
+	size_t depth() const { return myDepth; }
+
+	/**
+	* Declare name in the innermost scope. Returns the declaration
+	* already there, if there was one, and decl otherwise
+	**/
+	DeclNode * declare(Symbol name, DeclNode * decl){
+		return myScopes[myDepth - 1].insert(name.id(), decl);
+	}
+
+	/** The innermost declaration of name, or null **/
+	DeclNode * lookup(Symbol name) const {
+		for (size_t i = myDepth; i > 0; i--){
+			DeclNode * decl = myScopes[i - 1].find(name.id());
+			if (decl != nullptr){ return decl; }
+		}
+		return nullptr;
+	}
+private:
+	std::vector<SymbolMap> myScopes;
+	size_t myDepth;
+};
+
+}
+
+#endif
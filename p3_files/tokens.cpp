@@ -6,7 +6,7 @@ namespace cshanty{
 using TokenKind = cshanty::Parser::token;
 using Lexeme = cshanty::Parser::semantic_type;
 
-static std::string tokenKindString(int tokKind){
+const char * tokenKindName(int tokKind){
 	switch(tokKind){
 		case TokenKind::END: return "EOF";
 		case TokenKind::AND: return "AND";
@@ -54,56 +54,65 @@ static std::string tokenKindString(int tokKind){
 	
 }
 
-Token::Token(Position * posIn, int kindIn)
+Token::Token(Position posIn, int kindIn)
   : myPos(posIn), myKind(kindIn){
 }
 
-std::string Token::toString(){
-	return tokenKindString(kind())
-	+ " " + myPos->begin();
+void Token::writePos(Writer& out, LineCursor& lines) const {
+	lines.seek(myPos.start());
+	out << " [" << lines.line() << ","
+	<< lines.col(myPos.start()) << "]";
+}
+
+void Token::write(Writer& out, LineCursor& lines) const {
+	out << tokenKindName(kind());
+	writePos(out, lines);
 }
 
 int Token::kind() const { 
 	return this->myKind; 
 }
 
-Position * Token::pos() const {
+const Position& Token::pos() const {
 	return myPos;
 }
 
-IDToken::IDToken(Position * posIn, std::string vIn)
+void Token::shift(int32_t delta){
+	myPos.shift(delta);
+}
+
+IDToken::IDToken(Position posIn, Symbol vIn)
   : Token(posIn, TokenKind::ID), myValue(vIn){ 
 }
 
-std::string IDToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ myValue + " " + myPos->begin();
+void IDToken::write(Writer& out, LineCursor& lines) const {
+	out << tokenKindName(kind()) << ':' << myValue;
+	writePos(out, lines);
 }
 
-const std::string IDToken::value() const { 
+Symbol IDToken::value() const { 
 	return this->myValue; 
 }
 
-StrToken::StrToken(Position * posIn, std::string sIn)
+StrToken::StrToken(Position posIn, StringRef sIn)
   : Token(posIn, TokenKind::STRLITERAL), myStr(sIn){
 }
 
-std::string StrToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ this->myStr + " " + myPos->begin();
+void StrToken::write(Writer& out, LineCursor& lines) const {
+	out << tokenKindName(kind()) << ':' << myStr;
+	writePos(out, lines);
 }
 
-const std::string StrToken::str() const {
+StringRef StrToken::str() const {
 	return this->myStr;
 }
 
-IntLitToken::IntLitToken(Position * pos, int numIn)
+IntLitToken::IntLitToken(Position pos, int numIn)
   : Token(pos, TokenKind::INTLITERAL), myNum(numIn){}
 
-std::string IntLitToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ std::to_string(this->myNum) + " "
-	+ myPos->begin();
+void IntLitToken::write(Writer& out, LineCursor& lines) const {
+	out << tokenKindName(kind()) << ':' << myNum;
+	writePos(out, lines);
 }
 
 int IntLitToken::num() const {
@@ -3,46 +3,54 @@
 
 #include <string>
 #include "position.hpp"
+#include "interner.hpp"
+#include "source.hpp"
+#include "writer.hpp"
 
 namespace cshanty{
 
+/** The name a token of kind tokKind is listed under ("ID") **/
+const char * tokenKindName(int tokKind);
+
 class Token{
 public:
-	Token(Position * pos, int kindIn);
-	virtual std::string toString();
-	size_t line() const;
-	size_t col() const;
+	Token(Position pos, int kindIn);
+	/** Write the token as -t lists it: kind, any value, [line,col] **/
+	virtual void write(Writer& out, LineCursor& lines) const;
 	int kind() const;
-	Position * pos() const;
+	const Position& pos() const;
+	/** Move the token by delta bytes, as after an edit before it **/
+	void shift(int32_t delta);
 protected:
-	Position * myPos;
+	void writePos(Writer& out, LineCursor& lines) const;
+	Position myPos;
 private:
 	const int myKind;
 };
 
 class IDToken : public Token{
 public:
-	IDToken(Position * posIn, std::string valIn);
-	const std::string value() const;
-	virtual std::string toString() override;
+	IDToken(Position posIn, Symbol valIn);
+	Symbol value() const;
+	virtual void write(Writer& out, LineCursor& lines) const override;
 private:
-	const std::string myValue;
+	const Symbol myValue;
 	
 };
 
 class StrToken : public Token{
 public:
-	StrToken(Position * posIn, std::string valIn);
-	virtual std::string toString() override;
-	const std::string str() const;
+	StrToken(Position posIn, StringRef valIn);
+	virtual void write(Writer& out, LineCursor& lines) const override;
+	StringRef str() const;
 private:
-	const std::string myStr;
+	const StringRef myStr;
 };
 
 class IntLitToken : public Token{
 public:
-	IntLitToken(Position * posIn, int numIn);
-	virtual std::string toString() override;
+	IntLitToken(Position posIn, int numIn);
+	virtual void write(Writer& out, LineCursor& lines) const override;
 	int num() const;
 private:
 	const int myNum;
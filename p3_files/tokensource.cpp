@@ -0,0 +1,38 @@
+#include <climits>
+#include "tokensource.hpp"
+
+namespace cshanty{
+
+/*
+The END token is printed as EOF, positioned
+just past the last character of the input
+*/
+void TokenSource::writeTokens(const std::vector<Token *>& tokens,
+	const LineTable& lines, Writer& out){
+	LineCursor cursor(lines);
+	for (auto token : tokens){
+		token->write(out, cursor);
+		out << '\n';
+	}
+}
+
+/*
+A single pass with no copies: a digit is only added once it's
+known not to take the value past INT_MAX. Leading zeros cost
+nothing, so any number of them is fine.
+*/
+bool TokenSource::intLitValue(const char * digits, size_t len, int * value){
+	uint32_t result = 0;
+	for (size_t i = 0; i < len; i++){
+		uint32_t digit = static_cast<uint32_t>(digits[i] - '0');
+		if (result > (INT_MAX - digit) / 10){
+			*value = INT_MAX;
+			return false;
+		}
+		result = result * 10 + digit;
+	}
+	*value = static_cast<int>(result);
+	return true;
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef CSHANTY_TOKENSOURCE_H
+#define CSHANTY_TOKENSOURCE_H
+
+#include <vector>
+#include "grammar.hh"
+#include "context.hpp"
+#include "errors.hpp"
+#include "writer.hpp"
+
+namespace cshanty{
+
+/**
+* \class TokenSource
+* Anything the parser can pull tokens from: the flex Scanner, the
+* hand-written FastScanner, a TokenReplay of a previously saved
+* token stream, or a TokenRun of tokens already in memory. Subclasses produce
+* tokens in lex(); this class handles what is common to all of them,
+* such as recording the tokens handed out.
+**/
+class TokenSource{
+public:
+	TokenSource(CompilationContext& ctx)
+	: myCtx(ctx), myRecord(nullptr), myDone(false){ }
+	virtual ~TokenSource(){ }
+
+	// The entry point used by the parser. Once the end of input has
+	// been reached it keeps returning END without asking for more
+	int yylex(cshanty::Parser::semantic_type * const lval){
+		if (myDone){ return Parser::token::END; }
+		int kind = lex(lval);
+		if (kind == Parser::token::END){ myDone = true; }
+		if (myRecord != nullptr){ myRecord->push_back(lval->lexeme); }
+		return kind;
+	}
+
+	// When set, every token handed out (including the final END) is
+	// also appended to tokens, so one scan can feed both the parser
+	// and the token listing
+	void record(std::vector<Token *> * tokens){ myRecord = tokens; }
+
+	// Pull (and record) whatever tokens have not been consumed yet
+	void drain(){
+		cshanty::Parser::semantic_type lval;
+		while (yylex(&lval) != Parser::token::END){ }
+	}
+
+	Arena& arena(){ return myCtx.arena(); }
+	const LineTable& lines(){ return myCtx.lines(); }
+
+	/** The text token listing (-t) **/
+	static void writeTokens(const std::vector<Token *>& tokens,
+		const LineTable& lines, Writer& out);
+protected:
+	// Produce the next token in lval->lexeme, including a
+	// positioned Token for END, and return its kind
+	virtual int lex(cshanty::Parser::semantic_type * const lval) = 0;
+
+	// The value of a {DIGIT}+ literal, checked for overflow as it is
+	// read. A literal too large for an int gives false and INT_MAX
+	static bool intLitValue(const char * digits, size_t len, int * value);
+
+	// Lexical diagnostics, worded the same whichever scanner finds them
+	static void errIllegal(size_t l, size_t c, std::string match){
+		cshanty::Report::fatal(l, c, "Illegal character "
+			+ match);
+	}
+
+	static void errStrEsc(size_t l, size_t c){
+		cshanty::Report::fatal(l, c, "String literal with bad"
+		" escape sequence ignored");
+	}
+
+	static void errStrUnterm(size_t l, size_t c){
+		cshanty::Report::fatal(l, c, "Unterminated string"
+		" literal ignored");
+	}
+
+	static void errStrEscAndUnterm(size_t l, size_t c){
+		cshanty::Report::fatal(l, c, "Unterminated string literal"
+		" with bad escape sequence ignored");
+	}
+
+	static void errIntOverflow(size_t l, size_t c){
+		cshanty::Report::fatal(l, c, "Integer literal too large;"
+		" using max value");
+	}
+
+	// A source read as a stream can only be measured as it is read;
+	// past SourceFile::MAX_SIZE its positions would wrap around
+	[[noreturn]] static void errTooLarge(){
+		cshanty::Report::err() << "Input of 4GB or more, which"
+		" positions can't address" << std::endl;
+		throw new AbortError(1);
+	}
+
+	CompilationContext& myCtx;
+	std::vector<Token *> * myRecord;
+private:
+	bool myDone;
+};
+
+/**
+* \class TokenRun
+* Feeds the parser a run of already-scanned tokens, then END at
+* the given offset.
+**/
+class TokenRun : public TokenSource{
+public:
+	TokenRun(CompilationContext& ctx, const std::vector<Token *>& tokens,
+		uint32_t end)
+	: TokenSource(ctx), myTokens(tokens), myNext(0), myEnd(end){ }
+protected:
+	int lex(cshanty::Parser::semantic_type * const lval) override {
+		if (myNext == myTokens.size()){
+			lval->lexeme = new (arena()) Token(Position(myEnd, myEnd),
+				Parser::token::END);
+			return Parser::token::END;
+		}
+		lval->lexeme = myTokens[myNext++];
+		return lval->lexeme->kind();
+	}
+private:
+	const std::vector<Token *>& myTokens;
+	size_t myNext;
+	uint32_t myEnd;
+};
+
+}
+
+#endif
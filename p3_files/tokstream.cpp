@@ -0,0 +1,198 @@
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include "tokstream.hpp"
+
+namespace cshanty{
+
+using TokenKind = cshanty::Parser::token;
+
+static const char MAGIC[4] = {'C', 'S', 'T', 'K'};
+static const uint32_t VERSION = 1;
+
+static void putU32(Writer& out, uint32_t n){
+	out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+}
+
+static void putBytes(Writer& out, const char * data, size_t len){
+	putU32(out, static_cast<uint32_t>(len));
+	out.write(data, len);
+	size_t pad = (4 - len % 4) % 4;
+	if (pad > 0){ out.fill('\0', pad); }
+}
+
+void writeTokenStream(const std::vector<Token *>& tokens,
+	const LineTable& lines, Writer& out){
+	std::vector<TokenRecord> records;
+	std::vector<Symbol> symbols;
+	std::vector<StringRef> strings;
+	std::unordered_map<uint32_t, uint32_t> symbolIndex;
+	std::unordered_map<std::string, uint32_t> stringIndex;
+
+	records.reserve(tokens.size());
+	for (auto token : tokens){
+		TokenRecord rec;
+		rec.kind = static_cast<uint16_t>(token->kind());
+		rec.reserved = 0;
+		rec.start = token->pos().start();
+		rec.end = token->pos().end();
+		rec.payload = 0;
+		if (token->kind() == TokenKind::ID){
+			Symbol sym = static_cast<IDToken *>(token)->value();
+			auto it = symbolIndex.find(sym.id());
+			if (it == symbolIndex.end()){
+				uint32_t index = static_cast<uint32_t>(symbols.size());
+				it = symbolIndex.emplace(sym.id(), index).first;
+				symbols.push_back(sym);
+			}
+			rec.payload = it->second;
+		} else if (token->kind() == TokenKind::INTLITERAL){
+			int num = static_cast<IntLitToken *>(token)->num();
+			rec.payload = static_cast<uint32_t>(num);
+		} else if (token->kind() == TokenKind::STRLITERAL){
+			StringRef str = static_cast<StrToken *>(token)->str();
+			auto it = stringIndex.find(str.str());
+			if (it == stringIndex.end()){
+				uint32_t index = static_cast<uint32_t>(strings.size());
+				it = stringIndex.emplace(str.str(), index).first;
+				strings.push_back(str);
+			}
+			rec.payload = it->second;
+		}
+		records.push_back(rec);
+	}
+
+	TokenStreamHeader header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.tokens = static_cast<uint32_t>(records.size());
+	header.lines = static_cast<uint32_t>(lines.lines());
+	header.symbols = static_cast<uint32_t>(symbols.size());
+	header.strings = static_cast<uint32_t>(strings.size());
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	for (size_t line = 1; line <= lines.lines(); line++){
+		putU32(out, lines.start(line));
+	}
+	out.write(reinterpret_cast<const char *>(records.data()),
+		records.size() * sizeof(TokenRecord));
+	for (auto sym : symbols){ putBytes(out, sym.str(), sym.length()); }
+	for (auto str : strings){ putBytes(out, str.data(), str.size()); }
+}
+
+/*
+The grammar declares its tokens in one run, AND through WHILE, so
+those and END are the kinds a stream can hold.
+*/
+static bool knownKind(uint16_t kind){
+	return kind == TokenKind::END
+	  || (kind >= TokenKind::AND && kind <= TokenKind::WHILE);
+}
+
+bool TokenReplay::isTokenStream(const SourceFile& src){
+	return src.mapped() && src.size() >= sizeof(TokenStreamHeader)
+	  && memcmp(src.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+TokenReplay::TokenReplay(CompilationContext& ctx)
+: TokenSource(ctx), myValid(false), myRecords(nullptr),
+  myCount(0), myNext(0){
+	myValid = load();
+}
+
+/*
+Check the layout against the file size as we go, and turn the
+symbol and string tables into Symbols and views up front. Every
+record is then checked, so that lex() does no more than decode one
+and the parser only ever sees tokens it could have been given by a
+scanner.
+*/
+bool TokenReplay::load(){
+	const SourceFile& src = myCtx.source();
+	const char * cur = src.data();
+	const char * end = src.data() + src.size();
+	TokenStreamHeader header;
+	if (!isTokenStream(src)){ return false; }
+	memcpy(&header, cur, sizeof(header));
+	cur += sizeof(header);
+	if (header.version != VERSION || header.tokens == 0 || header.lines == 0){
+		return false;
+	}
+
+	uint64_t fixed = uint64_t(header.lines) * sizeof(uint32_t)
+	  + uint64_t(header.tokens) * sizeof(TokenRecord);
+	if (fixed > uint64_t(end - cur)){ return false; }
+	LineTable& lines = myCtx.lines();
+	lines.clear();
+	for (uint32_t i = 1; i < header.lines; i++){
+		uint32_t start;
+		memcpy(&start, cur + i * sizeof(uint32_t), sizeof(start));
+		lines.addLine(start);
+	}
+	cur += header.lines * sizeof(uint32_t);
+	myRecords = cur;
+	myCount = header.tokens;
+	cur += header.tokens * sizeof(TokenRecord);
+
+	uint32_t tableSizes[2] = { header.symbols, header.strings };
+	for (int table = 0; table < 2; table++){
+		for (uint32_t i = 0; i < tableSizes[table]; i++){
+			uint32_t len;
+			if (end - cur < 4){ return false; }
+			memcpy(&len, cur, sizeof(len));
+			cur += sizeof(len);
+			if (uint64_t(end - cur) < len){ return false; }
+			if (table == 0){
+				mySymbols.push_back(Interner::global().intern(cur, len));
+			} else {
+				myStrings.push_back(StringRef(cur, len));
+			}
+			cur += len + (4 - len % 4) % 4;
+			if (cur > end){ return false; }
+		}
+	}
+
+	for (uint32_t i = 0; i < myCount; i++){
+		TokenRecord rec;
+		memcpy(&rec, myRecords + i * sizeof(TokenRecord), sizeof(rec));
+		if (!knownKind(rec.kind) || rec.start > rec.end){ return false; }
+		if (rec.kind == TokenKind::ID && rec.payload >= mySymbols.size()){
+			return false;
+		}
+		if (rec.kind == TokenKind::STRLITERAL
+		  && rec.payload >= myStrings.size()){
+			return false;
+		}
+		if ((rec.kind == TokenKind::END) != (i + 1 == myCount)){
+			return false;
+		}
+	}
+	return true;
+}
+
+int TokenReplay::lex(cshanty::Parser::semantic_type * const lval){
+	if (!myValid || myNext >= myCount){
+		//Truncated or bad stream: just end it
+		uint32_t at = 0;
+		lval->lexeme = new (arena()) Token(Position(at, at), TokenKind::END);
+		return TokenKind::END;
+	}
+	TokenRecord rec;
+	memcpy(&rec, myRecords + myNext * sizeof(TokenRecord), sizeof(rec));
+	myNext++;
+
+	Position pos(rec.start, rec.end);
+	int kind = rec.kind;
+	if (kind == TokenKind::ID){
+		lval->transIDToken = new (arena()) IDToken(pos, mySymbols[rec.payload]);
+	} else if (kind == TokenKind::INTLITERAL){
+		int num = static_cast<int>(rec.payload);
+		lval->transIntToken = new (arena()) IntLitToken(pos, num);
+	} else if (kind == TokenKind::STRLITERAL){
+		lval->transStrToken = new (arena()) StrToken(pos, myStrings[rec.payload]);
+	} else {
+		lval->lexeme = new (arena()) Token(pos, kind);
+	}
+	return kind;
+}
+
+}
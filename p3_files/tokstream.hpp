@@ -0,0 +1,83 @@
+#ifndef CSHANTY_TOKSTREAM_H
+#define CSHANTY_TOKSTREAM_H
+
+#include <vector>
+#include "tokensource.hpp"
+#include "tokens.hpp"
+
+namespace cshanty{
+
+/*
+Binary token stream layout. All integers are 32-bit in host byte
+order; every section starts 4-byte aligned.
+
+  header   magic "CSTK", version, then counts of tokens, lines,
+           symbols and strings
+  lines    start offset of each line (the scanner's LineTable)
+  tokens   16 bytes each: kind (16 bits, the parser's token number),
+           16 reserved bits, start and end offsets, and a payload:
+             ID          index into the symbol table
+             INTLITERAL  the value itself
+             STRLITERAL  index into the string table
+             otherwise   0
+  symbols  per distinct identifier: length, then the bytes
+  strings  per distinct string literal: length, then the bytes,
+           padded to a multiple of 4
+
+The final token is always END. Token kinds are only meaningful to a
+parser built from the same grammar, so caches should be keyed on the
+compiler build as well as the source.
+*/
+struct TokenStreamHeader{
+	char magic[4];
+	uint32_t version;
+	uint32_t tokens;
+	uint32_t lines;
+	uint32_t symbols;
+	uint32_t strings;
+};
+
+struct TokenRecord{
+	uint16_t kind;
+	uint16_t reserved;
+	uint32_t start;
+	uint32_t end;
+	uint32_t payload;
+};
+
+/** Write tokens (ending in END) in the binary format to out **/
+void writeTokenStream(const std::vector<Token *>& tokens,
+	const LineTable& lines, Writer& out);
+
+/**
+* \class TokenReplay
+* Feeds the parser from a binary token stream open in ctx.source(),
+* so a previously lexed file can be parsed without running flex.
+* The stream's line table is loaded into the context so positions
+* print as they did originally, and string literals are views into
+* the (mapped) stream file.
+**/
+class TokenReplay : public TokenSource{
+public:
+	/** True if src holds a binary token stream **/
+	static bool isTokenStream(const SourceFile& src);
+
+	TokenReplay(CompilationContext& ctx);
+	/** False if the stream was truncated or malformed **/
+	bool valid() const { return myValid; }
+protected:
+	int lex(cshanty::Parser::semantic_type * const lval) override;
+private:
+	bool load();
+
+	bool myValid;
+	const char * myRecords;
+	uint32_t myCount;
+	uint32_t myNext;
+	std::vector<Symbol> mySymbols;
+	std::vector<StringRef> myStrings;
+};
+
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include <sys/stat.h>
+#include "treecache.hpp"
+#include "astcache.hpp"
+
+namespace cshanty{
+
+/* -1 if path can't be examined */
+static int64_t modified(const std::string& path){
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0){ return -1; }
+	return int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+static std::string keyOf(const std::string& path, bool optimized){
+	return optimized ? path + '\0' + "O" : path;
+}
+
+ProgramNode * TreeCache::find(const std::string& path,
+	const SourceFile& source, bool optimized, Arena& arena,
+	std::string& diagnostics){
+	//A copy, since another request may drop the entry once the lock
+	// is let go; the tree is rebuilt from it outside the lock
+	FlatAST flat;
+	{
+		std::lock_guard<std::mutex> hold(myLock);
+		if (!findLocked(path, source, optimized, flat, diagnostics)){
+			return nullptr;
+		}
+	}
+	return flat.toTree(arena);
+}
+
+bool TreeCache::findLocked(const std::string& path,
+	const SourceFile& source, bool optimized, FlatAST& flat,
+	std::string& diagnostics){
+	auto found = myIndex.find(keyOf(path, optimized));
+	if (found == myIndex.end()){
+		myMisses++;
+		return false;
+	}
+	EntryRef entry = found->second;
+	int64_t mtime = modified(path);
+	bool same = mtime >= 0 && entry->text.size() == source.size();
+	if (same && mtime != entry->mtimeNs){
+		same = AstCache::hash(source.data(), source.size()) == entry->hash;
+		entry->mtimeNs = mtime;
+	}
+	if (!same){
+		drop(entry);
+		myMisses++;
+		return false;
+	}
+	myEntries.splice(myEntries.begin(), myEntries, entry);
+	myHits++;
+	diagnostics = entry->diagnostics;
+	flat = entry->flat;
+	return flat.rebase(entry->text.data(), entry->text.size(), source.data());
+}
+
+void TreeCache::store(const std::string& path, const SourceFile& source,
+	bool optimized, const FlatAST& flat, const std::string& diagnostics){
+	std::string key = keyOf(path, optimized);
+	std::lock_guard<std::mutex> hold(myLock);
+	auto found = myIndex.find(key);
+	if (found != myIndex.end()){ drop(found->second); }
+	int64_t mtime = modified(path);
+	size_t bytes = sizeof(Entry) + 2 * key.size() + source.size()
+	  + flat.bytes() + diagnostics.size();
+	if (mtime < 0 || bytes > myCap){ return; }
+
+	myEntries.emplace_front();
+	Entry& entry = myEntries.front();
+	entry.key = key;
+	entry.mtimeNs = mtime;
+	entry.hash = AstCache::hash(source.data(), source.size());
+	entry.text.assign(source.data(), source.data() + source.size());
+	entry.flat = flat;
+	entry.diagnostics = diagnostics;
+	if (!entry.flat.rebase(source.data(), source.size(), entry.text.data())){
+		myEntries.pop_front();
+		return;
+	}
+	entry.bytes = bytes;
+	myBytes += bytes;
+	myIndex.emplace(key, myEntries.begin());
+	while (myBytes > myCap){ drop(std::prev(myEntries.end())); }
+}
+
+size_t TreeCache::entries() const {
+	std::lock_guard<std::mutex> hold(myLock);
+	return myEntries.size();
+}
+
+size_t TreeCache::bytes() const {
+	std::lock_guard<std::mutex> hold(myLock);
+	return myBytes;
+}
+
+size_t TreeCache::hits() const {
+	std::lock_guard<std::mutex> hold(myLock);
+	return myHits;
+}
+
+size_t TreeCache::misses() const {
+	std::lock_guard<std::mutex> hold(myLock);
+	return myMisses;
+}
+
+void TreeCache::drop(EntryRef entry){
+	myBytes -= entry->bytes;
+	myIndex.erase(entry->key);
+	myEntries.erase(entry);
+}
+
+}
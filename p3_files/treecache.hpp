@@ -0,0 +1,86 @@
+#ifndef CSHANTY_TREECACHE_H
+#define CSHANTY_TREECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "flatast.hpp"
+#include "source.hpp"
+
+namespace cshanty{
+
+/**
+* \class TreeCache
+* Flattened ASTs kept in memory between the requests of a compile
+* server (server.hpp), keyed on the path they were parsed from. An
+* entry is used while the file's modification time and size are
+* those it was stored with; when they aren't, a file whose content
+* hash still matches is used anyway (and the new time remembered),
+* and any other is dropped. Each entry keeps its own copy of the
+* source, which its identifiers and string literals point into,
+* and what the scan and parse reported, for a hit to report again.
+*
+* The entries' bytes (source, tree and bookkeeping) are held under
+* a cap by evicting the least recently used; a tree that alone
+* exceeds the cap isn't kept at all. Simplified (-O) trees are kept
+* apart from plain ones. Requests on several connections may use the
+* cache at once; each call holds a lock for its duration.
+**/
+class TreeCache{
+public:
+	TreeCache(size_t capBytes) : myCap(capBytes), myBytes(0),
+	  myHits(0), myMisses(0){ }
+	TreeCache(const TreeCache&) = delete;
+	TreeCache& operator=(const TreeCache&) = delete;
+
+	/**
+	* The tree for path, whose current text is source, if there is
+	* one, rebuilt in arena with its string literals pointing into
+	* source (so it outlives the entry), and the diagnostics its
+	* parse gave. Null if there is none
+	**/
+	ProgramNode * find(const std::string& path, const SourceFile& source,
+		bool optimized, Arena& arena, std::string& diagnostics);
+	/**
+	* Remember flat, just parsed from source for path with
+	* diagnostics reported
+	**/
+	void store(const std::string& path, const SourceFile& source,
+		bool optimized, const FlatAST& flat, const std::string& diagnostics);
+
+	size_t entries() const;
+	size_t bytes() const;
+	size_t hits() const;
+	size_t misses() const;
+private:
+	struct Entry{
+		std::string key;
+		int64_t mtimeNs;
+		uint64_t hash;
+		std::vector<char> text;
+		FlatAST flat;
+		std::string diagnostics;
+		size_t bytes;
+	};
+	typedef std::list<Entry>::iterator EntryRef;
+
+	bool findLocked(const std::string& path, const SourceFile& source,
+		bool optimized, FlatAST& flat, std::string& diagnostics);
+	void drop(EntryRef entry);
+
+	mutable std::mutex myLock;
+	size_t myCap;
+	size_t myBytes;
+	size_t myHits;
+	size_t myMisses;
+	//Most recently used first
+	std::list<Entry> myEntries;
+	std::unordered_map<std::string, EntryRef> myIndex;
+};
+
+}
+
+#endif
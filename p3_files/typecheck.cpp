@@ -0,0 +1,332 @@
+#include "typecheck.hpp"
+#include "errors.hpp"
+#include "visitor.hpp"
+
+namespace cshanty{
+
+/**
+* Checks types, as described in typecheck.hpp. Expression handlers
+* return the expression's type; statement and declaration handlers
+* return null.
+**/
+class TypeChecker : public AstVisitor<TypeChecker, const DataType *>{
+public:
+	TypeChecker(const LineTable& lines, TypeTable& types)
+	: myLines(lines), myTypes(types), myRet(nullptr), myOk(true){ }
+
+	bool ok() const { return myOk; }
+
+	//Declarations other than functions have nothing to check
+	template <typename N>
+	const DataType * visitNode(N * node){ return nullptr; }
+
+	const DataType * visitProgram(const ProgramNode * node){
+		visitChildren(node);
+		return nullptr;
+	}
+
+	const DataType * visitFnDecl(const FnDeclNode * node){
+		myRet = myTypes.of(node->type());
+		stmts(node->body());
+		return nullptr;
+	}
+
+	//Statements
+
+	const DataType * visitAssignStmt(const AssignStmtNode * node){
+		visit(node->assign());
+		return nullptr;
+	}
+
+	const DataType * visitCallStmt(const CallStmtNode * node){
+		visit(node->call());
+		return nullptr;
+	}
+
+	const DataType * visitIfStmt(const IfStmtNode * node){
+		condition(node->cond());
+		stmts(node->body());
+		return nullptr;
+	}
+
+	const DataType * visitIfElseStmt(const IfElseStmtNode * node){
+		condition(node->cond());
+		stmts(node->thenBranch());
+		stmts(node->elseBranch());
+		return nullptr;
+	}
+
+	const DataType * visitWhileStmt(const WhileStmtNode * node){
+		condition(node->cond());
+		stmts(node->body());
+		return nullptr;
+	}
+
+	const DataType * visitPostIncStmt(const PostIncStmtNode * node){
+		arithmetic(node->lval());
+		return nullptr;
+	}
+
+	const DataType * visitPostDecStmt(const PostDecStmtNode * node){
+		arithmetic(node->lval());
+		return nullptr;
+	}
+
+	const DataType * visitReceiveStmt(const ReceiveStmtNode * node){
+		const DataType * type = visit(node->lval());
+		if (type->kind() == DataType::FN){
+			error(node->lval(), "Attempt to assign user input to function");
+		} else if (type->kind() == DataType::RECORD){
+			error(node->lval(), "Attempt to assign user input to record");
+		}
+		return nullptr;
+	}
+
+	const DataType * visitReportStmt(const ReportStmtNode * node){
+		const DataType * type = visit(node->exp());
+		if (type->kind() == DataType::FN){
+			error(node->exp(), "Attempt to output a function");
+		} else if (type->kind() == DataType::RECORD){
+			error(node->exp(), "Attempt to output a record");
+		} else if (type == myTypes.voidType()){
+			error(node->exp(), "Attempt to output void");
+		}
+		return nullptr;
+	}
+
+	const DataType * visitReturnStmt(const ReturnStmtNode * node){
+		const ExpNode * exp = node->exp();
+		if (exp == nullptr){
+			if (myRet != myTypes.voidType()){
+				error(node, "Missing return value");
+			}
+			return nullptr;
+		}
+		const DataType * type = visit(exp);
+		if (myRet == myTypes.voidType()){
+			error(exp, "Return with a value in void function");
+		} else if (!matches(type, myRet)){
+			error(exp, "Bad return value");
+		}
+		return nullptr;
+	}
+
+	//Expressions
+
+	const DataType * visitIntLit(const IntLitNode *){
+		return myTypes.intType();
+	}
+
+	const DataType * visitStrLit(const StrLitNode *){
+		return myTypes.stringType();
+	}
+
+	const DataType * visitTrue(const TrueNode *){
+		return myTypes.boolType();
+	}
+
+	const DataType * visitFalse(const FalseNode *){
+		return myTypes.boolType();
+	}
+
+	const DataType * visitID(const IDNode * node){
+		const DeclNode * decl = node->decl();
+		//An unresolved name was reported by names analysis
+		if (decl == nullptr){ return myTypes.errorType(); }
+		if (decl->kind() == KIND_RECORD_TYPE_DECL){
+			error(node, "Record name used as a value");
+			return myTypes.errorType();
+		}
+		return myTypes.of(decl);
+	}
+
+	const DataType * visitIndex(const IndexNode * node){
+		const DeclNode * field = node->fieldId()->decl();
+		if (field == nullptr){ return myTypes.errorType(); }
+		return myTypes.of(field);
+	}
+
+	const DataType * visitAssignExp(const AssignExpNode * node){
+		const DataType * lhs = visit(node->lval());
+		const DataType * rhs = visit(node->exp());
+		if (isError(lhs) || isError(rhs)){ return myTypes.errorType(); }
+		if (lhs->kind() == DataType::FN){
+			error(node->lval(), "Invalid assignment operand");
+			return myTypes.errorType();
+		}
+		if (rhs->kind() == DataType::FN){
+			error(node->exp(), "Invalid assignment operand");
+			return myTypes.errorType();
+		}
+		if (lhs != rhs){
+			error(node, "Invalid assignment operation");
+			return myTypes.errorType();
+		}
+		return lhs;
+	}
+
+	const DataType * visitCallExp(const CallExpNode * node){
+		const DataType * callee = visit(node->callee());
+		const NodeList<ExpNode *> * args = node->args();
+		if (callee->kind() != DataType::FN){
+			if (!isError(callee)){
+				error(node->callee(), "Attempt to call a non-function");
+			}
+			if (args != nullptr){
+				for (const ExpNode * arg : *args){ visit(arg); }
+			}
+			return myTypes.errorType();
+		}
+		const std::vector<const DataType *>& params = callee->params();
+		size_t argc = args == nullptr ? 0 : args->size();
+		if (argc != params.size()){
+			error(node->callee(), "Function call with wrong number of args");
+		}
+		if (args != nullptr){
+			size_t i = 0;
+			for (const ExpNode * arg : *args){
+				const DataType * type = visit(arg);
+				if (i < params.size() && !matches(type, params[i])){
+					error(arg, "Type of actual does not match type of formal");
+				}
+				i++;
+			}
+		}
+		return callee->ret();
+	}
+
+	const DataType * visitNeg(const NegNode * node){
+		return arithmetic(node->exp()) ? myTypes.intType()
+		  : myTypes.errorType();
+	}
+
+	const DataType * visitNot(const NotNode * node){
+		return logical(node->exp()) ? myTypes.boolType()
+		  : myTypes.errorType();
+	}
+
+	/*
+	Both operands are always checked, so a mistake in
+	each is reported
+	*/
+	const DataType * visitBinaryExp(const BinaryExpNode * node){
+		switch (node->kind()){
+		case KIND_PLUS: case KIND_MINUS: case KIND_TIMES: case KIND_DIVIDE: {
+			bool l = arithmetic(node->lhs());
+			bool r = arithmetic(node->rhs());
+			return l && r ? myTypes.intType() : myTypes.errorType();
+		}
+		case KIND_LESS: case KIND_LESS_EQ: case KIND_GREATER:
+		case KIND_GREATER_EQ: {
+			bool l = relational(node->lhs());
+			bool r = relational(node->rhs());
+			return l && r ? myTypes.boolType() : myTypes.errorType();
+		}
+		case KIND_AND: case KIND_OR: {
+			bool l = logical(node->lhs());
+			bool r = logical(node->rhs());
+			return l && r ? myTypes.boolType() : myTypes.errorType();
+		}
+		default:
+			return equality(node);
+		}
+	}
+private:
+	void error(const ASTNode * node, const char * msg){
+		size_t start = node->pos().start();
+		Report::fatal(myLines.line(start), myLines.col(start), msg);
+		myOk = false;
+	}
+
+	bool isError(const DataType * type) const {
+		return type == myTypes.errorType();
+	}
+
+	/* Whether a value of type have may go where want is expected */
+	bool matches(const DataType * have, const DataType * want) const {
+		return have == want || isError(have) || isError(want);
+	}
+
+	void stmts(const NodeList<StmtNode *> * list){
+		for (const StmtNode * stmt : *list){ visit(stmt); }
+	}
+
+	void condition(const ExpNode * exp){
+		const DataType * type = visit(exp);
+		if (!matches(type, myTypes.boolType())){
+			error(exp, "Non-bool expression used as a condition");
+		}
+	}
+
+	/* Whether exp has type want; if not, and it isn't in error, say so */
+	bool operand(const ExpNode * exp, const DataType * want,
+		const char * msg){
+		const DataType * type = visit(exp);
+		if (type == want){ return true; }
+		if (!isError(type)){ error(exp, msg); }
+		return false;
+	}
+
+	bool arithmetic(const ExpNode * exp){
+		return operand(exp, myTypes.intType(),
+			"Arithmetic operator applied to invalid operand");
+	}
+
+	bool relational(const ExpNode * exp){
+		return operand(exp, myTypes.intType(),
+			"Relational operator applied to non-numeric operand");
+	}
+
+	bool logical(const ExpNode * exp){
+		return operand(exp, myTypes.boolType(),
+			"Logical operator applied to non-bool operand");
+	}
+
+	/* Any two values of the same int, bool or string type */
+	const DataType * equality(const BinaryExpNode * node){
+		const DataType * lhs = visit(node->lhs());
+		const DataType * rhs = visit(node->rhs());
+		bool ok = true;
+		if (!equatable(lhs)){
+			error(node->lhs(), "Invalid equality operand");
+			ok = false;
+		}
+		if (!equatable(rhs)){
+			error(node->rhs(), "Invalid equality operand");
+			ok = false;
+		}
+		if (!ok || isError(lhs) || isError(rhs)){
+			return myTypes.errorType();
+		}
+		if (lhs != rhs){
+			error(node, "Invalid equality operation");
+			return myTypes.errorType();
+		}
+		return myTypes.boolType();
+	}
+
+	bool equatable(const DataType * type) const {
+		switch (type->kind()){
+		case DataType::ERROR: case DataType::INT: case DataType::BOOL:
+		case DataType::STRING:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	const LineTable& myLines;
+	TypeTable& myTypes;
+	//The return type of the function being checked
+	const DataType * myRet;
+	bool myOk;
+};
+
+bool checkTypes(const ProgramNode * root, const LineTable& lines,
+	TypeTable& types){
+	TypeChecker checker(lines, types);
+	checker.visit(root);
+	return checker.ok();
+}
+
+}
@@ -0,0 +1,25 @@
+#ifndef CSHANTY_TYPECHECK_H
+#define CSHANTY_TYPECHECK_H
+
+#include "ast.hpp"
+#include "types.hpp"
+
+namespace cshanty{
+
+/**
+* Check the types of every expression and statement under root
+* (-types), which names analysis (names.hpp) must already have
+* resolved. Types come from types, so comparing two is comparing
+* pointers. Each misuse (an operator applied to the wrong type, a
+* mismatched assignment, call or return, a condition that isn't a
+* bool, reporting or receiving a function or a record, ...) is
+* reported as a fatal error at its position in lines and makes the
+* result false. An expression already in error gets the error type,
+* which is accepted everywhere, so one mistake is reported once.
+**/
+bool checkTypes(const ProgramNode * root, const LineTable& lines,
+	TypeTable& types);
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "types.hpp"
+
+namespace cshanty{
+
+//Keys the function types with no parameters
+static const uint32_t NO_PARAMS = UINT32_MAX;
+
+static uint64_t fnKey(const DataType * prefix, uint32_t param){
+	return uint64_t(prefix->id()) << 32 | param;
+}
+
+TypeTable::TypeTable(){
+	for (int k = DataType::ERROR; k < DataType::RECORD; k++){
+		myBasic[k] = make(static_cast<DataType::Kind>(k));
+	}
+}
+
+DataType * TypeTable::make(DataType::Kind kind){
+	myTypes.push_back(DataType(kind, static_cast<uint32_t>(myTypes.size())));
+	return &myTypes.back();
+}
+
+const DataType * TypeTable::record(const RecordTypeDeclNode * decl){
+	auto found = myRecords.find(decl);
+	if (found != myRecords.end()){ return found->second; }
+	DataType * type = make(DataType::RECORD);
+	type->myRecord = decl;
+	myRecords.emplace(decl, type);
+	return type;
+}
+
+/*
+The function type is reached from the return type's
+no-parameter one, adding a parameter per step
+*/
+const DataType * TypeTable::fn(const DataType * ret,
+	const std::vector<const DataType *>& params){
+	const DataType * type = ret;
+	uint32_t step = NO_PARAMS;
+	size_t count = 0;
+	while (true){
+		const DataType *& next = myFns[fnKey(type, step)];
+		if (next == nullptr){
+			DataType * made = make(DataType::FN);
+			made->myRet = ret;
+			made->myParams.assign(params.begin(), params.begin()
+				+ static_cast<std::ptrdiff_t>(count));
+			next = made;
+		}
+		type = next;
+		if (count == params.size()){ return type; }
+		step = params[count++]->id();
+	}
+}
+
+const DataType * TypeTable::of(const TypeNode * node){
+	switch (node->kind()){
+	case KIND_INT_TYPE: return intType();
+	case KIND_BOOL_TYPE: return boolType();
+	case KIND_STRING_TYPE: return stringType();
+	case KIND_VOID_TYPE: return voidType();
+	default: break;
+	}
+	const DeclNode * decl = static_cast<const RecordTypeNode *>(node)->id()->decl();
+	if (decl == nullptr || decl->kind() != KIND_RECORD_TYPE_DECL){
+		return errorType();
+	}
+	return record(static_cast<const RecordTypeDeclNode *>(decl));
+}
+
+const DataType * TypeTable::of(const DeclNode * decl){
+	if (VarDeclNode::classof(decl->kind())){
+		return of(static_cast<const VarDeclNode *>(decl)->type());
+	}
+	if (decl->kind() != KIND_FN_DECL){ return errorType(); }
+	const FnDeclNode * fnDecl = static_cast<const FnDeclNode *>(decl);
+	auto found = myFnDecls.find(fnDecl);
+	if (found != myFnDecls.end()){ return found->second; }
+	std::vector<const DataType *> params;
+	if (fnDecl->formals() != nullptr){
+		for (const FormalDeclNode * formal : *fnDecl->formals()){
+			params.push_back(of(formal->type()));
+		}
+	}
+	const DataType * type = fn(of(fnDecl->type()), params);
+	myFnDecls.emplace(fnDecl, type);
+	return type;
+}
+
+}
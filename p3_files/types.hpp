@@ -0,0 +1,93 @@
+#ifndef CSHANTY_TYPES_H
+#define CSHANTY_TYPES_H
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "ast.hpp"
+
+namespace cshanty{
+
+/**
+* \class DataType
+* A type as the type checker sees it. DataTypes only come from a
+* TypeTable, which makes exactly one of each, so two types are the
+* same type exactly when they are the same object.
+**/
+class DataType{
+public:
+	//ERROR is the type of anything already reported as wrong
+	enum Kind : uint8_t { ERROR, VOID, INT, BOOL, STRING, RECORD, FN };
+
+	Kind kind() const { return myKind; }
+	/** Dense, in order of creation by the table **/
+	uint32_t id() const { return myId; }
+	/** A record type's declaration **/
+	const RecordTypeDeclNode * record() const { return myRecord; }
+	/** A function type's return type and parameter types **/
+	const DataType * ret() const { return myRet; }
+	const std::vector<const DataType *>& params() const { return myParams; }
+private:
+	friend class TypeTable;
+	DataType(Kind kind, uint32_t id) : myKind(kind), myId(id),
+	  myRecord(nullptr), myRet(nullptr){ }
+
+	Kind myKind;
+	uint32_t myId;
+	const RecordTypeDeclNode * myRecord;
+	const DataType * myRet;
+	std::vector<const DataType *> myParams;
+};
+
+/**
+* \class TypeTable
+* The canonical DataTypes of one program. The five basic types are
+* made up front; a record type is made once per record declaration,
+* and a function type once per distinct signature. Signatures are
+* interned as tuples one parameter at a time: the type of a function
+* taking (a, b) is found from the one taking (a) and b's id, with a
+* single hash lookup, so it costs the same however many functions
+* share it.
+**/
+class TypeTable{
+public:
+	TypeTable();
+	TypeTable(const TypeTable&) = delete;
+	TypeTable& operator=(const TypeTable&) = delete;
+
+	const DataType * errorType() const { return myBasic[DataType::ERROR]; }
+	const DataType * voidType() const { return myBasic[DataType::VOID]; }
+	const DataType * intType() const { return myBasic[DataType::INT]; }
+	const DataType * boolType() const { return myBasic[DataType::BOOL]; }
+	const DataType * stringType() const { return myBasic[DataType::STRING]; }
+	const DataType * record(const RecordTypeDeclNode * decl);
+	const DataType * fn(const DataType * ret,
+		const std::vector<const DataType *>& params);
+
+	/**
+	* The type a type node names; the error type for a record name
+	* that names analysis (names.hpp) didn't resolve
+	**/
+	const DataType * of(const TypeNode * node);
+	/** The type of a variable, formal or function **/
+	const DataType * of(const DeclNode * decl);
+
+	/** Number of distinct types made **/
+	size_t size() const { return myTypes.size(); }
+private:
+	DataType * make(DataType::Kind kind);
+
+	//Stable addresses, indexed by id
+	std::deque<DataType> myTypes;
+	const DataType * myBasic[DataType::RECORD];
+	std::unordered_map<const RecordTypeDeclNode *, const DataType *> myRecords;
+	//(id of a function type, id of a parameter type) to the
+	// function type with that parameter added
+	std::unordered_map<uint64_t, const DataType *> myFns;
+	std::unordered_map<const FnDeclNode *, const DataType *> myFnDecls;
+};
+
+}
+
+#endif
@@ -1,4 +1,9 @@
-#include "ast.hpp"
+#include <algorithm>
+#include <climits>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "visitor.hpp"
 
 
 namespace cshanty{
@@ -7,308 +12,378 @@ namespace cshanty{
 doIndent is declared static, which means that it can
 only be called in this file (its symbol is not exported).
 */
-static void doIndent(std::ostream& out, int indent){
-	for (int k = 0 ; k < indent; k++){ out << "\t"; }
+static void doIndent(Writer& out, int indent){
+	if (indent > 0){ out.fill('\t', static_cast<size_t>(indent)); }
 }
 
 /*
 In this code, the intention is that functions are grouped
-into files by purpose, rather than by class.
-If you're used to having all of the functions of a class
-defined in the same file, this style may be a bit disorienting,
-though it is legal. Thus, we can have
-ProgramNode::unparse, which is the unparse method of ProgramNodes
-defined in the same file as DeclNode::unparse, the unparse method
-of DeclNodes.
+into files by purpose, rather than by class. Each pass is a
+visitor (visitor.hpp) with one handler per kind of node, so the
+unparse of a ProgramNode is defined in the same place as the
+unparse of a DeclNode.
 */
 
 
-void ProgramNode::unparse(std::ostream& out, int indent){
-	/* Oh, hey it's a for-each loop in C++!
-	   The loop iterates over each element in a collection
-	   without that gross i++ nonsense.
-	 */
-	for (auto global : *myGlobals){
-		/* The auto keyword tells the compiler
-		   to (try to) figure out what the
-		   type of a variable should be from
-		   context. here, since we're iterating
-		   over a list of DeclNode *s, it's
-		   pretty clear that global is of
-		   type DeclNode *.
-		*/
-		global->unparse(out, indent);
+/*
+How tightly an expression binds, for deciding which operands need
+parentheses. Binary operators follow the precedence declarations in
+cshanty.yy; an assignment binds loosest, a term (which is all unary
+minus will take) tightest. INT_MIN is written as a parenthesized
+subtraction (see visitIntLit), so it counts as a term.
+*/
+enum Binding{
+	BIND_ASSIGN, BIND_OR, BIND_AND, BIND_COMPARE, BIND_SUM, BIND_PRODUCT,
+	BIND_UNARY, BIND_TERM
+};
+
+static Binding binding(const ExpNode * exp){
+	switch (exp->kind()){
+	case KIND_ASSIGN_EXP: return BIND_ASSIGN;
+	case KIND_OR: return BIND_OR;
+	case KIND_AND: return BIND_AND;
+	case KIND_EQUALS: case KIND_NOT_EQUALS: case KIND_LESS:
+	case KIND_LESS_EQ: case KIND_GREATER: case KIND_GREATER_EQ:
+		return BIND_COMPARE;
+	case KIND_PLUS: case KIND_MINUS: return BIND_SUM;
+	case KIND_TIMES: case KIND_DIVIDE: return BIND_PRODUCT;
+	case KIND_NEG: case KIND_NOT: return BIND_UNARY;
+	case KIND_INT_LIT: {
+		int value = static_cast<const IntLitNode *>(exp)->value();
+		return value < 0 && value != INT_MIN ? BIND_UNARY : BIND_TERM;
 	}
-}
-void AssignExpNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	this->MyLVal->unparse(out, 0);
-	out << "=";
-	this->MyExp->unparse(out, 0);
-	out << ";\n";
-}
-
-void BinaryExpNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	this->MyLHS->unparse(out,0);
-	out<<" ";
-	this->MyRHS->unparse(out,0);
-	out<<";\n";
-}
-
-void CallExpNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	this->MyId->unparse(out,0);
-	out<<"(";
-	for (auto element : *MyList)
-	{
-		element->unparse(out, 0);
+	default: return BIND_TERM;
 	}
-	out<<")";
-}
-
-void LValNode::unparse(std::ostream& out, int indent){
-	//doIndent(out,indent);
-	this->unparse(out,0);
-}
-
-void IntLitNode::unparse(std::ostream& out, int indent){
-	out<<this->MyInt;
 }
 
-void StrLitNode::unparse(std::ostream& out, int indent){
-	out<<this->MyString;
-}
-
-void TrueNode::unparse(std::ostream& out, int indent){
-	out<<"true";
-}
-
-void FalseNode::unparse(std::ostream& out, int indent){
-	out<<"false";
-}
+/**
+* \class Unparser
+* Writes each node's canonical form, which parses back to the same
+* tree. Handlers take the indent for the node they write; children
+* are unparsed through visit(), which dispatches on kind, so the
+* whole walk is direct calls.
+**/
+class Unparser : public AstVisitor<Unparser>{
+public:
+	Unparser(Writer& out) : myOut(out){ }
+
+	void visitProgram(const ProgramNode * node, int indent){
+		/* Oh, hey it's a for-each loop in C++!
+		   The loop iterates over each element in a collection
+		   without that gross i++ nonsense.
+		 */
+		for (auto global : *node->globals()){
+			/* The auto keyword tells the compiler
+			   to (try to) figure out what the
+			   type of a variable should be from
+			   context. here, since we're iterating
+			   over a list of DeclNode *s, it's
+			   pretty clear that global is of
+			   type DeclNode *.
+			*/
+			visit(global, indent);
+		}
+	}
 
-void UnaryExpNode::unparse(std::ostream& out, int indent){
-	this->MyExp->unparse(out,0);
-}
+	void visitVarDecl(const VarDeclNode * node, int indent){
+		doIndent(myOut, indent);
+		visit(node->type(), 0);
+		myOut << " ";
+		visit(node->id(), 0);
+		myOut << ";\n";
+	}
 
-void AssignStmtNode::unparse(std::ostream& out, int indent){
-	this->MyAssign->unparse(out,0);
-}
+	void visitFormalDecl(const FormalDeclNode * node, int indent){
+		visit(node->type(), 0);
+		myOut<<" ";
+		visit(node->id(), 0);
+	}
 
-void CallStmtNode::unparse(std::ostream& out, int indent){
-	this->myCall->unparse(out,0);
-}
+	void visitFnDecl(const FnDeclNode * node, int indent){
+		doIndent(myOut, indent);
+		visit(node->type(), 0);
+		myOut<<" ";
+		visit(node->id(), 0);
+		myOut<<"(";
+		commaList(node->formals());
+		myOut<<"){\n";
+		list(node->body(), indent + 1);
+		doIndent(myOut, indent);
+		myOut<<"}\n";
+	}
 
-//DeclNode???
+	void visitRecordTypeDecl(const RecordTypeDeclNode * node, int indent){
+		doIndent(myOut, indent);
+		myOut<<"record ";
+		visit(node->id(), 0);
+		myOut<<"{\n";
+		list(node->fields(), indent + 1);
+		doIndent(myOut, indent);
+		myOut<<"}\n";
+	}
 
-void IfElseStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out<<"if (";
-	this->MyExp->unparse(out,0);
-	out<<"){\n";
-	for(auto element : *myTBranch){
-		element->unparse(out, 0);
+	void visitBoolType(const BoolTypeNode * node, int indent){
+		myOut<<"bool";
 	}
-	out<<"else {\n";
-	for(auto element : *myRBranch){
-		element->unparse(out, 0);
+
+	void visitIntType(const IntTypeNode * node, int indent){
+		myOut << "int";
 	}
-	out<<"}\n}\n";
-}
 
-void IfStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out<<"if (";
-	this->MyExp->unparse(out, 0);
-	out<<"){\n";
-	for(auto element : *myList){
-		element->unparse(out, 0);
+	void visitRecordType(const RecordTypeNode * node, int indent){
+		visit(node->id(), 0);
 	}
-	out<<"}\n";
-}
 
-void PostDecStmtNode::unparse(std::ostream& out, int indent){
-	this->myLVal->unparse(out,0);
-}
+	void visitStringType(const StringTypeNode * node, int indent){
+		myOut<<"string";
+	}
 
-void PostIncStmtNode::unparse(std::ostream& out, int indent){
-	this->myLVal->unparse(out,0);
-}
+	void visitVoidType(const VoidTypeNode * node, int indent){
+		myOut<<"void";
+	}
 
-void ReceiveStmtNode::unparse(std::ostream& out, int indent){
-	this->myLVal->unparse(out,0);
-}
+	void visitAssignStmt(const AssignStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		visit(node->assign(), 0);
+		myOut<<";\n";
+	}
 
-void ReportStmtNode::unparse(std::ostream& out, int indent){
-	this->myExp->unparse(out,0);
-}
+	void visitCallStmt(const CallStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		visit(node->call(), 0);
+		myOut<<";\n";
+	}
 
-void WhileStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out<<"while(";
-	this->MyExp->unparse(out,0);
-	out<<"){\n";
-	for(auto element : *my_List){
-		element->unparse(out,0);
+	void visitIfElseStmt(const IfElseStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		myOut<<"if (";
+		visit(node->cond(), 0);
+		myOut<<"){\n";
+		list(node->thenBranch(), indent + 1);
+		doIndent(myOut, indent);
+		myOut<<"} else {\n";
+		list(node->elseBranch(), indent + 1);
+		doIndent(myOut, indent);
+		myOut<<"}\n";
 	}
-	out<<"}\n";
-}
 
-void ReturnStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out<<"return ";
-	this->myExp->unparse(out,0);
-	out<<" ;\n";
-}
+	void visitIfStmt(const IfStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		myOut<<"if (";
+		visit(node->cond(), 0);
+		myOut<<"){\n";
+		list(node->body(), indent + 1);
+		doIndent(myOut, indent);
+		myOut<<"}\n";
+	}
 
-void BoolTypeNode::unparse(std::ostream& out, int indent){
-	out<<"bool";
-}
+	void visitPostDecStmt(const PostDecStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		visit(node->lval(), 0);
+		myOut<<"--;\n";
+	}
 
-void RecordTypeNode::unparse(std::ostream& out, int indent){
-	this->MyId->unparse(out,0);
-}
+	void visitPostIncStmt(const PostIncStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		visit(node->lval(), 0);
+		myOut<<"++;\n";
+	}
 
-void StringTypeNode::unparse(std::ostream& out, int indent){
-	out<<"string";
-}
+	void visitReceiveStmt(const ReceiveStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		myOut<<"receive ";
+		visit(node->lval(), 0);
+		myOut<<";\n";
+	}
 
-void VoidTypeNode::unparse(std::ostream& out, int indent){
-	out<<"void";
-}
+	void visitReportStmt(const ReportStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		myOut<<"report ";
+		visit(node->exp(), 0);
+		myOut<<";\n";
+	}
 
-void IDNode::unparse(std::ostream& out, int indent){
-	out << this->name;
-}
+	void visitWhileStmt(const WhileStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		myOut<<"while (";
+		visit(node->cond(), 0);
+		myOut<<"){\n";
+		list(node->body(), indent + 1);
+		doIndent(myOut, indent);
+		myOut<<"}\n";
+	}
 
-void IntTypeNode::unparse(std::ostream& out, int indent){
-	out << "int";
-}
+	void visitReturnStmt(const ReturnStmtNode * node, int indent){
+		doIndent(myOut, indent);
+		myOut<<"return";
+		if (node->exp() != nullptr){
+			myOut<<" ";
+			visit(node->exp(), 0);
+		}
+		myOut<<";\n";
+	}
 
-void AndNode::unparse(std::ostream& out, int indent){
-	this->AndRNode->unparse(out, 0);
-	out << " && ";
-	this->AndLNode->unparse(out, 0);
-}
+	void visitAssignExp(const AssignExpNode * node, int indent){
+		visit(node->lval(), 0);
+		myOut << " = ";
+		visit(node->exp(), 0);
+	}
 
-void DivideNode::unparse(std::ostream& out, int indent){
-	this->DivideRNode->unparse(out, 0);
-	out << " / ";
-	this->DivideLNode->unparse(out, 0);
-}
+	void visitCallExp(const CallExpNode * node, int indent){
+		visit(node->callee(), 0);
+		myOut<<"(";
+		commaList(node->args());
+		myOut<<")";
+	}
 
-void EqualsNode::unparse(std::ostream& out, int indent){
-	this->EqualsRNode->unparse(out, 0);
-	out << " == ";
-	this->EqualsLNode->unparse(out, 0);
-}
+	void visitIntLit(const IntLitNode * node, int indent){
+		/* 2147483648 is out of range as a literal, so INT_MIN
+		   (which -O can fold to) is written as arithmetic that
+		   folds back to it */
+		if (node->value() == INT_MIN){
+			myOut<<"("<<INT_MIN + 1<<" - 1)";
+		} else {
+			myOut<<node->value();
+		}
+	}
 
-void GreaterEqNode::unparse(std::ostream& out, int indent){
-	this->GreaterEqRNode->unparse(out, 0);
-	out << " >= ";
-	this->GreaterEqLNode->unparse(out, 0);
-}
+	void visitStrLit(const StrLitNode * node, int indent){
+		myOut<<node->str();
+	}
 
-void GreaterNode::unparse(std::ostream& out, int indent){
-	this->GreaterRNode->unparse(out, 0);
-	out << " > ";
-	this->GreaterLNode->unparse(out, 0);
-}
+	void visitTrue(const TrueNode * node, int indent){
+		myOut<<"true";
+	}
 
-void LessEqNode::unparse(std::ostream& out, int indent){
-	this->LessEqRNode->unparse(out, 0);
-	out << " <= ";
-	this->LessEqLNode->unparse(out, 0);
-}
+	void visitFalse(const FalseNode * node, int indent){
+		myOut<<"false";
+	}
 
-void LessNode::unparse(std::ostream& out, int indent){
-	this->LessRNode->unparse(out, 0);
-	out << " < ";
-	this->LessLNode->unparse(out, 0);
-}
+	void visitID(const IDNode * node, int indent){
+		myOut << node->getName();
+	}
 
-void MinusNode::unparse(std::ostream& out, int indent){
-	this->MinusRNode->unparse(out, 0);
-	out << " - ";
-	this->MinusLNode->unparse(out, 0);
-}
+	void visitIndex(const IndexNode * node, int indent){
+		visit(node->recordId(), 0);
+		myOut << "[";
+		visit(node->fieldId(), 0);
+		myOut << "]";
+	}
 
-void NotEqualsNode::unparse(std::ostream& out, int indent){
-	this->NotEqualsRNode->unparse(out, 0);
-	out << " != ";
-	this->NotEqualsLNode->unparse(out, 0);
-}
+	void visitBinaryExp(const BinaryExpNode * node, int indent){
+		/* Operators associate left, except the comparisons,
+		   which don't associate at all */
+		Binding own = binding(node);
+		Binding right = static_cast<Binding>(own + 1);
+		operand(node->lhs(), own == BIND_COMPARE ? right : own);
+		myOut << binaryOp(node->kind());
+		operand(node->rhs(), right);
+	}
 
-void OrNode::unparse(std::ostream& out, int indent){
-	this->OrRNode->unparse(out, 0);
-	out << " || ";
-	this->OrLNode->unparse(out, 0);
-}
+	void visitNeg(const NegNode * node, int indent){
+		myOut<<"-";
+		operand(node->exp(), BIND_TERM);
+	}
 
-void PlusNode::unparse(std::ostream& out, int indent){
-	this->PlusRNode->unparse(out, 0);
-	out << " + ";
-	this->PlusLNode->unparse(out, 0);
-}
+	void visitNot(const NotNode * node, int indent){
+		myOut<<"!";
+		operand(node->exp(), BIND_UNARY);
+	}
+private:
+	template <typename T>
+	void list(const NodeList<T *> * elts, int indent){
+		if (elts == nullptr){ return; }
+		for (auto element : *elts){
+			visit(element, indent);
+		}
+	}
 
-void TimesNode::unparse(std::ostream& out, int indent){
-	this->TimesRNode->unparse(out, 0);
-	out << " * ";
-	this->TimesLNode->unparse(out, 0);
-}
+	template <typename T>
+	void commaList(const NodeList<T *> * elts){
+		if (elts == nullptr){ return; }
+		const char * sep = "";
+		for (auto element : *elts){
+			myOut<<sep;
+			visit(element, 0);
+			sep = ", ";
+		}
+	}
 
-void IndexNode::unparse(std::ostream& out, int indent){
-	this->MyId1->unparse(out, 0);
-	out << "[";
-	this->MyId2->unparse(out, 0);
-	out << "]";
-	out << ";\n";
-}
+	/** exp, parenthesized unless it binds at least as tightly as min **/
+	void operand(const ExpNode * exp, Binding min){
+		bool parens = binding(exp) < min;
+		if (parens){ myOut<<"("; }
+		visit(exp, 0);
+		if (parens){ myOut<<")"; }
+	}
 
-void NegNode::unparse(std::ostream& out, int indent){
-	this->NegNode->unparse(out, 0);
-	out<<"-";
-}
+	static const char * binaryOp(NodeKind kind){
+		switch (kind){
+		case KIND_AND: return " && ";
+		case KIND_DIVIDE: return " / ";
+		case KIND_EQUALS: return " == ";
+		case KIND_GREATER_EQ: return " >= ";
+		case KIND_GREATER: return " > ";
+		case KIND_LESS_EQ: return " <= ";
+		case KIND_LESS: return " < ";
+		case KIND_MINUS: return " - ";
+		case KIND_NOT_EQUALS: return " != ";
+		case KIND_OR: return " || ";
+		case KIND_PLUS: return " + ";
+		case KIND_TIMES: return " * ";
+		default: return "";
+		}
+	}
 
-void NotNode::unparse(std::ostream& out, int indent){
-	this->NotNode->unparse(out, 0);
-	out<<"!";
-}
+	Writer& myOut;
+};
 
-void VarDeclNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	this->myType->unparse(out, 0);
-	out << " ";
-	this->myId->unparse(out, 0);
-	out << ";\n";
+void ASTNode::unparse(Writer& out, int indent) const{
+	Unparser(out).visit(this, indent);
 }
 
-void FnDeclNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	this->myType->unparse(out, 0);
-	out<<" ";
-	this->myId->unparse(out, 0);
-	out<<"(";
-	if(MyFormalList!=nullptr){
-		for(auto element : *MyFormalList){
-			element->unparse(out,0);
+/*
+Globals are split into runs of consecutive declarations. Each
+run is unparsed into its own buffer by whichever worker claims
+it, and the buffers are then written out in source order, so the
+result is byte-for-byte what unparse would have produced.
+*/
+void ProgramNode::unparseParallel(Writer& out, unsigned jobs) const{
+	std::vector<DeclNode *> globals(myGlobals->begin(), myGlobals->end());
+	size_t count = globals.size();
+	if (jobs <= 1 || count < 2){
+		unparse(out, 0);
+		return;
 	}
 
+	//Several runs per worker keeps the load even when
+	// declarations differ wildly in size
+	size_t runLen = count / (jobs * 8);
+	if (runLen == 0){ runLen = 1; }
+	size_t runs = (count + runLen - 1) / runLen;
+	std::vector<Writer> buffers(runs);
+
+	std::atomic<size_t> next(0);
+	auto worker = [&](){
+		while (true){
+			size_t run = next++;
+			if (run >= runs){ return; }
+			size_t end = std::min(count, (run + 1) * runLen);
+			for (size_t i = run * runLen; i < end; i++){
+				globals[i]->unparse(buffers[run], 0);
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned t = 0; t < jobs && t < runs; t++){
+		pool.emplace_back(worker);
 	}
-	out<<"){\n";
-	for(auto element : *MyStmtList){
-		element->unparse(out,0);
-	}
-	out<<"}\n";
-}
+	for (auto& thread : pool){ thread.join(); }
 
-void FormalDeclNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	this->myType->unparse(out, 0);
-	out<<" ";
-	this->myId->unparse(out, 0);
+	for (auto& buffer : buffers){
+		out.write(buffer.data(), buffer.size());
+	}
 }
 
-
 } // End namespace cshanty
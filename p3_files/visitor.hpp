@@ -0,0 +1,622 @@
+#ifndef CSHANTY_VISITOR_H
+#define CSHANTY_VISITOR_H
+
+#include <type_traits>
+#include "ast.hpp"
+
+namespace cshanty{
+
+/*
+T, const if From is: a visitor started on a const node hands its
+handlers const nodes.
+*/
+template <typename T, typename From>
+using NodeLike = typename std::conditional<std::is_const<From>::value,
+	const T, T>::type;
+
+/**
+* Call f on each child of node that is there, in source order, with
+* list elements in list order.
+**/
+template <typename F>
+void forEachChild(const ASTNode * node, F&& f){
+	auto each = [&f](auto * elts){
+		if (elts == nullptr){ return; }
+		for (auto elt : *elts){ f(elt); }
+	};
+	auto one = [&f](ASTNode * child){
+		if (child != nullptr){ f(child); }
+	};
+	switch (node->kind()){
+	case KIND_PROGRAM:
+		each(static_cast<const ProgramNode *>(node)->globals());
+		break;
+	case KIND_RECORD_TYPE:
+		one(static_cast<const RecordTypeNode *>(node)->id());
+		break;
+	case KIND_VAR_DECL:
+	case KIND_FORMAL_DECL: {
+		auto decl = static_cast<const VarDeclNode *>(node);
+		one(decl->type());
+		one(decl->id());
+		break;
+	}
+	case KIND_FN_DECL: {
+		auto fn = static_cast<const FnDeclNode *>(node);
+		one(fn->type());
+		one(fn->id());
+		each(fn->formals());
+		each(fn->body());
+		break;
+	}
+	case KIND_RECORD_TYPE_DECL: {
+		auto record = static_cast<const RecordTypeDeclNode *>(node);
+		one(record->id());
+		each(record->fields());
+		break;
+	}
+	case KIND_ASSIGN_STMT:
+		one(static_cast<const AssignStmtNode *>(node)->assign());
+		break;
+	case KIND_CALL_STMT:
+		one(static_cast<const CallStmtNode *>(node)->call());
+		break;
+	case KIND_IF_ELSE_STMT: {
+		auto stmt = static_cast<const IfElseStmtNode *>(node);
+		one(stmt->cond());
+		each(stmt->thenBranch());
+		each(stmt->elseBranch());
+		break;
+	}
+	case KIND_IF_STMT: {
+		auto stmt = static_cast<const IfStmtNode *>(node);
+		one(stmt->cond());
+		each(stmt->body());
+		break;
+	}
+	case KIND_POST_DEC_STMT:
+		one(static_cast<const PostDecStmtNode *>(node)->lval());
+		break;
+	case KIND_POST_INC_STMT:
+		one(static_cast<const PostIncStmtNode *>(node)->lval());
+		break;
+	case KIND_RECEIVE_STMT:
+		one(static_cast<const ReceiveStmtNode *>(node)->lval());
+		break;
+	case KIND_REPORT_STMT:
+		one(static_cast<const ReportStmtNode *>(node)->exp());
+		break;
+	case KIND_WHILE_STMT: {
+		auto stmt = static_cast<const WhileStmtNode *>(node);
+		one(stmt->cond());
+		each(stmt->body());
+		break;
+	}
+	case KIND_RETURN_STMT:
+		one(static_cast<const ReturnStmtNode *>(node)->exp());
+		break;
+	case KIND_ASSIGN_EXP: {
+		auto exp = static_cast<const AssignExpNode *>(node);
+		one(exp->lval());
+		one(exp->exp());
+		break;
+	}
+	case KIND_CALL_EXP: {
+		auto exp = static_cast<const CallExpNode *>(node);
+		one(exp->callee());
+		each(exp->args());
+		break;
+	}
+	case KIND_INDEX: {
+		auto index = static_cast<const IndexNode *>(node);
+		one(index->recordId());
+		one(index->fieldId());
+		break;
+	}
+	case KIND_AND: case KIND_DIVIDE: case KIND_EQUALS: case KIND_GREATER_EQ:
+	case KIND_GREATER: case KIND_LESS_EQ: case KIND_LESS: case KIND_MINUS:
+	case KIND_NOT_EQUALS: case KIND_OR: case KIND_PLUS: case KIND_TIMES: {
+		auto exp = static_cast<const BinaryExpNode *>(node);
+		one(exp->lhs());
+		one(exp->rhs());
+		break;
+	}
+	case KIND_NEG:
+	case KIND_NOT:
+		one(static_cast<const UnaryExpNode *>(node)->exp());
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+* \class AstVisitor
+* Base for passes over the tree (Impl derives from
+* AstVisitor<Impl, Result>). visit() indexes a table by the node's
+* kind and calls the entry, a small function with Impl's handler for
+* that kind inlined into it, so a pass costs one predictable indirect
+* call per node and no vtable pointer per node. Extra arguments to
+* visit() are passed along to the handler by value; state that a
+* pass shares across nodes belongs in Impl.
+*
+* Impl defines handlers only for the kinds it cares about. The rest
+* fall back a level: each binary operator to visitBinaryExp, each
+* unary one to visitUnaryExp, and those and every other kind to
+* visitNode, which by default visits the node's children.
+**/
+template <typename Impl, typename Result = void>
+class AstVisitor{
+public:
+	template <typename N, typename... Args>
+	Result visit(N * node, Args... args){
+		return dispatch(node, args...);
+	}
+
+	/** Visit each child of node (see forEachChild) with args **/
+	template <typename N, typename... Args>
+	void visitChildren(N * node, Args... args){
+		forEachChild(node, [&](ASTNode * child){
+			this->impl().visit(static_cast<NodeLike<ASTNode, N> *>(child),
+				args...);
+		});
+	}
+
+	template <typename N, typename... Args>
+	Result visitNode(N * node, Args... args){
+		visitChildren(node, args...);
+		return Result();
+	}
+	template <typename N, typename... Args>
+	Result visitBinaryExp(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitUnaryExp(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+
+	//Per-kind handlers, for Impl to hide
+	template <typename N, typename... Args>
+	Result visitProgram(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitBoolType(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitIntType(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitRecordType(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitStringType(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitVoidType(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitVarDecl(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitFormalDecl(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitFnDecl(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitRecordTypeDecl(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitAssignStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitCallStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitIfElseStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitIfStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitPostDecStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitPostIncStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitReceiveStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitReportStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitWhileStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitReturnStmt(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitAssignExp(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitCallExp(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitIntLit(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitStrLit(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitTrue(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitFalse(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitID(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitIndex(N * node, Args... args){
+		return impl().visitNode(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitAnd(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitDivide(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitEquals(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitGreaterEq(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitGreater(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitLessEq(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitLess(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitMinus(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitNotEquals(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitOr(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitPlus(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitTimes(N * node, Args... args){
+		return impl().visitBinaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitNeg(N * node, Args... args){
+		return impl().visitUnaryExp(node, args...);
+	}
+	template <typename N, typename... Args>
+	Result visitNot(N * node, Args... args){
+		return impl().visitUnaryExp(node, args...);
+	}
+protected:
+	Impl& impl(){ return *static_cast<Impl *>(this); }
+private:
+	/*
+	A child whose static type is a leaf class (an IDNode, say) needs
+	no switch: these overloads call its handler directly, where it
+	can be inlined into the parent's.
+	*/
+	template <typename... Args>
+	Result dispatch(IDNode * n, Args... args){
+		return impl().visitID(n, args...);
+	}
+	template <typename... Args>
+	Result dispatch(const IDNode * n, Args... args){
+		return impl().visitID(n, args...);
+	}
+	template <typename... Args>
+	Result dispatch(AssignExpNode * n, Args... args){
+		return impl().visitAssignExp(n, args...);
+	}
+	template <typename... Args>
+	Result dispatch(const AssignExpNode * n, Args... args){
+		return impl().visitAssignExp(n, args...);
+	}
+	template <typename... Args>
+	Result dispatch(CallExpNode * n, Args... args){
+		return impl().visitCallExp(n, args...);
+	}
+	template <typename... Args>
+	Result dispatch(const CallExpNode * n, Args... args){
+		return impl().visitCallExp(n, args...);
+	}
+	template <typename... Args>
+	Result dispatch(FormalDeclNode * n, Args... args){
+		return impl().visitFormalDecl(n, args...);
+	}
+	template <typename... Args>
+	Result dispatch(const FormalDeclNode * n, Args... args){
+		return impl().visitFormalDecl(n, args...);
+	}
+
+	/*
+	Any other static type goes through the table. There is one
+	table per constness and argument list, whatever the static
+	type, and an entry per kind that casts the node and calls Impl.
+	*/
+	template <typename N, typename... Args>
+	Result dispatch(N * node, Args... args){
+		using B = NodeLike<ASTNode, N>;
+		using Handler = Result (*)(Impl&, B *, Args...);
+		static const Handler handlers[KIND_LIMIT] = {
+			&onUnknown<B, Args...>,
+			&onProgram<B, Args...>,
+			&onBoolType<B, Args...>,
+			&onIntType<B, Args...>,
+			&onRecordType<B, Args...>,
+			&onStringType<B, Args...>,
+			&onVoidType<B, Args...>,
+			&onVarDecl<B, Args...>,
+			&onFormalDecl<B, Args...>,
+			&onFnDecl<B, Args...>,
+			&onRecordTypeDecl<B, Args...>,
+			&onAssignStmt<B, Args...>,
+			&onCallStmt<B, Args...>,
+			&onIfElseStmt<B, Args...>,
+			&onIfStmt<B, Args...>,
+			&onPostDecStmt<B, Args...>,
+			&onPostIncStmt<B, Args...>,
+			&onReceiveStmt<B, Args...>,
+			&onReportStmt<B, Args...>,
+			&onWhileStmt<B, Args...>,
+			&onReturnStmt<B, Args...>,
+			&onAssignExp<B, Args...>,
+			&onCallExp<B, Args...>,
+			&onIntLit<B, Args...>,
+			&onStrLit<B, Args...>,
+			&onTrue<B, Args...>,
+			&onFalse<B, Args...>,
+			&onID<B, Args...>,
+			&onIndex<B, Args...>,
+			&onAnd<B, Args...>,
+			&onDivide<B, Args...>,
+			&onEquals<B, Args...>,
+			&onGreaterEq<B, Args...>,
+			&onGreater<B, Args...>,
+			&onLessEq<B, Args...>,
+			&onLess<B, Args...>,
+			&onMinus<B, Args...>,
+			&onNotEquals<B, Args...>,
+			&onOr<B, Args...>,
+			&onPlus<B, Args...>,
+			&onTimes<B, Args...>,
+			&onNeg<B, Args...>,
+			&onNot<B, Args...>
+		};
+		B * n = node;
+		return handlers[n->kind() < KIND_LIMIT ? n->kind() : 0](impl(), n, args...);
+	}
+	template <typename B, typename... Args>
+	static Result onUnknown(Impl& v, B * n, Args... args){
+		return v.visitNode(n, args...);
+	}
+	template <typename B, typename... Args>
+	static Result onProgram(Impl& v, B * n, Args... args){
+		return v.visitProgram(static_cast<NodeLike<ProgramNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onBoolType(Impl& v, B * n, Args... args){
+		return v.visitBoolType(static_cast<NodeLike<BoolTypeNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onIntType(Impl& v, B * n, Args... args){
+		return v.visitIntType(static_cast<NodeLike<IntTypeNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onRecordType(Impl& v, B * n, Args... args){
+		return v.visitRecordType(static_cast<NodeLike<RecordTypeNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onStringType(Impl& v, B * n, Args... args){
+		return v.visitStringType(static_cast<NodeLike<StringTypeNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onVoidType(Impl& v, B * n, Args... args){
+		return v.visitVoidType(static_cast<NodeLike<VoidTypeNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onVarDecl(Impl& v, B * n, Args... args){
+		return v.visitVarDecl(static_cast<NodeLike<VarDeclNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onFormalDecl(Impl& v, B * n, Args... args){
+		return v.visitFormalDecl(static_cast<NodeLike<FormalDeclNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onFnDecl(Impl& v, B * n, Args... args){
+		return v.visitFnDecl(static_cast<NodeLike<FnDeclNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onRecordTypeDecl(Impl& v, B * n, Args... args){
+		return v.visitRecordTypeDecl(static_cast<NodeLike<RecordTypeDeclNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onAssignStmt(Impl& v, B * n, Args... args){
+		return v.visitAssignStmt(static_cast<NodeLike<AssignStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onCallStmt(Impl& v, B * n, Args... args){
+		return v.visitCallStmt(static_cast<NodeLike<CallStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onIfElseStmt(Impl& v, B * n, Args... args){
+		return v.visitIfElseStmt(static_cast<NodeLike<IfElseStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onIfStmt(Impl& v, B * n, Args... args){
+		return v.visitIfStmt(static_cast<NodeLike<IfStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onPostDecStmt(Impl& v, B * n, Args... args){
+		return v.visitPostDecStmt(static_cast<NodeLike<PostDecStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onPostIncStmt(Impl& v, B * n, Args... args){
+		return v.visitPostIncStmt(static_cast<NodeLike<PostIncStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onReceiveStmt(Impl& v, B * n, Args... args){
+		return v.visitReceiveStmt(static_cast<NodeLike<ReceiveStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onReportStmt(Impl& v, B * n, Args... args){
+		return v.visitReportStmt(static_cast<NodeLike<ReportStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onWhileStmt(Impl& v, B * n, Args... args){
+		return v.visitWhileStmt(static_cast<NodeLike<WhileStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onReturnStmt(Impl& v, B * n, Args... args){
+		return v.visitReturnStmt(static_cast<NodeLike<ReturnStmtNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onAssignExp(Impl& v, B * n, Args... args){
+		return v.visitAssignExp(static_cast<NodeLike<AssignExpNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onCallExp(Impl& v, B * n, Args... args){
+		return v.visitCallExp(static_cast<NodeLike<CallExpNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onIntLit(Impl& v, B * n, Args... args){
+		return v.visitIntLit(static_cast<NodeLike<IntLitNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onStrLit(Impl& v, B * n, Args... args){
+		return v.visitStrLit(static_cast<NodeLike<StrLitNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onTrue(Impl& v, B * n, Args... args){
+		return v.visitTrue(static_cast<NodeLike<TrueNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onFalse(Impl& v, B * n, Args... args){
+		return v.visitFalse(static_cast<NodeLike<FalseNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onID(Impl& v, B * n, Args... args){
+		return v.visitID(static_cast<NodeLike<IDNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onIndex(Impl& v, B * n, Args... args){
+		return v.visitIndex(static_cast<NodeLike<IndexNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onAnd(Impl& v, B * n, Args... args){
+		return v.visitAnd(static_cast<NodeLike<AndNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onDivide(Impl& v, B * n, Args... args){
+		return v.visitDivide(static_cast<NodeLike<DivideNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onEquals(Impl& v, B * n, Args... args){
+		return v.visitEquals(static_cast<NodeLike<EqualsNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onGreaterEq(Impl& v, B * n, Args... args){
+		return v.visitGreaterEq(static_cast<NodeLike<GreaterEqNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onGreater(Impl& v, B * n, Args... args){
+		return v.visitGreater(static_cast<NodeLike<GreaterNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onLessEq(Impl& v, B * n, Args... args){
+		return v.visitLessEq(static_cast<NodeLike<LessEqNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onLess(Impl& v, B * n, Args... args){
+		return v.visitLess(static_cast<NodeLike<LessNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onMinus(Impl& v, B * n, Args... args){
+		return v.visitMinus(static_cast<NodeLike<MinusNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onNotEquals(Impl& v, B * n, Args... args){
+		return v.visitNotEquals(static_cast<NodeLike<NotEqualsNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onOr(Impl& v, B * n, Args... args){
+		return v.visitOr(static_cast<NodeLike<OrNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onPlus(Impl& v, B * n, Args... args){
+		return v.visitPlus(static_cast<NodeLike<PlusNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onTimes(Impl& v, B * n, Args... args){
+		return v.visitTimes(static_cast<NodeLike<TimesNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onNeg(Impl& v, B * n, Args... args){
+		return v.visitNeg(static_cast<NodeLike<NegNode, B> *>(n), args...);
+	}
+	template <typename B, typename... Args>
+	static Result onNot(Impl& v, B * n, Args... args){
+		return v.visitNot(static_cast<NodeLike<NotNode, B> *>(n), args...);
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include <climits>
+#include <cstdlib>
+#include "vm.hpp"
+#include "errors.hpp"
+
+namespace cshanty{
+
+//Slots in the register stack, shared by every active call
+static const size_t STACK_SLOTS = 1 << 20;
+
+/*
+Arithmetic is done unsigned so that overflow wraps, as
+it does in simplify.cpp
+*/
+static int32_t wrap(uint32_t value){
+	return value <= INT32_MAX ? static_cast<int32_t>(value)
+	  : -static_cast<int32_t>(~value) - 1;
+}
+
+static uint32_t bits(int32_t value){
+	return static_cast<uint32_t>(value);
+}
+
+VM::VM(const BcProgram& program, const LineTable& lines,
+	Writer& out, std::istream& in)
+: myProgram(program), myLines(lines), myOut(out), myIn(in),
+  myRegs(STACK_SLOTS), myGlobals(program.globals),
+  myStrings(program.strings), myInstructions(0){ }
+
+void VM::fail(const BcFunction * fn, const Instr * in, const char * msg){
+	myOut.flush();
+	uint32_t offset = fn->offsets[static_cast<size_t>(in - fn->code.data())];
+	Report::fatal(myLines.line(offset), myLines.col(offset),
+		std::string("Runtime error: ") + msg);
+	throw new AbortError(1);
+}
+
+bool parseInputInt(const std::string& word, int32_t& value){
+	const char * start = word.c_str();
+	char * end;
+	long long parsed = strtoll(start, &end, 10);
+	if (end == start || *end != '\0'
+	  || parsed < INT32_MIN || parsed > INT32_MAX){
+		return false;
+	}
+	value = static_cast<int32_t>(parsed);
+	return true;
+}
+
+int32_t VM::readInt(const BcFunction * fn, const Instr * in){
+	myOut.flush();
+	std::string word;
+	int32_t value;
+	myIn >> word;
+	if (!parseInputInt(word, value)){
+		fail(fn, in, "Expected an int on input");
+	}
+	return value;
+}
+
+int32_t VM::readBool(const BcFunction * fn, const Instr * in){
+	myOut.flush();
+	std::string word;
+	myIn >> word;
+	if (word == "true" || word == "1"){ return 1; }
+	if (word == "false" || word == "0"){ return 0; }
+	fail(fn, in, "Expected true or false on input");
+}
+
+int32_t VM::readString(const BcFunction * fn, const Instr * in){
+	myOut.flush();
+	std::string word;
+	if (!(myIn >> word)){ fail(fn, in, "Expected a string on input"); }
+	myStrings.push_back(word);
+	return static_cast<int32_t>(myStrings.size() - 1);
+}
+
+#ifdef CSHANTY_NO_STATS
+#define CSHANTY_COUNT()
+#else
+#define CSHANTY_COUNT() count++
+#endif
+
+#if defined(__GNUC__)
+//Label addresses are a GNU extension
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define CSHANTY_LABEL(name) &&L_##name,
+#define CASE(name) L_##name:
+#define NEXT do { in = ip++; CSHANTY_COUNT(); goto *labels[in->op]; } while (0)
+#else
+#define CASE(name) case OP_##name:
+#define NEXT continue
+#endif
+
+/*
+The fetch and dispatch are repeated at the end of every handler
+(NEXT), which gives each its own indirect branch to predict. The
+registers, code and instruction pointer stay in locals, and are
+only saved to a frame by a call
+*/
+void VM::run(){
+	const BcFunction * fn = &myProgram.functions[myProgram.main];
+	const Instr * ip = fn->code.data();
+	const Instr * in;
+	int32_t * base = myRegs.data();
+	int32_t * R = base;
+	int32_t * G = myGlobals.data();
+	uint64_t count = 0;
+	myFrames.clear();
+	if (fn->frameSize > STACK_SLOTS){ fail(fn, ip, "Stack overflow"); }
+
+#if defined(__GNUC__)
+	static void * const labels[OP_LIMIT] = {
+		CSHANTY_OPCODES(CSHANTY_LABEL)
+	};
+	NEXT;
+#else
+	for (;;){
+	in = ip++;
+	CSHANTY_COUNT();
+	switch (in->op){
+#endif
+	CASE(MOV) R[in->a] = R[in->b]; NEXT;
+	CASE(LOADI) R[in->a] = in->k; NEXT;
+	CASE(LOADG) R[in->a] = G[in->k]; NEXT;
+	CASE(STOREG) G[in->k] = R[in->a]; NEXT;
+	CASE(ADD) R[in->a] = wrap(bits(R[in->b]) + bits(R[in->c])); NEXT;
+	CASE(SUB) R[in->a] = wrap(bits(R[in->b]) - bits(R[in->c])); NEXT;
+	CASE(MUL) R[in->a] = wrap(bits(R[in->b]) * bits(R[in->c])); NEXT;
+	CASE(DIV)
+		if (R[in->c] == 0){ fail(fn, in, "Division by zero"); }
+		//INT_MIN / -1 overflows, and wraps to INT_MIN
+		R[in->a] = R[in->c] == -1 ? wrap(0u - bits(R[in->b]))
+		  : R[in->b] / R[in->c];
+		NEXT;
+	CASE(ADDI) R[in->a] = wrap(bits(R[in->b]) + bits(in->k)); NEXT;
+	CASE(NEG) R[in->a] = wrap(0u - bits(R[in->b])); NEXT;
+	CASE(NOT) R[in->a] = !R[in->b]; NEXT;
+	CASE(EQ) R[in->a] = R[in->b] == R[in->c]; NEXT;
+	CASE(NE) R[in->a] = R[in->b] != R[in->c]; NEXT;
+	CASE(LT) R[in->a] = R[in->b] < R[in->c]; NEXT;
+	CASE(LE) R[in->a] = R[in->b] <= R[in->c]; NEXT;
+	CASE(GT) R[in->a] = R[in->b] > R[in->c]; NEXT;
+	CASE(GE) R[in->a] = R[in->b] >= R[in->c]; NEXT;
+	CASE(STREQ)
+		R[in->a] = R[in->b] == R[in->c]
+		  || myStrings[bits(R[in->b])] == myStrings[bits(R[in->c])];
+		NEXT;
+	CASE(STRNE)
+		R[in->a] = R[in->b] != R[in->c]
+		  && myStrings[bits(R[in->b])] != myStrings[bits(R[in->c])];
+		NEXT;
+	CASE(JMP) ip = fn->code.data() + in->k; NEXT;
+	CASE(JT) if (R[in->a]){ ip = fn->code.data() + in->k; } NEXT;
+	CASE(JF) if (!R[in->a]){ ip = fn->code.data() + in->k; } NEXT;
+	CASE(JEQ) if (R[in->a] == R[in->b]){ ip = fn->code.data() + in->k; } NEXT;
+	CASE(JNE) if (R[in->a] != R[in->b]){ ip = fn->code.data() + in->k; } NEXT;
+	CASE(JLT) if (R[in->a] < R[in->b]){ ip = fn->code.data() + in->k; } NEXT;
+	CASE(JLE) if (R[in->a] <= R[in->b]){ ip = fn->code.data() + in->k; } NEXT;
+	CASE(JGT) if (R[in->a] > R[in->b]){ ip = fn->code.data() + in->k; } NEXT;
+	CASE(JGE) if (R[in->a] >= R[in->b]){ ip = fn->code.data() + in->k; } NEXT;
+	CASE(CALL) {
+		const BcFunction * callee = &myProgram.functions[bits(in->k)];
+		int32_t * window = R + in->a;
+		if (static_cast<size_t>(window - base) + callee->frameSize
+		  > STACK_SLOTS){
+			fail(fn, in, "Stack overflow");
+		}
+		myFrames.push_back(Frame{fn, ip, R});
+		fn = callee;
+		ip = fn->code.data();
+		R = window;
+		NEXT;
+	}
+	CASE(RET)
+		R[0] = R[in->a];
+		goto leave;
+	CASE(RETV)
+	leave:
+		if (myFrames.empty()){ goto done; }
+		fn = myFrames.back().fn;
+		ip = myFrames.back().ip;
+		R = myFrames.back().regs;
+		myFrames.pop_back();
+		NEXT;
+	CASE(WRITEI) myOut << R[in->a]; NEXT;
+	CASE(WRITEB) myOut << (R[in->a] ? "true" : "false"); NEXT;
+	CASE(WRITES) myOut << myStrings[bits(R[in->a])]; NEXT;
+	CASE(READI) R[in->a] = readInt(fn, in); NEXT;
+	CASE(READB) R[in->a] = readBool(fn, in); NEXT;
+	CASE(READS) R[in->a] = readString(fn, in); NEXT;
+#if !defined(__GNUC__)
+	default:
+		fail(fn, in, "Bad instruction");
+	}
+	}
+#endif
+done:
+	myOut.flush();
+#ifndef CSHANTY_NO_STATS
+	myInstructions = count;
+#endif
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef CSHANTY_VM_H
+#define CSHANTY_VM_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+#include "position.hpp"
+#include "writer.hpp"
+
+namespace cshanty{
+
+/**
+* \class VM
+* Runs a BcProgram from its main function. Every function's registers
+* are a window onto one stack of 32-bit slots, so a call is a bounds
+* check and a pointer bump. Under GCC and Clang instructions are
+* dispatched through a table of label addresses, each handler jumping
+* straight to the next; elsewhere through a switch.
+*
+* report writes to out with no separators of its own, and receive
+* reads whitespace-separated words from in (out is flushed first, so
+* prompts appear). A division by zero, a stack overflow or bad input
+* is a runtime error, reported at the position of the instruction's
+* source in lines before the run is abandoned with an AbortError.
+**/
+class VM{
+public:
+	VM(const BcProgram& program, const LineTable& lines,
+		Writer& out, std::istream& in);
+
+	void run();
+	/** Instructions executed by run() (always 0 built with
+	* CSHANTY_NO_STATS) **/
+	uint64_t instructions() const { return myInstructions; }
+private:
+	struct Frame{
+		const BcFunction * fn;
+		const Instr * ip;
+		int32_t * regs;
+	};
+
+	[[noreturn]] void fail(const BcFunction * fn, const Instr * in,
+		const char * msg);
+	int32_t readInt(const BcFunction * fn, const Instr * in);
+	int32_t readBool(const BcFunction * fn, const Instr * in);
+	int32_t readString(const BcFunction * fn, const Instr * in);
+
+	const BcProgram& myProgram;
+	const LineTable& myLines;
+	Writer& myOut;
+	std::istream& myIn;
+	std::vector<int32_t> myRegs;
+	std::vector<int32_t> myGlobals;
+	std::vector<Frame> myFrames;
+	//The literals, then every string received
+	std::vector<std::string> myStrings;
+	uint64_t myInstructions;
+};
+
+/**
+* The int that word, a whole whitespace-separated word of input,
+* spells, read as the runtime (runtime/cshantyrt.c) reads one: false
+* if any of it is left over or the value doesn't fit
+**/
+bool parseInputInt(const std::string& word, int32_t& value);
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+#include "writer.hpp"
+
+namespace cshanty{
+
+static const size_t MEMORY_CAPACITY = 4096;
+
+static char * allocBuffer(size_t capacity){
+	char * buf = static_cast<char *>(std::malloc(capacity));
+	if (buf == nullptr){ throw std::bad_alloc(); }
+	return buf;
+}
+
+Writer::Writer()
+: myFd(-1), myStream(nullptr), myBuf(allocBuffer(MEMORY_CAPACITY)),
+  myCur(myBuf), myEnd(myBuf + MEMORY_CAPACITY), myFlushed(0), myGood(true){
+}
+
+Writer::Writer(int fd, size_t capacity)
+: myFd(fd), myStream(nullptr), myBuf(allocBuffer(capacity)),
+  myCur(myBuf), myEnd(myBuf + capacity), myFlushed(0), myGood(true){
+}
+
+Writer::Writer(std::ostream& out, size_t capacity)
+: myFd(-1), myStream(&out), myBuf(allocBuffer(capacity)),
+  myCur(myBuf), myEnd(myBuf + capacity), myFlushed(0), myGood(true){
+}
+
+Writer::~Writer(){
+	flush();
+	std::free(myBuf);
+}
+
+void Writer::flush(){
+	size_t len = size();
+	if (len == 0){ return; }
+	if (myFd >= 0){
+		const char * p = myBuf;
+		while (len > 0){
+			ssize_t n = ::write(myFd, p, len);
+			if (n < 0){
+				if (errno == EINTR){ continue; }
+				myGood = false;
+				break;
+			}
+			p += n;
+			len -= static_cast<size_t>(n);
+		}
+	} else if (myStream != nullptr){
+		myStream->write(myBuf, static_cast<std::streamsize>(len));
+		myStream->flush();
+		if (!myStream->good()){ myGood = false; }
+	} else {
+		//In-memory writers keep everything
+		return;
+	}
+	myFlushed += size();
+	myCur = myBuf;
+}
+
+/*
+Make room for len more bytes: flush if there's a destination,
+otherwise (or if that still isn't enough) grow the buffer.
+*/
+void Writer::makeRoom(size_t len){
+	flush();
+	if (len <= static_cast<size_t>(myEnd - myCur)){ return; }
+	size_t used = size();
+	size_t capacity = static_cast<size_t>(myEnd - myBuf) * 2;
+	while (capacity < used + len){ capacity *= 2; }
+	char * grown = static_cast<char *>(std::realloc(myBuf, capacity));
+	if (grown == nullptr){ throw std::bad_alloc(); }
+	myBuf = grown;
+	myCur = myBuf + used;
+	myEnd = myBuf + capacity;
+}
+
+void Writer::writeSlow(const char * str, size_t len){
+	makeRoom(len);
+	memcpy(myCur, str, len);
+	myCur += len;
+}
+
+} //End namespace cshanty
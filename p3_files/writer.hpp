@@ -0,0 +1,130 @@
+#ifndef CSHANTY_WRITER_H
+#define CSHANTY_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include "source.hpp"
+#include "interner.hpp"
+
+namespace cshanty{
+
+/**
+* \class Writer
+* Buffered output for the unparser and token listings. Fragments are
+* appended to one large contiguous buffer with no formatting state to
+* consult, integers are converted by hand, and the buffer reaches its
+* destination with a single write() per flush. A Writer drains to a
+* file descriptor or to a std::ostream, or (with neither) simply
+* grows in memory so the contents can be collected afterwards.
+**/
+class Writer{
+public:
+	static const size_t DEFAULT_CAPACITY = 1 << 20;
+
+	/** An in-memory writer **/
+	Writer();
+	/** Drains to fd, which the writer does not close **/
+	explicit Writer(int fd, size_t capacity = DEFAULT_CAPACITY);
+	/** Drains to out **/
+	explicit Writer(std::ostream& out, size_t capacity = DEFAULT_CAPACITY);
+	~Writer();
+	Writer(const Writer&) = delete;
+	Writer& operator=(const Writer&) = delete;
+
+	void write(const char * str, size_t len){
+		if (len > static_cast<size_t>(myEnd - myCur)){
+			writeSlow(str, len);
+			return;
+		}
+		memcpy(myCur, str, len);
+		myCur += len;
+	}
+
+	void put(char c){
+		if (myCur == myEnd){ makeRoom(1); }
+		*myCur++ = c;
+	}
+
+	/** Append n copies of c **/
+	void fill(char c, size_t n){
+		if (n > static_cast<size_t>(myEnd - myCur)){ makeRoom(n); }
+		memset(myCur, c, n);
+		myCur += n;
+	}
+
+	Writer& operator<<(char c){ put(c); return *this; }
+	Writer& operator<<(const char * str){
+		write(str, strlen(str));
+		return *this;
+	}
+	Writer& operator<<(const std::string& str){
+		write(str.data(), str.size());
+		return *this;
+	}
+	Writer& operator<<(const StringRef& ref){
+		write(ref.data(), ref.size());
+		return *this;
+	}
+	Writer& operator<<(Symbol sym){
+		write(sym.str(), sym.length());
+		return *this;
+	}
+	Writer& operator<<(int n){ return writeSigned(n); }
+	Writer& operator<<(long n){ return writeSigned(n); }
+	Writer& operator<<(long long n){ return writeSigned(n); }
+	Writer& operator<<(unsigned n){ return writeUnsigned(n); }
+	Writer& operator<<(unsigned long n){ return writeUnsigned(n); }
+	Writer& operator<<(unsigned long long n){ return writeUnsigned(n); }
+
+	/** Push buffered output to the destination (no-op in memory) **/
+	void flush();
+
+	/** Contents of an in-memory writer **/
+	const char * data() const { return myBuf; }
+	size_t size() const { return static_cast<size_t>(myCur - myBuf); }
+	/** Total bytes written through this writer **/
+	size_t bytesWritten() const { return myFlushed + size(); }
+	/** False once a write to the destination has failed **/
+	bool good() const { return myGood; }
+private:
+	template <typename T>
+	Writer& writeUnsigned(T n){
+		char digits[24];
+		char * end = digits + sizeof(digits);
+		char * p = end;
+		do {
+			*--p = static_cast<char>('0' + n % 10);
+			n /= 10;
+		} while (n != 0);
+		write(p, static_cast<size_t>(end - p));
+		return *this;
+	}
+
+	template <typename T>
+	Writer& writeSigned(T n){
+		typedef unsigned long long U;
+		if (n < 0){
+			put('-');
+			return writeUnsigned(U(0) - static_cast<U>(n));
+		}
+		return writeUnsigned(static_cast<U>(n));
+	}
+
+	void writeSlow(const char * str, size_t len);
+	void makeRoom(size_t len);
+
+	int myFd;
+	std::ostream * myStream;
+	char * myBuf;
+	char * myCur;
+	char * myEnd;
+	size_t myFlushed;
+	bool myGood;
+};
+
+} //End namespace cshanty
+
+#endif